@@ -0,0 +1,517 @@
+#include "hash_set.hpp"
+#include "hashing.hpp"
+#include "open_addressing.hpp"
+#include <benchmark/benchmark.h>
+#include <string>
+#include <unordered_map>
+#include <unordered_set>
+
+/* Benchmark matrix over containers, key types, key
+ * distributions, operations and sizes. The names have the
+ * form Operation/Container/Key/Distribution/Size, so
+ * --benchmark_filter can select any slice of it, e.g.
+ * --benchmark_filter='LookupMiss/.*\/uint32/random'.
+ *
+ * Every benchmark reports bytes_per_element of the
+ * container holding the initial keys. */
+
+/****************** Keys *********************/
+
+struct Key16 {
+    uint64_t a, b;
+
+    friend bool operator==(const Key16 &x, const Key16 &y) {
+        return x.a == y.a && x.b == y.b;
+    }
+};
+
+class HashKey16 {
+  private:
+    HashBits64 hash_fn;
+
+  public:
+    HashKey16(HashBits64 hash_fn) : hash_fn(hash_fn) {}
+
+    uint32_t operator()(const Key16 &key) const {
+        return hash_fn(key.a ^ (key.b * 0x9E3779B97F4A7C15ULL));
+    }
+
+    static HashKey16 get_new() {
+        return HashKey16(HashBits64::get_new());
+    }
+};
+
+struct StdHashKey16 {
+    size_t operator()(const Key16 &key) const {
+        return std::hash<uint64_t>()(key.a) ^
+               (std::hash<uint64_t>()(key.b) * 31);
+    }
+};
+
+template <> class MyHash<Key16> {
+  public:
+    uint32_t operator()(const Key16 &key) {
+        return MyHash<uint64_t>()(key.a ^
+                                  (key.b * 0x9E3779B97F4A7C15ULL));
+    }
+};
+
+template <typename T> struct KeyTraits;
+
+template <> struct KeyTraits<uint32_t> {
+    using HashFunc = HashBits32;
+    using StdHash = std::hash<uint32_t>;
+    static constexpr const char *name = "uint32";
+    static constexpr uint32_t max_size = 1 << 26;
+
+    static uint32_t make(uint64_t x) {
+        return x;
+    }
+};
+
+template <> struct KeyTraits<uint64_t> {
+    using HashFunc = HashBits64;
+    using StdHash = std::hash<uint64_t>;
+    static constexpr const char *name = "uint64";
+    static constexpr uint32_t max_size = 1 << 25;
+
+    static uint64_t make(uint64_t x) {
+        return x;
+    }
+};
+
+template <> struct KeyTraits<Key16> {
+    using HashFunc = HashKey16;
+    using StdHash = StdHashKey16;
+    static constexpr const char *name = "key16";
+    static constexpr uint32_t max_size = 1 << 24;
+
+    static Key16 make(uint64_t x) {
+        return {x, ~x};
+    }
+};
+
+/* Short enough for the small string optimization, so the
+ * memory numbers only contain the containers. */
+template <> struct KeyTraits<std::string> {
+    using HashFunc = HashString;
+    using StdHash = std::hash<std::string>;
+    static constexpr const char *name = "string";
+    static constexpr uint32_t max_size = 1 << 22;
+
+    static std::string make(uint64_t x) {
+        return "key:" + std::to_string((uint32_t)x);
+    }
+};
+
+enum class Distribution {
+    Sequential,
+    Random,
+    /* Only the high bits differ. */
+    Adversarial,
+};
+
+static const char *distribution_name(Distribution dist) {
+    switch (dist) {
+        case Distribution::Sequential:
+            return "sequential";
+        case Distribution::Random:
+            return "random";
+        case Distribution::Adversarial:
+            return "adversarial";
+    }
+    return "";
+}
+
+/* Bijective on 32 bits, so distinct indices give distinct
+ * keys. */
+static uint32_t scramble(uint32_t x) {
+    x *= 0x9E3779B1U;
+    x ^= x >> 15;
+    x *= 0x85EBCA77U;
+    x ^= x >> 13;
+    return x;
+}
+
+/* Index i in [0, 2 * amount). The first half is inserted,
+ * the second half is used for misses. */
+static uint64_t key_value(Distribution dist, uint64_t i,
+                          uint32_t amount) {
+    switch (dist) {
+        case Distribution::Sequential:
+            return i;
+        case Distribution::Random:
+            return scramble(i);
+        case Distribution::Adversarial: {
+            uint8_t bits = 1;
+            while ((1ULL << bits) < 2ULL * amount) {
+                bits++;
+            }
+            return i << (32 - bits);
+        }
+    }
+    return i;
+}
+
+template <typename T>
+static std::vector<T> make_keys(Distribution dist,
+                                uint32_t amount) {
+    std::vector<T> keys;
+    keys.reserve(2 * amount);
+    for (uint64_t i = 0; i < 2ULL * amount; i++) {
+        keys.push_back(
+            KeyTraits<T>::make(key_value(dist, i, amount)));
+    }
+    return keys;
+}
+
+/* Random indices into the keys, so lookups do not follow
+ * the insertion order. */
+static std::vector<uint32_t>
+make_query_order(uint32_t amount, uint32_t offset) {
+    std::vector<uint32_t> order(std::min(amount, 1u << 20));
+    std::mt19937 rng(amount);
+    for (uint32_t &index : order) {
+        index = offset + rng() % amount;
+    }
+    return order;
+}
+
+/****************** Containers *********************/
+
+static uint64_t allocated_bytes = 0;
+
+template <typename T> struct CountingAllocator {
+    using value_type = T;
+
+    CountingAllocator() = default;
+
+    template <typename U>
+    CountingAllocator(const CountingAllocator<U> &) {}
+
+    T *allocate(size_t n) {
+        allocated_bytes += n * sizeof(T);
+        return std::allocator<T>().allocate(n);
+    }
+
+    void deallocate(T *ptr, size_t n) {
+        allocated_bytes -= n * sizeof(T);
+        std::allocator<T>().deallocate(ptr, n);
+    }
+
+    template <typename U>
+    bool operator==(const CountingAllocator<U> &) const {
+        return true;
+    }
+
+    template <typename U>
+    bool operator!=(const CountingAllocator<U> &) const {
+        return false;
+    }
+};
+
+template <typename T> class HashSetContainer {
+  private:
+    HashSet<T, typename KeyTraits<T>::HashFunc> m_set;
+
+  public:
+    using KeyType = T;
+    static constexpr const char *name = "HashSet";
+
+    void insert(const T &key) {
+        T copy = key;
+        m_set.insert(copy);
+    }
+
+    bool contains(const T &key) {
+        return m_set.contains(key);
+    }
+
+    void remove(const T &key) {
+        m_set.remove(key);
+    }
+
+    uint64_t size_in_bytes() const {
+        return m_set.size_in_bytes();
+    }
+};
+
+template <typename T> class SetContainer {
+  private:
+    Set<T> m_set;
+
+  public:
+    using KeyType = T;
+    static constexpr const char *name = "Set";
+
+    void insert(const T &key) {
+        m_set.add(key);
+    }
+
+    bool contains(const T &key) {
+        return m_set.contains(key);
+    }
+
+    void remove(const T &key) {
+        m_set.remove(key);
+    }
+
+    uint64_t size_in_bytes() const {
+        return m_set.size_in_bytes();
+    }
+};
+
+template <typename T> class MapContainer {
+  private:
+    Map<T, uint32_t> m_map;
+
+  public:
+    using KeyType = T;
+    static constexpr const char *name = "Map";
+
+    void insert(const T &key) {
+        m_map.add(key, 0);
+    }
+
+    bool contains(const T &key) {
+        return m_map.contains(key);
+    }
+
+    void remove(const T &key) {
+        m_map.remove(key);
+    }
+
+    uint64_t size_in_bytes() const {
+        return m_map.size_in_bytes();
+    }
+};
+
+template <typename T> class UnorderedSetContainer {
+  private:
+    std::unordered_set<T, typename KeyTraits<T>::StdHash,
+                       std::equal_to<T>, CountingAllocator<T>>
+        m_set;
+
+  public:
+    using KeyType = T;
+    static constexpr const char *name = "std::unordered_set";
+
+    void insert(const T &key) {
+        m_set.insert(key);
+    }
+
+    bool contains(const T &key) {
+        return m_set.find(key) != m_set.end();
+    }
+
+    void remove(const T &key) {
+        m_set.erase(key);
+    }
+
+    uint64_t size_in_bytes() const {
+        return sizeof(m_set) + allocated_bytes;
+    }
+};
+
+template <typename T> class UnorderedMapContainer {
+  private:
+    using ValueType = std::pair<const T, uint32_t>;
+    std::unordered_map<T, uint32_t,
+                       typename KeyTraits<T>::StdHash,
+                       std::equal_to<T>,
+                       CountingAllocator<ValueType>>
+        m_map;
+
+  public:
+    using KeyType = T;
+    static constexpr const char *name = "std::unordered_map";
+
+    void insert(const T &key) {
+        m_map.emplace(key, 0);
+    }
+
+    bool contains(const T &key) {
+        return m_map.find(key) != m_map.end();
+    }
+
+    void remove(const T &key) {
+        m_map.erase(key);
+    }
+
+    uint64_t size_in_bytes() const {
+        return sizeof(m_map) + allocated_bytes;
+    }
+};
+
+/****************** Operations *********************/
+
+template <typename Container>
+static void report_memory(benchmark::State &state,
+                          const Container &container,
+                          uint32_t amount) {
+    state.counters["bytes_per_element"] =
+        container.size_in_bytes() / (double)amount;
+}
+
+template <typename Container>
+static void fill(Container &container,
+                 const std::vector<typename Container::KeyType> &keys,
+                 uint32_t amount) {
+    for (uint32_t i = 0; i < amount; i++) {
+        container.insert(keys[i]);
+    }
+}
+
+template <typename Container>
+static void BM_Insert(benchmark::State &state,
+                      Distribution dist, uint32_t amount) {
+    using T = typename Container::KeyType;
+    std::vector<T> keys = make_keys<T>(dist, amount);
+    for (auto _ : state) {
+        Container container;
+        fill(container, keys, amount);
+        state.PauseTiming();
+        report_memory(state, container, amount);
+        container = Container();
+        state.ResumeTiming();
+    }
+    state.SetItemsProcessed(state.iterations() * amount);
+}
+
+template <typename Container>
+static void BM_Lookup(benchmark::State &state,
+                      Distribution dist, uint32_t amount,
+                      bool hit) {
+    using T = typename Container::KeyType;
+    std::vector<T> keys = make_keys<T>(dist, amount);
+    Container container;
+    fill(container, keys, amount);
+    report_memory(state, container, amount);
+
+    std::vector<uint32_t> order =
+        make_query_order(amount, hit ? 0 : amount);
+    uint32_t i = 0;
+    for (auto _ : state) {
+        benchmark::DoNotOptimize(
+            container.contains(keys[order[i]]));
+        if (++i == order.size()) {
+            i = 0;
+        }
+    }
+    state.SetItemsProcessed(state.iterations());
+}
+
+/* The container always holds the keys [j, j + amount) of a
+ * pool of 2 * amount keys. A churn step removes key j and
+ * adds key j + amount. */
+template <typename Container>
+static void churn_step(Container &container,
+                       const std::vector<typename Container::KeyType> &keys,
+                       uint32_t amount, uint32_t &j) {
+    container.remove(keys[j]);
+    container.insert(keys[(j + amount) % keys.size()]);
+    j = (j + 1) % keys.size();
+}
+
+template <typename Container>
+static void BM_DeleteChurn(benchmark::State &state,
+                           Distribution dist, uint32_t amount) {
+    using T = typename Container::KeyType;
+    std::vector<T> keys = make_keys<T>(dist, amount);
+    Container container;
+    fill(container, keys, amount);
+
+    uint32_t j = 0;
+    for (auto _ : state) {
+        churn_step(container, keys, amount, j);
+    }
+    report_memory(state, container, amount);
+    state.SetItemsProcessed(state.iterations());
+}
+
+/* 90% lookups over the whole key pool (about half of them
+ * hit) and 10% churn steps. */
+template <typename Container>
+static void BM_Mixed(benchmark::State &state,
+                     Distribution dist, uint32_t amount) {
+    using T = typename Container::KeyType;
+    std::vector<T> keys = make_keys<T>(dist, amount);
+    Container container;
+    fill(container, keys, amount);
+
+    std::vector<uint32_t> order =
+        make_query_order(2 * amount, 0);
+    uint32_t i = 0, j = 0, step = 0;
+    for (auto _ : state) {
+        if (++step == 10) {
+            step = 0;
+            churn_step(container, keys, amount, j);
+        }
+        else {
+            benchmark::DoNotOptimize(
+                container.contains(keys[order[i]]));
+            if (++i == order.size()) {
+                i = 0;
+            }
+        }
+    }
+    report_memory(state, container, amount);
+    state.SetItemsProcessed(state.iterations());
+}
+
+/****************** Registration *********************/
+
+template <typename Container>
+static void register_container() {
+    using T = typename Container::KeyType;
+    for (Distribution dist :
+         {Distribution::Sequential, Distribution::Random,
+          Distribution::Adversarial}) {
+        for (uint32_t amount = 1 << 10;
+             amount <= KeyTraits<T>::max_size; amount <<= 2) {
+            std::string suffix =
+                std::string("/") + Container::name + "/" +
+                KeyTraits<T>::name + "/" +
+                distribution_name(dist) + "/" +
+                std::to_string(amount);
+            benchmark::RegisterBenchmark(
+                ("Insert" + suffix).c_str(),
+                BM_Insert<Container>, dist, amount);
+            benchmark::RegisterBenchmark(
+                ("LookupHit" + suffix).c_str(),
+                BM_Lookup<Container>, dist, amount, true);
+            benchmark::RegisterBenchmark(
+                ("LookupMiss" + suffix).c_str(),
+                BM_Lookup<Container>, dist, amount, false);
+            benchmark::RegisterBenchmark(
+                ("Mixed" + suffix).c_str(),
+                BM_Mixed<Container>, dist, amount);
+            benchmark::RegisterBenchmark(
+                ("DeleteChurn" + suffix).c_str(),
+                BM_DeleteChurn<Container>, dist, amount);
+        }
+    }
+}
+
+template <typename T> static void register_key_type() {
+    register_container<HashSetContainer<T>>();
+    register_container<SetContainer<T>>();
+    register_container<UnorderedSetContainer<T>>();
+    register_container<MapContainer<T>>();
+    register_container<UnorderedMapContainer<T>>();
+}
+
+int main(int argc, char **argv) {
+    register_key_type<uint32_t>();
+    register_key_type<uint64_t>();
+    register_key_type<Key16>();
+    register_key_type<std::string>();
+
+    benchmark::Initialize(&argc, argv);
+    if (benchmark::ReportUnrecognizedArguments(argc, argv)) {
+        return 1;
+    }
+    benchmark::RunSpecifiedBenchmarks();
+    benchmark::Shutdown();
+    return 0;
+}
@@ -1,9 +1,33 @@
+#include "concurrent_set.hpp"
+#include "counting_hash_set.hpp"
+#include "cuckoo_hash_set.hpp"
+#include "filtered_hash_set.hpp"
+#include "hash_kernels.hpp"
 #include "hash_set.hpp"
+#include "hash_set_loader.hpp"
 #include "hashing.hpp"
+#include "indexed_hash_set.hpp"
+#include "numa_hash_set.hpp"
+#include "open_addressing.hpp"
+#include "ordered_open_addressing.hpp"
+#include "persistent_hash_set.hpp"
+#include "radix_partition.hpp"
+#include "shared_read_hash_set.hpp"
+#include "split_hash_set.hpp"
 #include <benchmark/benchmark.h>
+#include <fstream>
+#include <shared_mutex>
+#include <unordered_map>
 #include <unordered_set>
 
 using IntSet = HashSet<int, HashBits32>;
+using FilteredIntSet = FilteredHashSet<int, HashBits32>;
+using PersistentIntSet = PersistentHashSet<int, HashBits32>;
+using CuckooIntSet = CuckooHashSet<int, HashBits32>;
+using NumaIntSet = NumaHashSet<int, HashBits32>;
+using SplitIntSet = SplitHashSet<int, HashBits32>;
+using CountingIntSet = CountingHashSet<int, HashBits32>;
+using SharedReadIntSet = SharedReadHashSet<int, HashBits32>;
 
 static void BM_HashSet_Insert(benchmark::State &state) {
     IntSet set;
@@ -19,6 +43,20 @@ static void BM_HashSet_Insert(benchmark::State &state) {
                             state.range(0));
 }
 
+static void BM_Set_Add(benchmark::State &state) {
+    Set<int> set;
+    for (auto _ : state) {
+        state.PauseTiming();
+        set = {};
+        state.ResumeTiming();
+        for (int i = 0; i < state.range(0); i++) {
+            set.add(i);
+        }
+    }
+    state.SetItemsProcessed(state.iterations() *
+                            state.range(0));
+}
+
 static void
 BM_UnorderedSet_Insert(benchmark::State &state) {
     std::unordered_set<int> set;
@@ -48,6 +86,20 @@ static void BM_HashSet_InsertNew(benchmark::State &state) {
                             state.range(0));
 }
 
+static void BM_Set_AddNew(benchmark::State &state) {
+    Set<int> set;
+    for (auto _ : state) {
+        state.PauseTiming();
+        set = {};
+        state.ResumeTiming();
+        for (int i = 0; i < state.range(0); i++) {
+            set.add_new(i);
+        }
+    }
+    state.SetItemsProcessed(state.iterations() *
+                            state.range(0));
+}
+
 static void
 BM_HashSet_BuildFromVector(benchmark::State &state) {
     IntSet set;
@@ -65,9 +117,1331 @@ BM_HashSet_BuildFromVector(benchmark::State &state) {
                             state.range(0));
 }
 
+/* Most sets in practice hold only a few elements. Every
+ * iteration creates a set, fills it and queries it once per
+ * element, so allocation and setup costs dominate. */
+template <typename SetType>
+static void BM_TinySets(benchmark::State &state) {
+    int amount = state.range(0);
+    for (auto _ : state) {
+        SetType set;
+        for (int i = 0; i < amount; i++) {
+            set.insert(i * 7);
+        }
+        for (int i = 0; i < amount; i++) {
+            benchmark::DoNotOptimize(set.contains(i * 3));
+        }
+    }
+    state.SetItemsProcessed(state.iterations());
+}
+
+/* Adapters so that other sets can be used in the same
+ * benchmarks. */
+struct OpenAddressingIntSet {
+    Set<int> set;
+
+    void insert(int value) {
+        set.add(value);
+    }
+
+    bool contains(int value) {
+        return set.contains(value);
+    }
+};
+
+struct UnorderedIntSet {
+    std::unordered_set<int> set;
+
+    void insert(int value) {
+        set.insert(value);
+    }
+
+    bool contains(int value) {
+        return set.count(value) > 0;
+    }
+};
+
+/* Readers get their own copy of a big set, but only do a
+ * few lookups in it. */
+template <typename SetType>
+static void BM_CopyThenRead(benchmark::State &state) {
+    int amount = state.range(0);
+    SetType set;
+    for (int i = 0; i < amount; i++) {
+        set.insert(i);
+    }
+    int query = 0;
+    for (auto _ : state) {
+        SetType snapshot = set;
+        for (int i = 0; i < 16; i++) {
+            benchmark::DoNotOptimize(snapshot.contains(query));
+            query = (query + 7919) % amount;
+        }
+    }
+    state.SetItemsProcessed(state.iterations());
+}
+
+static PersistentIntSet build_persistent_set(int amount) {
+    PersistentIntSet::Transient transient =
+        PersistentIntSet().transient();
+    for (int i = 0; i < amount; i++) {
+        transient.insert(i);
+    }
+    return transient.persistent();
+}
+
+static void
+BM_PersistentHashSet_BuildTransient(benchmark::State &state) {
+    for (auto _ : state) {
+        PersistentIntSet set = build_persistent_set(state.range(0));
+        benchmark::DoNotOptimize(set.size());
+    }
+    state.SetItemsProcessed(state.iterations() *
+                            state.range(0));
+}
+
+static void
+BM_PersistentHashSet_BuildVersions(benchmark::State &state) {
+    for (auto _ : state) {
+        PersistentIntSet set;
+        for (int i = 0; i < state.range(0); i++) {
+            set = set.insert(i);
+        }
+        benchmark::DoNotOptimize(set.size());
+    }
+    state.SetItemsProcessed(state.iterations() *
+                            state.range(0));
+}
+
+/* Creates a new version with one more element and keeps
+ * both alive, like a versioned snapshot would. */
+static void
+BM_PersistentHashSet_InsertVersion(benchmark::State &state) {
+    int amount = state.range(0);
+    PersistentIntSet set = build_persistent_set(amount);
+    uint64_t full_size = set.size_in_bytes();
+    int value = amount;
+    for (auto _ : state) {
+        PersistentIntSet version = set.insert(value++);
+        benchmark::DoNotOptimize(version.size());
+    }
+    state.counters["full_bytes"] = full_size;
+    state.SetItemsProcessed(state.iterations());
+}
+
+static void
+BM_PersistentHashSet_Contains(benchmark::State &state) {
+    int amount = state.range(0);
+    PersistentIntSet set = build_persistent_set(amount);
+    int query = 0;
+    for (auto _ : state) {
+        benchmark::DoNotOptimize(set.contains(query));
+        query = (query + 7919) % (amount * 2);
+    }
+    state.counters["bytes_per_element"] =
+        set.size_in_bytes() / (double)amount;
+    state.SetItemsProcessed(state.iterations());
+}
+
+/* Half of the lookups are hits. The extra sizes in the
+ * registration show how memory usage depends on fullness. */
+template <typename SetType>
+static void BM_Contains(benchmark::State &state) {
+    int amount = state.range(0);
+    SetType set;
+    for (int i = 0; i < amount; i++) {
+        set.insert(i);
+    }
+    int query = 0;
+    for (auto _ : state) {
+        benchmark::DoNotOptimize(set.contains(query));
+        query = (query + 7919) % (amount * 2);
+    }
+    state.counters["bytes_per_element"] =
+        set.size_in_bytes() / (double)amount;
+    state.SetItemsProcessed(state.iterations());
+}
+
+template <typename SetType>
+static void BM_InsertNew(benchmark::State &state) {
+    for (auto _ : state) {
+        SetType set;
+        for (int i = 0; i < state.range(0); i++) {
+            set.insert_new(i);
+        }
+        benchmark::DoNotOptimize(set.size());
+    }
+    state.SetItemsProcessed(state.iterations() *
+                            state.range(0));
+}
+
+/* 95% of the lookups are misses. */
+template <typename SetType>
+static void BM_ContainsMissHeavy(benchmark::State &state) {
+    uint32_t amount = state.range(0);
+    std::vector<int> values(amount);
+    for (uint32_t i = 0; i < amount; i++) {
+        values[i] = i * 2;
+    }
+    SetType set(values);
+
+    std::mt19937 rng(0);
+    std::vector<int> queries(1 << 20);
+    for (int &query : queries) {
+        int value = rng() % amount;
+        query = (rng() % 20 == 0) ? value * 2 : value * 2 + 1;
+    }
+
+    uint32_t index = 0;
+    for (auto _ : state) {
+        benchmark::DoNotOptimize(set.contains(queries[index]));
+        index = (index + 1) & (queries.size() - 1);
+    }
+    state.SetItemsProcessed(state.iterations());
+}
+
+/* Text with state.range(0) distinct words. Low word indices
+ * are much more common, roughly like in natural language. */
+static std::vector<std::string> make_words(uint32_t vocabulary) {
+    std::mt19937 rng(0);
+    std::uniform_real_distribution<double> distribution(0, 1);
+    std::vector<std::string> words(1 << 20);
+    for (std::string &word : words) {
+        double x = distribution(rng);
+        uint32_t index = vocabulary * x * x * x;
+        word = "word" + std::to_string(index);
+    }
+    return words;
+}
+
+static void BM_Map_WordCount(benchmark::State &state) {
+    std::vector<std::string> words = make_words(state.range(0));
+    for (auto _ : state) {
+        Map<std::string, uint32_t> counts;
+        for (const std::string &word : words) {
+            counts.lookup_or_add(word, 0)++;
+        }
+        benchmark::DoNotOptimize(counts.size());
+    }
+    state.SetItemsProcessed(state.iterations() * words.size());
+}
+
+static void
+BM_UnorderedMap_WordCount(benchmark::State &state) {
+    std::vector<std::string> words = make_words(state.range(0));
+    for (auto _ : state) {
+        std::unordered_map<std::string, uint32_t> counts;
+        for (const std::string &word : words) {
+            counts[word]++;
+        }
+        benchmark::DoNotOptimize(counts.size());
+    }
+    state.SetItemsProcessed(state.iterations() * words.size());
+}
+
+static ConcurrentPointerSet<int> *concurrent_set;
+static std::vector<int> concurrent_objects;
+
+/* Every thread adds its own range of objects into one set
+ * that starts empty, so the grows are part of the
+ * measurement. */
+static void
+BM_ConcurrentPointerSet_Add(benchmark::State &state) {
+    uint32_t per_thread = state.max_iterations;
+    if (state.thread_index() == 0) {
+        concurrent_objects.resize(per_thread *
+                                  state.threads());
+        concurrent_set = new ConcurrentPointerSet<int>();
+    }
+    int *object = concurrent_objects.data() +
+                  state.thread_index() * per_thread;
+    for (auto _ : state) {
+        concurrent_set->add(object++);
+    }
+    if (state.thread_index() == 0) {
+        delete concurrent_set;
+        concurrent_set = nullptr;
+    }
+    state.SetItemsProcessed(state.iterations());
+}
+
+/* All threads look up objects in the same prebuilt set,
+ * half of the lookups are misses. */
+static void
+BM_ConcurrentPointerSet_Contains(benchmark::State &state) {
+    uint32_t amount = state.range(0);
+    if (state.thread_index() == 0) {
+        concurrent_objects.resize(amount * 2);
+        concurrent_set = new ConcurrentPointerSet<int>();
+        for (uint32_t i = 0; i < amount; i++) {
+            concurrent_set->add(&concurrent_objects[i * 2]);
+        }
+    }
+    uint32_t index = state.thread_index() * 7919;
+    for (auto _ : state) {
+        index = (index + 4099) % (amount * 2);
+        benchmark::DoNotOptimize(concurrent_set->contains(
+            &concurrent_objects[index]));
+    }
+    if (state.thread_index() == 0) {
+        delete concurrent_set;
+        concurrent_set = nullptr;
+    }
+    state.SetItemsProcessed(state.iterations());
+}
+
+/* Reader scaling: every thread looks up values in the same
+ * prebuilt set, half of the lookups are misses. The locked
+ * variant is how a HashSet has to be shared with a writer
+ * otherwise. */
+static SharedReadIntSet *shared_read_set;
+static std::vector<SharedReadIntSet::Reader> shared_readers;
+static IntSet *locked_set;
+static std::shared_mutex locked_set_mutex;
+
+static void BM_SharedRead_Contains(benchmark::State &state) {
+    int amount = state.range(0);
+    if (state.thread_index() == 0) {
+        /* The other threads only wait for this setup when
+         * their loop starts, so the readers are created here
+         * as well. Freed by the next run, because the other
+         * threads might still use them after the loop. */
+        shared_readers.clear();
+        delete shared_read_set;
+        shared_read_set = new SharedReadIntSet();
+        for (int i = 0; i < amount; i++) {
+            shared_read_set->insert_new(i * 2);
+        }
+        for (int t = 0; t < state.threads(); t++) {
+            shared_readers.push_back(shared_read_set->reader());
+        }
+    }
+    int index = state.thread_index() * 7919;
+    for (auto _ : state) {
+        index = (index + 4099) % (amount * 2);
+        benchmark::DoNotOptimize(
+            shared_readers[state.thread_index()].contains(
+                index));
+    }
+    state.SetItemsProcessed(state.iterations());
+}
+
+static void BM_SharedMutex_Contains(benchmark::State &state) {
+    int amount = state.range(0);
+    if (state.thread_index() == 0) {
+        locked_set = new IntSet();
+        for (int i = 0; i < amount; i++) {
+            locked_set->insert(i * 2);
+        }
+    }
+    int index = state.thread_index() * 7919;
+    for (auto _ : state) {
+        index = (index + 4099) % (amount * 2);
+        std::shared_lock<std::shared_mutex> lock(
+            locked_set_mutex);
+        benchmark::DoNotOptimize(locked_set->contains(index));
+    }
+    if (state.thread_index() == 0) {
+        delete locked_set;
+        locked_set = nullptr;
+    }
+    state.SetItemsProcessed(state.iterations());
+}
+
+/* The NUMA benchmarks build a set and then look up batches
+ * of values from a thread pinned to the last node, which is
+ * the worst case when the set lives on the first node.
+ * Half of the lookups are hits. */
+static const uint32_t numa_batch_size = 4096;
+
+static std::vector<int> make_numa_queries(uint32_t amount) {
+    std::vector<int> queries(numa_batch_size);
+    for (uint32_t i = 0; i < numa_batch_size; i++) {
+        queries[i] = (i * 7919) % (amount * 2);
+    }
+    return queries;
+}
+
+/* Runs fn on a thread pinned to the given node. */
+template <typename Fn>
+static void run_on_node(const NumaNode &node, const Fn &fn) {
+    std::thread thread([&]() {
+        NumaTopology::pin_current_thread(node.cpus);
+        fn();
+    });
+    thread.join();
+}
+
+template <typename SetType>
+static void lookup_batches(benchmark::State &state,
+                           SetType &set, uint32_t amount) {
+    std::vector<int> queries = make_numa_queries(amount);
+    for (auto _ : state) {
+        for (int query : queries) {
+            benchmark::DoNotOptimize(set.contains(query));
+        }
+    }
+    state.SetItemsProcessed(state.iterations() *
+                            numa_batch_size);
+}
+
+/* The set is built and read on the same node. */
+static void BM_Numa_Local(benchmark::State &state) {
+    uint32_t amount = state.range(0);
+    NumaNode node = NumaTopology::nodes().back();
+    run_on_node(node, [&]() {
+        NumaTopology::bind_current_thread_memory(node.id);
+        IntSet set;
+        for (uint32_t i = 0; i < amount; i++) {
+            set.insert_new(i * 2);
+        }
+        lookup_batches(state, set, amount);
+    });
+}
+
+/* The pages of the set are spread over all nodes, so most
+ * lookups are remote, but no node is overloaded. */
+static void BM_Numa_Interleaved(benchmark::State &state) {
+    uint32_t amount = state.range(0);
+    std::vector<NumaNode> nodes = NumaTopology::nodes();
+    IntSet set;
+    run_on_node(nodes.front(), [&]() {
+        NumaTopology::interleave_current_thread_memory(nodes);
+        for (uint32_t i = 0; i < amount; i++) {
+            set.insert_new(i * 2);
+        }
+    });
+    run_on_node(nodes.back(),
+                [&]() { lookup_batches(state, set, amount); });
+}
+
+/* Every lookup is done by the worker on the node that owns
+ * the value. */
+static void BM_Numa_Partitioned(benchmark::State &state) {
+    uint32_t amount = state.range(0);
+    std::vector<NumaNode> nodes = NumaTopology::nodes();
+    NumaIntSet set(nodes);
+    std::vector<int> values(amount);
+    for (uint32_t i = 0; i < amount; i++) {
+        values[i] = i * 2;
+    }
+    set.insert_many(values.data(), amount);
+
+    run_on_node(nodes.back(), [&]() {
+        std::vector<int> queries = make_numa_queries(amount);
+        std::unique_ptr<bool[]> found(new bool[numa_batch_size]);
+        for (auto _ : state) {
+            set.contains_many(queries.data(), numa_batch_size,
+                              found.get());
+            benchmark::DoNotOptimize(found.get());
+        }
+        state.SetItemsProcessed(state.iterations() *
+                                numa_batch_size);
+    });
+}
+
+/* Writes amount distinct random values as raw bytes. */
+static std::string write_values_file(uint32_t amount) {
+    std::string path =
+        "/tmp/hash_set_load_" + std::to_string(amount) + ".bin";
+    std::ofstream file(path, std::ios::binary);
+    std::vector<int> chunk;
+    for (uint32_t i = 0; i < amount; i++) {
+        chunk.push_back(i * 2654435761u);
+        if (chunk.size() == 1 << 16 || i == amount - 1) {
+            file.write((const char *)chunk.data(),
+                       chunk.size() * sizeof(int));
+            chunk.clear();
+        }
+    }
+    return path;
+}
+
+static uint64_t read_status_kb(const std::string &key) {
+    std::ifstream file("/proc/self/status");
+    std::string line;
+    while (std::getline(file, line)) {
+        if (line.compare(0, key.size(), key) == 0) {
+            return std::stoull(line.substr(key.size() + 1));
+        }
+    }
+    return 0;
+}
+
+/* Makes VmHWM start again from the current RSS. */
+static void reset_peak_rss() {
+    std::ofstream("/proc/self/clear_refs") << "5";
+}
+
+/* Reports how much the peak RSS grew while loading, compared
+ * to the size of the input. */
+template <typename LoadFn>
+static void measure_load(benchmark::State &state,
+                         const LoadFn &load) {
+    uint32_t amount = state.range(0);
+    std::string path = write_values_file(amount);
+    uint64_t peak_kb = 0;
+    for (auto _ : state) {
+        state.PauseTiming();
+        reset_peak_rss();
+        uint64_t start_kb = read_status_kb("VmRSS");
+        state.ResumeTiming();
+        load(path);
+        peak_kb = std::max(peak_kb,
+                           read_status_kb("VmHWM") - start_kb);
+    }
+    std::remove(path.c_str());
+    state.counters["peak_rss_mb"] = peak_kb / 1024.0;
+    state.counters["input_mb"] =
+        amount * sizeof(int) / (1024.0 * 1024.0);
+    state.SetItemsProcessed(state.iterations() * amount);
+}
+
+/* The whole file is read into a vector first. */
+static void BM_Load_VectorConstructor(benchmark::State &state) {
+    measure_load(state, [](const std::string &path) {
+        std::ifstream file(path, std::ios::binary | std::ios::ate);
+        std::vector<int> values(file.tellg() / sizeof(int));
+        file.seekg(0);
+        file.read((char *)values.data(),
+                  values.size() * sizeof(int));
+        IntSet set(values);
+        benchmark::DoNotOptimize(set.size());
+    });
+}
+
+static void BM_Load_Streaming(benchmark::State &state) {
+    measure_load(state, [](const std::string &path) {
+        IntSet set;
+        HashSetLoader<int, HashBits32>::load_binary_file(path, set);
+        benchmark::DoNotOptimize(set.size());
+    });
+}
+
+/* The single pass partition that was used by the vector
+ * constructor before, kept as a baseline. */
+template <typename T>
+static void partial_sort_with_copies(T *data, uint32_t *keys,
+                                     uint32_t length,
+                                     uint8_t shift,
+                                     uint8_t digits) {
+    uint32_t bucket_amount = 1 << digits;
+    std::vector<uint32_t> sizes(bucket_amount);
+    uint32_t mask = (1 << digits) - 1;
+
+    for (uint32_t i = 0; i < length; i++) {
+        uint32_t index = (keys[i] >> shift) & mask;
+        sizes[index]++;
+    }
+
+    std::vector<uint32_t> offsets(bucket_amount);
+    for (uint32_t i = 0; i < bucket_amount - 1; i++) {
+        offsets[i + 1] = offsets[i] + sizes[i];
+    }
+
+    std::vector<T> tmp_data(
+        std::make_move_iterator(data),
+        std::make_move_iterator(data + length));
+    std::vector<uint32_t> tmp_keys(keys, keys + length);
+
+    for (uint32_t i = 0; i < length; i++) {
+        uint32_t bucket = (tmp_keys[i] >> shift) & mask;
+        uint32_t new_index = offsets[bucket];
+        data[new_index] = std::move(tmp_data[i]);
+        keys[new_index] = tmp_keys[i];
+        offsets[bucket]++;
+    }
+}
+
+/* Both partition random values by their hashes like the
+ * vector constructor of a set with that many values. */
+template <typename PartitionFn>
+static void measure_partition(benchmark::State &state,
+                              const PartitionFn &partition) {
+    uint32_t amount = state.range(0);
+    std::vector<int> original(amount);
+    std::vector<uint32_t> original_keys(amount);
+    std::mt19937 rng(0);
+    HashBits32 hash_fn = HashBits32::get_new();
+    for (uint32_t i = 0; i < amount; i++) {
+        original[i] = rng();
+        original_keys[i] = hash_fn(original[i]);
+    }
+    uint8_t size_exp = 1;
+    while ((1u << size_exp) < amount / 12) {
+        size_exp++;
+    }
+    size_exp++;
+
+    std::vector<int> values;
+    std::vector<uint32_t> keys;
+    for (auto _ : state) {
+        state.PauseTiming();
+        values = original;
+        keys = original_keys;
+        state.ResumeTiming();
+        partition(values.data(), keys.data(), amount, size_exp);
+    }
+    state.SetItemsProcessed(state.iterations() * amount);
+}
+
+static void BM_PartialSortWithCopies(benchmark::State &state) {
+    measure_partition(state, [](int *values, uint32_t *keys,
+                                uint32_t amount, uint8_t) {
+        partial_sort_with_copies(values, keys, amount, 18, 6);
+    });
+}
+
+static void BM_RadixPartition(benchmark::State &state) {
+    measure_partition(state, [](int *values, uint32_t *keys,
+                                uint32_t amount,
+                                uint8_t size_exp) {
+        radix_partition(values, keys, amount, 0, size_exp);
+    });
+}
+
+static std::vector<int> make_random_values(uint32_t amount) {
+    std::mt19937 rng(0);
+    std::vector<int> values(amount);
+    for (int &value : values) {
+        value = rng();
+    }
+    return values;
+}
+
+/* state.range(0) is the SimdLevel, state.range(1) the amount
+ * of keys. The keys do not fit into the cache at the larger
+ * amounts, so those show whether the kernels are limited by
+ * memory bandwidth. */
+template <void (*HashMany)(const uint32_t *, uint32_t *,
+                           uint32_t, SimdLevel)>
+static void BM_HashMany(benchmark::State &state) {
+    SimdLevel level = (SimdLevel)state.range(0);
+    if (level > simd_level()) {
+        state.SkipWithError("not supported by this CPU");
+        return;
+    }
+    uint32_t amount = state.range(1);
+    std::vector<int> values = make_random_values(amount);
+    std::vector<uint32_t> hashes(amount);
+    for (auto _ : state) {
+        HashMany((const uint32_t *)values.data(), hashes.data(),
+                 amount, level);
+        benchmark::DoNotOptimize(hashes.data());
+    }
+    state.SetItemsProcessed(state.iterations() * amount);
+}
+
+static void hash_many_bits32(const uint32_t *values,
+                             uint32_t *r_hashes, uint32_t amount,
+                             SimdLevel level) {
+    mersenne31_hash_many(342342983, 12314123, values, r_hashes,
+                         amount, level);
+}
+
+static void hash_many_multiply_shift(const uint32_t *values,
+                                     uint32_t *r_hashes,
+                                     uint32_t amount,
+                                     SimdLevel level) {
+    multiply_shift_hash_many(0x9E3779B97F4A7C15ULL, 12314123,
+                             values, r_hashes, amount, level);
+}
+
+/* Same values as BM_Contains, but in one batch. */
+static void BM_HashSet_ContainsMany(benchmark::State &state) {
+    int amount = state.range(0);
+    IntSet set;
+    for (int i = 0; i < amount; i++) {
+        set.insert(i);
+    }
+    std::vector<int> queries(1 << 16);
+    int query = 0;
+    for (int &value : queries) {
+        value = query;
+        query = (query + 7919) % (amount * 2);
+    }
+    std::unique_ptr<bool[]> found(new bool[queries.size()]);
+    for (auto _ : state) {
+        set.contains_many(queries.data(), queries.size(),
+                          found.get());
+        benchmark::DoNotOptimize(found.get());
+    }
+    state.SetItemsProcessed(state.iterations() * queries.size());
+}
+
+/* The loop over the matches of a group on its own, with
+ * state.range(0) of 16 bits set in every mask. Sums the
+ * positions, so that nothing depends on the values. */
+static void BM_MatchMask_Iterate(benchmark::State &state) {
+    uint32_t bits_per_mask = state.range(0);
+    std::mt19937 rng(0);
+    std::vector<uint16_t> masks(1 << 12);
+    for (uint16_t &mask : masks) {
+        mask = 0;
+        while (count_bits(mask) < bits_per_mask) {
+            mask |= 1 << (rng() % 16);
+        }
+    }
+    for (auto _ : state) {
+        uint32_t sum = 0;
+        for (uint16_t mask : masks) {
+            for (uint8_t position : MatchMask(mask)) {
+                sum += position;
+            }
+        }
+        benchmark::DoNotOptimize(sum);
+    }
+    state.SetItemsProcessed(state.iterations() * masks.size());
+}
+
+/* Every hash is shared by 8 values, so a hit compares about
+ * 4.5 values with a matching hash byte on average. */
+struct SharedHashBytes {
+    uint32_t operator()(uint32_t value) const {
+        return value >> 3;
+    }
+
+    static SharedHashBytes get_new() {
+        return {};
+    }
+};
+
+static void BM_HashSet_ContainsHitRich(benchmark::State &state) {
+    int amount = state.range(0);
+    HashSet<int, SharedHashBytes> set;
+    for (int i = 0; i < amount; i++) {
+        set.insert(i);
+    }
+    int query = 0;
+    for (auto _ : state) {
+        benchmark::DoNotOptimize(set.contains(query));
+        query = (query + 7919) % amount;
+    }
+    state.SetItemsProcessed(state.iterations());
+}
+
+/* Iterates over a set that had 1M values of which only one
+ * in state.range(0) is left, so most groups are empty. */
+static void BM_Set_IterateSparse(benchmark::State &state) {
+    int keep_every = state.range(0);
+    Set<int> set;
+    for (int i = 0; i < (1 << 20); i++) {
+        set.add(i);
+    }
+    for (int i = 0; i < (1 << 20); i++) {
+        if (i % keep_every != 0) {
+            set.remove(i);
+        }
+    }
+    for (auto _ : state) {
+        int sum = 0;
+        for (int value : set) {
+            sum += value;
+        }
+        benchmark::DoNotOptimize(sum);
+    }
+    state.SetItemsProcessed(state.iterations() * set.size());
+}
+
+/* Counts 1M values with state.range(0) distinct ones. */
+static std::vector<int> values_to_count(uint32_t distinct) {
+    std::mt19937 rng(0);
+    std::vector<int> values(1 << 20);
+    for (int &value : values) {
+        value = rng() % distinct;
+    }
+    return values;
+}
+
+/* The dedup set and the counts are separate. */
+static void BM_Count_HashSetAndMap(benchmark::State &state) {
+    std::vector<int> values = values_to_count(state.range(0));
+    for (auto _ : state) {
+        IntSet set;
+        std::unordered_map<int, int> counts;
+        for (int value : values) {
+            set.insert(value);
+            counts[value]++;
+        }
+        benchmark::DoNotOptimize(counts.size());
+    }
+    state.SetItemsProcessed(state.iterations() * values.size());
+}
+
+static void BM_Count_Increment(benchmark::State &state) {
+    std::vector<int> values = values_to_count(state.range(0));
+    for (auto _ : state) {
+        CountingIntSet set;
+        for (int value : values) {
+            set.increment(value);
+        }
+        benchmark::DoNotOptimize(set.size());
+    }
+    state.SetItemsProcessed(state.iterations() * values.size());
+}
+
+static void BM_Count_IncrementMany(benchmark::State &state) {
+    std::vector<int> values = values_to_count(state.range(0));
+    for (auto _ : state) {
+        CountingIntSet set;
+        set.increment_many(values.data(), values.size());
+        benchmark::DoNotOptimize(set.size());
+    }
+    state.SetItemsProcessed(state.iterations() * values.size());
+}
+
+static void BM_Count_TopK(benchmark::State &state) {
+    std::vector<int> values = values_to_count(state.range(0));
+    CountingIntSet set;
+    set.increment_many(values.data(), values.size());
+    for (auto _ : state) {
+        benchmark::DoNotOptimize(set.top_k(100));
+    }
+    state.SetItemsProcessed(state.iterations() * set.size());
+}
+
+/* 64 sets like the ones that worker threads build locally.
+ * All of them use the same hash function and the values are
+ * drawn from a range that is half as large as their total
+ * amount, so many of them are in more than one set. */
+static const uint32_t merge_input_amount = 64;
+
+static std::vector<IntSet> make_merge_inputs(uint32_t per_input) {
+    static HashBits32 hash_fn = HashBits32::get_new();
+    uint32_t value_range = merge_input_amount * per_input / 2;
+    std::mt19937 rng(0);
+    std::vector<IntSet> inputs;
+    for (uint32_t i = 0; i < merge_input_amount; i++) {
+        inputs.emplace_back(hash_fn);
+        for (uint32_t j = 0; j < per_input; j++) {
+            inputs.back().insert(rng() % value_range);
+        }
+    }
+    return inputs;
+}
+
+static void BM_Merge_InsertLoop(benchmark::State &state) {
+    for (auto _ : state) {
+        state.PauseTiming();
+        std::vector<IntSet> inputs =
+            make_merge_inputs(state.range(0));
+        state.ResumeTiming();
+        IntSet result;
+        for (IntSet &input : inputs) {
+            for (int value : input) {
+                result.insert(value);
+            }
+        }
+        benchmark::DoNotOptimize(result.size());
+    }
+    state.SetItemsProcessed(state.iterations() *
+                            merge_input_amount * state.range(0));
+}
+
+static void BM_Merge_Serial(benchmark::State &state) {
+    for (auto _ : state) {
+        state.PauseTiming();
+        std::vector<IntSet> inputs =
+            make_merge_inputs(state.range(0));
+        state.ResumeTiming();
+        IntSet result(inputs[0].hash_function());
+        for (IntSet &input : inputs) {
+            result.merge(std::move(input));
+        }
+        benchmark::DoNotOptimize(result.size());
+    }
+    state.SetItemsProcessed(state.iterations() *
+                            merge_input_amount * state.range(0));
+}
+
+/* state.range(1) is the number of threads. */
+static void BM_Merge_Parallel(benchmark::State &state) {
+    for (auto _ : state) {
+        state.PauseTiming();
+        std::vector<IntSet> inputs =
+            make_merge_inputs(state.range(0));
+        state.ResumeTiming();
+        IntSet result =
+            IntSet::merge_parallel(inputs, state.range(1));
+        benchmark::DoNotOptimize(result.size());
+    }
+    state.SetItemsProcessed(state.iterations() *
+                            merge_input_amount * state.range(0));
+}
+
+static void add_value(IntSet &set, int value) {
+    set.insert(value);
+}
+
+static void add_value(Set<int> &set, int value) {
+    set.add(value);
+}
+
+/* state.range(1) is the number of threads, 0 uses the
+ * single-threaded iterator. */
+template <typename SetType>
+static void BM_ParallelScan(benchmark::State &state) {
+    SetType set;
+    for (int i = 0; i < state.range(0); i++) {
+        add_value(set, i);
+    }
+    uint32_t thread_amount = state.range(1);
+    for (auto _ : state) {
+        std::atomic<int64_t> sum{0};
+        if (thread_amount == 0) {
+            int64_t local_sum = 0;
+            for (int value : set) {
+                local_sum += value;
+            }
+            sum = local_sum;
+        } else {
+            /* A thread-local sum per value, but only one
+             * atomic addition per range. */
+            std::vector<IndexRange> ranges =
+                set.group_ranges(1 << 12);
+            std::atomic<uint32_t> next_range{0};
+            parallel_for_ranges(
+                thread_amount, thread_amount,
+                [&](uint32_t, uint32_t) {
+                    uint32_t index;
+                    while ((index = next_range++) <
+                           ranges.size()) {
+                        int64_t local_sum = 0;
+                        set.for_each_in_groups(
+                            ranges[index],
+                            [&](int value) {
+                                local_sum += value;
+                            });
+                        sum += local_sum;
+                    }
+                });
+        }
+        benchmark::DoNotOptimize(sum.load());
+    }
+    state.SetItemsProcessed(state.iterations() * set.size());
+}
+
+static void BM_HashSet_EraseIf(benchmark::State &state) {
+    for (auto _ : state) {
+        state.PauseTiming();
+        IntSet set;
+        for (int i = 0; i < state.range(0); i++) {
+            set.insert(i);
+        }
+        state.ResumeTiming();
+        uint32_t removed = set.erase_if(
+            [](int value) { return value % 2 == 0; },
+            1 << 12, state.range(1));
+        benchmark::DoNotOptimize(removed);
+    }
+    state.SetItemsProcessed(state.iterations() * state.range(0));
+}
+
+/* For Set and OrderedSet. */
+template <typename SetType>
+static void BM_Iterate(benchmark::State &state) {
+    SetType set;
+    for (int i = 0; i < state.range(0); i++) {
+        set.add(i);
+    }
+    for (auto _ : state) {
+        int sum = 0;
+        for (int value : set) {
+            sum += value;
+        }
+        benchmark::DoNotOptimize(sum);
+    }
+    state.SetItemsProcessed(state.iterations() * set.size());
+}
+
+template <typename SetType>
+static void BM_Set_Contains(benchmark::State &state) {
+    int amount = state.range(0);
+    SetType set;
+    for (int i = 0; i < amount; i++) {
+        set.add(i);
+    }
+    int query = 0;
+    for (auto _ : state) {
+        benchmark::DoNotOptimize(set.contains(query));
+        query = (query + 7919) % (amount * 2);
+    }
+    state.counters["bytes_per_element"] =
+        set.size_in_bytes() / (double)amount;
+    state.SetItemsProcessed(state.iterations());
+}
+
+/* 8 byte keys, so that HashSet only has 6 slots per group.
+ * state.range(1) percent of the lookups are hits, the
+ * others look for random keys that are not in the set. */
+template <typename SetType>
+static void BM_ContainsHitRate(benchmark::State &state) {
+    uint32_t amount = state.range(0);
+    uint32_t hit_percent = state.range(1);
+    std::mt19937_64 rng(0);
+    std::vector<uint64_t> values(amount);
+    for (uint64_t &value : values) {
+        value = rng() | 1;
+    }
+    SetType set(values);
+
+    std::vector<uint64_t> queries(1 << 20);
+    for (uint64_t &query : queries) {
+        bool hit = rng() % 100 < hit_percent;
+        query = hit ? values[rng() % amount] : rng() & ~1ULL;
+    }
+
+    uint32_t index = 0;
+    for (auto _ : state) {
+        benchmark::DoNotOptimize(set.contains(queries[index]));
+        index = (index + 1) & (queries.size() - 1);
+    }
+    state.counters["bytes_per_element"] =
+        set.size_in_bytes() / (double)amount;
+    state.SetItemsProcessed(state.iterations());
+}
+
+/* Records of 128 bytes that are compared by their id. */
+struct Record {
+    uint64_t id;
+    char payload[120];
+
+    friend bool operator==(const Record &a, const Record &b) {
+        return a.id == b.id;
+    }
+};
+
+struct RecordHash {
+    HashBits64 hash_fn;
+
+    uint32_t operator()(const Record &record) const {
+        return hash_fn(record.id);
+    }
+
+    static RecordHash get_new() {
+        return {HashBits64::get_new()};
+    }
+};
+
+static std::vector<Record> make_records(uint32_t amount) {
+    std::vector<Record> records(amount);
+    for (uint32_t i = 0; i < amount; i++) {
+        records[i].id = (uint64_t)i << 32;
+    }
+    return records;
+}
+
+template <typename SetType>
+static void BM_LargeRecords_InsertNew(benchmark::State &state) {
+    std::vector<Record> records = make_records(state.range(0));
+    for (auto _ : state) {
+        SetType set;
+        for (Record &record : records) {
+            set.insert_new(record);
+        }
+        benchmark::DoNotOptimize(set.size());
+    }
+    state.SetItemsProcessed(state.iterations() *
+                            state.range(0));
+}
+
+template <typename SetType>
+static void BM_LargeRecords_Contains(benchmark::State &state) {
+    uint32_t amount = state.range(0);
+    std::vector<Record> records = make_records(amount);
+    SetType set;
+    for (Record &record : records) {
+        set.insert_new(record);
+    }
+    Record query = {};
+    uint32_t index = 0;
+    for (auto _ : state) {
+        query.id = (uint64_t)index << 32;
+        benchmark::DoNotOptimize(set.contains(query));
+        index = (index + 7919) % (amount * 2);
+    }
+    state.counters["bytes_per_element"] =
+        set.size_in_bytes() / (double)amount;
+    state.SetItemsProcessed(state.iterations());
+}
+
+/* Adds 1M random values in batches of state.range(0). With
+ * state.range(1), the batches are partitioned by slot. */
+static void BM_Set_AddMany(benchmark::State &state) {
+    uint32_t batch_size = state.range(0);
+    bool partition_by_slot = state.range(1);
+    std::vector<int> original = make_random_values(1 << 20);
+    std::vector<int> values;
+    for (auto _ : state) {
+        state.PauseTiming();
+        values = original;
+        state.ResumeTiming();
+        Set<int> set;
+        for (uint32_t start = 0; start < values.size();
+             start += batch_size) {
+            uint32_t amount = std::min<uint32_t>(
+                batch_size, values.size() - start);
+            set.add_many(values.data() + start, amount,
+                         partition_by_slot);
+        }
+        benchmark::DoNotOptimize(set.size());
+    }
+    state.SetItemsProcessed(state.iterations() *
+                            original.size());
+}
+
+static void BM_Map_AddMany(benchmark::State &state) {
+    uint32_t batch_size = state.range(0);
+    std::vector<int> keys = make_random_values(1 << 20);
+    for (auto _ : state) {
+        Map<int, int> map;
+        for (uint32_t start = 0; start < keys.size();
+             start += batch_size) {
+            uint32_t amount = std::min<uint32_t>(
+                batch_size, keys.size() - start);
+            map.add_many(keys.data() + start, keys.data() + start,
+                         amount);
+        }
+        benchmark::DoNotOptimize(map.size());
+    }
+    state.SetItemsProcessed(state.iterations() * keys.size());
+}
+
+/* The constants that HashBits32::get_new() returned for
+ * every set before the sets got their own random functions.
+ * Replacing the function does not help against values that
+ * were chosen for these. */
+struct FixedHashBits32 : HashBits32 {
+    FixedHashBits32() : HashBits32(342342983, 12314123) {}
+
+    static FixedHashBits32 get_new() {
+        return FixedHashBits32();
+    }
+};
+
+/* Values whose hashes under FixedHashBits32 have the lowest
+ * 16 bits unset, so they all start in group 0. Found by
+ * inverting m * v + n mod p. */
+static std::vector<int> make_colliding_values(uint32_t amount) {
+    const uint64_t p = (1ULL << 31) - 1;
+    const uint64_t m = 342342983, n = 12314123;
+    uint64_t m_inverse = 1;
+    for (uint64_t base = m, exp = p - 2; exp > 0; exp >>= 1) {
+        if (exp & 1) m_inverse = m_inverse * base % p;
+        base = base * base % p;
+    }
+    std::vector<int> values;
+    for (uint64_t k = 1; k <= amount; k++) {
+        uint64_t target = k << 16;
+        values.push_back((target + p - n) % p * m_inverse % p);
+    }
+    return values;
+}
+
+/* Without new hash functions, the set grows until the
+ * values end up in different groups, which needs 2^21
+ * groups already for 256 values. */
+template <typename SetType>
+static void BM_HashSet_InsertAdversarial(benchmark::State &state) {
+    std::vector<int> values = make_colliding_values(state.range(0));
+    uint64_t bytes = 0;
+    for (auto _ : state) {
+        SetType set;
+        for (int value : values) {
+            set.insert(value);
+        }
+        bytes = set.size_in_bytes();
+    }
+    state.counters["bytes"] = bytes;
+    state.SetItemsProcessed(state.iterations() * values.size());
+}
+
+/* Values that all had the same initial slot when Set hashed
+ * ints with the identity. */
+static void BM_Set_AddAdversarial(benchmark::State &state) {
+    std::vector<int> values;
+    for (int i = 0; i < state.range(0); i++) {
+        values.push_back(i << 20);
+    }
+    for (auto _ : state) {
+        Set<int> set;
+        for (int value : values) {
+            set.add(value);
+        }
+        benchmark::DoNotOptimize(set.size());
+    }
+    state.SetItemsProcessed(state.iterations() * values.size());
+}
+
 BENCHMARK(BM_HashSet_Insert)->Range(8, 8 << 20);
+BENCHMARK(BM_Set_Add)->Range(8, 8 << 20);
 BENCHMARK(BM_UnorderedSet_Insert)->Range(8, 8 << 20);
 BENCHMARK(BM_HashSet_InsertNew)->Range(8, 8 << 20);
+BENCHMARK(BM_Set_AddNew)->Range(8, 8 << 20);
 BENCHMARK(BM_HashSet_BuildFromVector)->Range(8, 8 << 20);
+BENCHMARK_TEMPLATE(BM_TinySets, IntSet)->DenseRange(0, 24, 4);
+BENCHMARK_TEMPLATE(BM_TinySets, OpenAddressingIntSet)
+    ->DenseRange(0, 24, 4);
+BENCHMARK_TEMPLATE(BM_TinySets, UnorderedIntSet)
+    ->DenseRange(0, 24, 4);
+BENCHMARK_TEMPLATE(BM_CopyThenRead, IntSet)
+    ->Range(1 << 10, 1 << 22);
+BENCHMARK_TEMPLATE(BM_CopyThenRead, OpenAddressingIntSet)
+    ->Range(1 << 10, 1 << 22);
+BENCHMARK(BM_PersistentHashSet_BuildTransient)
+    ->Range(1 << 10, 1 << 22);
+BENCHMARK(BM_PersistentHashSet_BuildVersions)
+    ->Range(1 << 10, 1 << 22);
+BENCHMARK(BM_PersistentHashSet_InsertVersion)
+    ->Range(1 << 10, 1 << 22);
+BENCHMARK(BM_PersistentHashSet_Contains)->Range(1 << 10, 1 << 22);
+BENCHMARK_TEMPLATE(BM_Contains, IntSet)
+    ->Range(1 << 10, 1 << 24)
+    ->Arg(3000000)
+    ->Arg(6000000);
+BENCHMARK_TEMPLATE(BM_Contains, CuckooIntSet)
+    ->Range(1 << 10, 1 << 24)
+    ->Arg(3000000)
+    ->Arg(6000000);
+BENCHMARK_TEMPLATE(BM_Contains, SplitIntSet)
+    ->Range(1 << 10, 1 << 24)
+    ->Arg(3000000)
+    ->Arg(6000000);
+BENCHMARK_TEMPLATE(BM_InsertNew, IntSet)->Range(1 << 10, 1 << 22);
+BENCHMARK_TEMPLATE(BM_InsertNew, CuckooIntSet)
+    ->Range(1 << 10, 1 << 22);
+BENCHMARK_TEMPLATE(BM_ContainsMissHeavy, IntSet)
+    ->Range(1 << 16, 1 << 26);
+BENCHMARK_TEMPLATE(BM_ContainsMissHeavy, FilteredIntSet)
+    ->Range(1 << 16, 1 << 26);
+BENCHMARK_TEMPLATE(BM_ContainsMissHeavy, SplitIntSet)
+    ->Range(1 << 16, 1 << 26);
+BENCHMARK(BM_Map_WordCount)->Range(1 << 8, 1 << 18);
+BENCHMARK(BM_UnorderedMap_WordCount)->Range(1 << 8, 1 << 18);
+BENCHMARK(BM_ConcurrentPointerSet_Add)
+    ->Iterations(1 << 18)
+    ->ThreadRange(1, 32)
+    ->UseRealTime();
+BENCHMARK(BM_ConcurrentPointerSet_Contains)
+    ->Arg(1 << 20)
+    ->ThreadRange(1, 32)
+    ->UseRealTime();
+BENCHMARK(BM_SharedRead_Contains)
+    ->Arg(1 << 20)
+    ->ThreadRange(1, 32)
+    ->UseRealTime();
+BENCHMARK(BM_SharedMutex_Contains)
+    ->Arg(1 << 20)
+    ->ThreadRange(1, 32)
+    ->UseRealTime();
+BENCHMARK(BM_Numa_Local)->Range(1 << 16, 1 << 24)->UseRealTime();
+BENCHMARK(BM_Numa_Interleaved)
+    ->Range(1 << 16, 1 << 24)
+    ->UseRealTime();
+BENCHMARK(BM_Numa_Partitioned)
+    ->Range(1 << 16, 1 << 24)
+    ->UseRealTime();
+BENCHMARK(BM_Load_VectorConstructor)
+    ->Range(1 << 20, 1 << 26)
+    ->Unit(benchmark::kMillisecond)
+    ->UseRealTime();
+BENCHMARK(BM_Load_Streaming)
+    ->Range(1 << 20, 1 << 26)
+    ->Unit(benchmark::kMillisecond)
+    ->UseRealTime();
+BENCHMARK(BM_PartialSortWithCopies)
+    ->Range(1 << 20, 1 << 26)
+    ->Arg(100000000)
+    ->Unit(benchmark::kMillisecond);
+BENCHMARK(BM_RadixPartition)
+    ->Range(1 << 20, 1 << 26)
+    ->Arg(100000000)
+    ->Unit(benchmark::kMillisecond);
+BENCHMARK(BM_Set_AddMany)
+    ->ArgsProduct({{1, 16, 256, 4096, 1 << 16, 1 << 20}, {0, 1}})
+    ->Unit(benchmark::kMillisecond);
+BENCHMARK(BM_Map_AddMany)
+    ->RangeMultiplier(16)
+    ->Range(1, 1 << 20)
+    ->Unit(benchmark::kMillisecond);
+BENCHMARK_TEMPLATE(BM_HashSet_InsertAdversarial,
+                   HashSet<int, FixedHashBits32>)
+    ->RangeMultiplier(2)
+    ->Range(64, 256)
+    ->Unit(benchmark::kMicrosecond);
+BENCHMARK_TEMPLATE(BM_HashSet_InsertAdversarial, IntSet)
+    ->RangeMultiplier(2)
+    ->Range(64, 256)
+    ->Unit(benchmark::kMicrosecond);
+BENCHMARK(BM_Set_AddAdversarial)
+    ->RangeMultiplier(4)
+    ->Range(256, 2048)
+    ->Unit(benchmark::kMicrosecond);
+BENCHMARK_TEMPLATE(BM_HashMany, hash_many_bits32)
+    ->ArgsProduct({{0, 1, 2}, {1 << 12, 1 << 20, 100000000}})
+    ->Unit(benchmark::kMicrosecond);
+BENCHMARK_TEMPLATE(BM_HashMany, hash_many_multiply_shift)
+    ->ArgsProduct({{0, 1, 2}, {1 << 12, 1 << 20, 100000000}})
+    ->Unit(benchmark::kMicrosecond);
+BENCHMARK(BM_HashSet_ContainsMany)
+    ->Range(1 << 10, 1 << 24)
+    ->Arg(3000000)
+    ->Arg(6000000);
+BENCHMARK(BM_MatchMask_Iterate)->DenseRange(1, 16, 3);
+BENCHMARK(BM_HashSet_ContainsHitRich)->Range(1 << 10, 1 << 22);
+BENCHMARK_TEMPLATE(BM_ContainsHitRate, HashSet<uint64_t, HashBits64>)
+    ->ArgsProduct({{1 << 16, 1 << 20, 1 << 22}, {0, 50, 100}});
+BENCHMARK_TEMPLATE(BM_ContainsHitRate,
+                   SplitHashSet<uint64_t, HashBits64>)
+    ->ArgsProduct({{1 << 16, 1 << 20, 1 << 22}, {0, 50, 100}});
+BENCHMARK_TEMPLATE(BM_LargeRecords_InsertNew,
+                   HashSet<Record, RecordHash>)
+    ->Range(1 << 10, 1 << 17);
+BENCHMARK_TEMPLATE(BM_LargeRecords_InsertNew,
+                   IndexedHashSet<Record, RecordHash>)
+    ->Range(1 << 10, 1 << 17);
+BENCHMARK_TEMPLATE(BM_LargeRecords_Contains,
+                   HashSet<Record, RecordHash>)
+    ->Range(1 << 10, 1 << 17);
+BENCHMARK_TEMPLATE(BM_LargeRecords_Contains,
+                   IndexedHashSet<Record, RecordHash>)
+    ->Range(1 << 10, 1 << 17);
+BENCHMARK(BM_Set_IterateSparse)
+    ->RangeMultiplier(4)
+    ->Range(1, 256)
+    ->Unit(benchmark::kMicrosecond);
+BENCHMARK_TEMPLATE(BM_Iterate, Set<int>)->Range(1 << 10, 1 << 22);
+BENCHMARK_TEMPLATE(BM_Iterate, OrderedSet<int>)
+    ->Range(1 << 10, 1 << 22);
+BENCHMARK_TEMPLATE(BM_Set_Contains, Set<int>)
+    ->Range(1 << 10, 1 << 22);
+BENCHMARK_TEMPLATE(BM_Set_Contains, OrderedSet<int>)
+    ->Range(1 << 10, 1 << 22);
+BENCHMARK(BM_Count_HashSetAndMap)->Range(1 << 10, 1 << 20);
+BENCHMARK(BM_Count_Increment)->Range(1 << 10, 1 << 20);
+BENCHMARK(BM_Count_IncrementMany)->Range(1 << 10, 1 << 20);
+BENCHMARK(BM_Count_TopK)->Range(1 << 10, 1 << 20);
+BENCHMARK(BM_Merge_InsertLoop)
+    ->Range(1 << 12, 1 << 16)
+    ->Unit(benchmark::kMillisecond);
+BENCHMARK(BM_Merge_Serial)
+    ->Range(1 << 12, 1 << 16)
+    ->Unit(benchmark::kMillisecond);
+BENCHMARK(BM_Merge_Parallel)
+    ->Ranges({{1 << 12, 1 << 16}, {1, 16}})
+    ->Unit(benchmark::kMillisecond)
+    ->UseRealTime();
+BENCHMARK_TEMPLATE(BM_ParallelScan, IntSet)
+    ->ArgsProduct({{1 << 20, 1 << 24}, {0, 1, 2, 4, 8, 16}})
+    ->Unit(benchmark::kMillisecond)
+    ->UseRealTime();
+BENCHMARK_TEMPLATE(BM_ParallelScan, Set<int>)
+    ->ArgsProduct({{1 << 20, 1 << 24}, {0, 1, 2, 4, 8, 16}})
+    ->Unit(benchmark::kMillisecond)
+    ->UseRealTime();
+BENCHMARK(BM_HashSet_EraseIf)
+    ->ArgsProduct({{1 << 20, 1 << 24}, {1, 2, 4, 8, 16}})
+    ->Unit(benchmark::kMillisecond)
+    ->UseRealTime();
 
 BENCHMARK_MAIN();
\ No newline at end of file
@@ -0,0 +1,75 @@
+#pragma once
+
+#include "utils.hpp"
+#include <algorithm>
+#include <stdint.h>
+#include <vector>
+
+/* Register blocked bloom filter working on 32 bit hashes.
+ * Every hash maps to exactly one 64 bit word and sets
+ * s_bits_per_hash bits in it. Compared to a classic bloom
+ * filter the false positive rate is a bit higher, but a
+ * lookup is a single load and a few shifts. */
+class BlockedBloomFilter {
+  private:
+    static const uint32_t s_bits_per_element = 10;
+    static const uint32_t s_bits_per_hash = 4;
+
+    std::vector<uint64_t> m_words;
+    uint32_t m_word_mask;
+
+  public:
+    BlockedBloomFilter(uint32_t expected_elements = 0) {
+        uint32_t min_words =
+            (expected_elements * (uint64_t)s_bits_per_element) /
+                64 +
+            1;
+        uint32_t word_amount = 1;
+        while (word_amount < min_words) {
+            word_amount <<= 1;
+        }
+        m_words.assign(word_amount, 0);
+        m_word_mask = word_amount - 1;
+    }
+
+    void clear() {
+        std::fill(m_words.begin(), m_words.end(), 0);
+    }
+
+    inline void insert(uint32_t hash) {
+        m_words[this->word_index(hash)] |=
+            this->word_mask(hash);
+    }
+
+    inline bool may_contain(uint32_t hash) const {
+        uint64_t mask = this->word_mask(hash);
+        uint64_t word = m_words[this->word_index(hash)];
+        return (word & mask) == mask;
+    }
+
+    uint32_t size_in_bytes() const {
+        return m_words.size() * sizeof(uint64_t);
+    }
+
+  private:
+    /* The table uses the low bits of the hash to find the
+     * group, so the bits here are derived from mixed
+     * versions of the hash instead. */
+    inline uint32_t word_index(uint32_t hash) const {
+        return ((hash * 0x9E3779B97F4A7C15ULL) >> 32) &
+               m_word_mask;
+    }
+
+    /* Every bit position uses 6 bits of the mixed hash.
+     * The lowest 16 bits are mixed the least and stay
+     * unused. */
+    inline uint64_t word_mask(uint32_t hash) const {
+        uint64_t key =
+            (hash ^ 0x5bd1e995U) * 0xC2B2AE3D27D4EB4FULL;
+        uint64_t mask = 0;
+        for (uint32_t i = 0; i < s_bits_per_hash; i++) {
+            mask |= 1ULL << ((key >> (16 + i * 6)) & 63);
+        }
+        return mask;
+    }
+};
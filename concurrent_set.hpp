@@ -0,0 +1,354 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <cstdlib>
+#include <stdint.h>
+#include <thread>
+#include <vector>
+#include <xmmintrin.h>
+
+/* Set of word sized keys that can be used from many threads at the same time. It uses the same
+ * grouped perturb probing as Set in open_addressing.hpp, but every slot is an atomic word that
+ * is either empty, moved or a key. There is no separate status byte, so claiming a slot is a
+ * single compare-and-swap.
+ *
+ * Keys are never removed. Together with the fact that a slot never goes back to being empty,
+ * this makes the following possible:
+ *   - contains() never blocks and never writes.
+ *   - add() finds the key or the first empty slot in the probe sequence and tries to claim it.
+ *     When the CAS fails, the slot is checked again, because another thread might have added
+ *     the same key just now.
+ *
+ * Resizing is cooperative. The thread that notices that the table is half full allocates a new
+ * table and publishes it in the old one. From then on, every thread calling add() helps to move
+ * chunks of slots over. A migrated slot is replaced with the moved sentinel. Keys are copied
+ * before the sentinel is written. A reader that meets a sentinel while other chunks are still
+ * being migrated keeps probing the old table, because later slots of the probe sequence may not
+ * have been copied yet. It only looks in the next table when the key is not in the old one, so
+ * readers always find a key in one of both tables. add() only continues in the new table after
+ * all chunks have been migrated; otherwise it could not tell whether the key is about to be
+ * copied over.
+ *
+ * Old tables are not freed before the set is destructed, because readers might still be using
+ * them. Since the table size doubles every time, this at most doubles the memory usage. */
+template<typename KeyT, typename KeyInfo> class ConcurrentSet {
+ private:
+  static constexpr uint32_t OFFSET_MASK = 3;
+  static constexpr uint32_t SLOTS_PER_CHUNK = 1024;
+
+  static_assert(std::atomic<KeyT>::is_always_lock_free, "keys have to be word sized");
+
+  struct Group {
+    static constexpr uint32_t slots_per_group = 4;
+    std::atomic<KeyT> keys[4];
+  };
+
+  struct Table {
+    Group *groups;
+    uint32_t slots_total;
+    uint32_t slot_mask;
+    uint32_t chunk_amount;
+    std::atomic<uint32_t> slots_set{0};
+    std::atomic<Table *> next{nullptr};
+    std::atomic<uint32_t> next_chunk{0};
+    std::atomic<uint32_t> chunks_done{0};
+
+    explicit Table(uint8_t group_exponent)
+    {
+      uint32_t group_amount = 1 << group_exponent;
+      slots_total = group_amount * Group::slots_per_group;
+      slot_mask = slots_total - 1;
+      chunk_amount = (slots_total + SLOTS_PER_CHUNK - 1) / SLOTS_PER_CHUNK;
+      size_t size_in_bytes = std::max<size_t>(group_amount * sizeof(Group), 64);
+      groups = static_cast<Group *>(aligned_alloc(64, size_in_bytes));
+      for (uint32_t i = 0; i < group_amount; i++) {
+        for (uint32_t offset = 0; offset < 4; offset++) {
+          new (&groups[i].keys[offset]) std::atomic<KeyT>(KeyInfo::get_empty());
+        }
+      }
+    }
+
+    ~Table()
+    {
+      free(static_cast<void *>(groups));
+    }
+
+    std::atomic<KeyT> &slot(uint32_t slot_index)
+    {
+      return groups[slot_index >> 2].keys[slot_index & OFFSET_MASK];
+    }
+
+    bool should_grow() const
+    {
+      return slots_set.load(std::memory_order_relaxed) >= slots_total / 2;
+    }
+  };
+
+  std::atomic<Table *> m_table;
+  std::vector<Table *> m_all_tables;
+  std::atomic_flag m_all_tables_lock = ATOMIC_FLAG_INIT;
+
+ public:
+  explicit ConcurrentSet(uint8_t group_exponent = 4)
+  {
+    Table *table = new Table(group_exponent);
+    m_all_tables.push_back(table);
+    m_table.store(table, std::memory_order_release);
+  }
+
+  ~ConcurrentSet()
+  {
+    for (Table *table : m_all_tables) {
+      delete table;
+    }
+  }
+
+  ConcurrentSet(const ConcurrentSet &other) = delete;
+  ConcurrentSet &operator=(const ConcurrentSet &other) = delete;
+
+  // clang-format off
+
+#define ITER_SLOTS_BEGIN(KEY, TABLE, R_SLOT) \
+  uint32_t hash = KeyInfo::hash(KEY); \
+  uint32_t perturb = hash; \
+  while (true) { \
+    uint32_t group_index = (hash & TABLE->slot_mask) >> 2; \
+    uint8_t offset = hash & OFFSET_MASK; \
+    uint8_t initial_offset = offset; \
+    Group &group = TABLE->groups[group_index]; \
+    do { \
+      std::atomic<KeyT> &R_SLOT = group.keys[offset];
+
+#define ITER_SLOTS_END \
+      offset = (offset + 1) & OFFSET_MASK; \
+    } while (offset != initial_offset); \
+    perturb >>= 5; \
+    hash = hash * 5 + 1 + perturb; \
+  } ((void)0)
+
+  // clang-format on
+
+  /* Returns true when the key has been added by this call. */
+  bool add(KeyT key)
+  {
+    Table *table = m_table.load(std::memory_order_acquire);
+    while (true) {
+      if (table->next.load(std::memory_order_acquire) != nullptr || table->should_grow()) {
+        table = this->grow_and_finish_migration(table);
+        continue;
+      }
+      AddResult result = this->try_add(table, key);
+      if (result == AddResult::Added) {
+        table->slots_set.fetch_add(1, std::memory_order_relaxed);
+        return true;
+      }
+      if (result == AddResult::Existed) {
+        return false;
+      }
+      table = this->grow_and_finish_migration(table);
+    }
+  }
+
+  bool contains(KeyT key) const
+  {
+    Table *table = m_table.load(std::memory_order_acquire);
+    while (true) {
+      LookupResult result = this->lookup(table, key);
+      if (result != LookupResult::Moved) {
+        return result == LookupResult::Found;
+      }
+      table = table->next.load(std::memory_order_acquire);
+    }
+  }
+
+  /* Only exact when no other thread is adding at the same time. */
+  uint32_t size() const
+  {
+    return m_table.load(std::memory_order_acquire)->slots_set.load(std::memory_order_relaxed);
+  }
+
+  uint32_t capacity() const
+  {
+    return m_table.load(std::memory_order_acquire)->slots_total;
+  }
+
+ private:
+  enum class AddResult {
+    Added,
+    Existed,
+    Moved,
+  };
+
+  enum class LookupResult {
+    Found,
+    NotFound,
+    Moved,
+  };
+
+  /* Migration goes chunk by chunk, so a moved slot only means that the key is not in this
+   * table when all chunks are done. Otherwise the key can still be in a later slot of a chunk
+   * that has not been copied yet, so probing continues. Every key that is not found on the way
+   * has been copied to the next table before its slot was marked as moved.
+   *
+   * The perturbation is used up after 7 steps. From then on the hash runs through all slot
+   * indices, so every group has been visited after slots_total more steps. A key that is still
+   * in this table is found within max_probe_length slots. */
+  LookupResult lookup(Table *table, KeyT key) const
+  {
+    bool saw_moved = false;
+    uint32_t max_probe_length = (table->slots_total + 8) * Group::slots_per_group;
+    uint32_t probe_length = 0;
+    ITER_SLOTS_BEGIN (key, table, slot) {
+      KeyT stored = slot.load(std::memory_order_acquire);
+      if (stored == key) {
+        return LookupResult::Found;
+      }
+      if (stored == KeyInfo::get_empty()) {
+        return saw_moved ? LookupResult::Moved : LookupResult::NotFound;
+      }
+      if (stored == KeyInfo::get_moved()) {
+        if (table->chunks_done.load(std::memory_order_acquire) == table->chunk_amount) {
+          return LookupResult::Moved;
+        }
+        saw_moved = true;
+      }
+      if (++probe_length > max_probe_length) {
+        return LookupResult::Moved;
+      }
+    }
+    ITER_SLOTS_END;
+  }
+
+  AddResult try_add(Table *table, KeyT key)
+  {
+    ITER_SLOTS_BEGIN (key, table, slot) {
+      KeyT stored = slot.load(std::memory_order_acquire);
+      if (stored == KeyInfo::get_empty()) {
+        if (slot.compare_exchange_strong(stored, key, std::memory_order_acq_rel)) {
+          return AddResult::Added;
+        }
+        /* The failed CAS loaded the current value into stored. */
+      }
+      if (stored == key) {
+        return AddResult::Existed;
+      }
+      if (stored == KeyInfo::get_moved()) {
+        return AddResult::Moved;
+      }
+    }
+    ITER_SLOTS_END;
+  }
+
+  /* Used while migrating. The key is known to be unique and the table is never more than half
+   * full, so there is no need to check for existing keys or to grow. */
+  void add_new_after_grow(Table *table, KeyT key)
+  {
+    ITER_SLOTS_BEGIN (key, table, slot) {
+      KeyT expected = KeyInfo::get_empty();
+      if (slot.load(std::memory_order_relaxed) == expected &&
+          slot.compare_exchange_strong(expected, key, std::memory_order_acq_rel))
+      {
+        table->slots_set.fetch_add(1, std::memory_order_relaxed);
+        return;
+      }
+    }
+    ITER_SLOTS_END;
+  }
+
+  Table *grow_and_finish_migration(Table *table)
+  {
+    Table *next = table->next.load(std::memory_order_acquire);
+    if (next == nullptr) {
+      uint8_t group_exponent = ceil_log2(table->slots_total / Group::slots_per_group) + 1;
+      Table *new_table = new Table(group_exponent);
+      if (table->next.compare_exchange_strong(next, new_table, std::memory_order_acq_rel)) {
+        next = new_table;
+        this->remember_table(new_table);
+      }
+      else {
+        delete new_table;
+      }
+    }
+
+    this->help_migrate(table, next);
+
+    /* Other threads might still be working on the last chunks. */
+    while (table->chunks_done.load(std::memory_order_acquire) < table->chunk_amount) {
+      std::this_thread::yield();
+    }
+    Table *expected = table;
+    m_table.compare_exchange_strong(expected, next, std::memory_order_acq_rel);
+    return m_table.load(std::memory_order_acquire);
+  }
+
+  void help_migrate(Table *table, Table *next)
+  {
+    while (true) {
+      uint32_t chunk = table->next_chunk.fetch_add(1, std::memory_order_relaxed);
+      if (chunk >= table->chunk_amount) {
+        return;
+      }
+      uint32_t start = chunk * SLOTS_PER_CHUNK;
+      uint32_t end = std::min(start + SLOTS_PER_CHUNK, table->slots_total);
+      for (uint32_t slot_index = start; slot_index < end; slot_index++) {
+        this->migrate_slot(table->slot(slot_index), next);
+      }
+      table->chunks_done.fetch_add(1, std::memory_order_acq_rel);
+    }
+  }
+
+  void migrate_slot(std::atomic<KeyT> &slot, Table *next)
+  {
+    KeyT stored = slot.load(std::memory_order_acquire);
+    if (stored == KeyInfo::get_empty()) {
+      if (slot.compare_exchange_strong(stored, KeyInfo::get_moved(), std::memory_order_acq_rel)) {
+        return;
+      }
+      /* Some thread added a key just now. */
+    }
+    this->add_new_after_grow(next, stored);
+    slot.store(KeyInfo::get_moved(), std::memory_order_release);
+  }
+
+  void remember_table(Table *table)
+  {
+    while (m_all_tables_lock.test_and_set(std::memory_order_acquire)) {
+      _mm_pause();
+    }
+    m_all_tables.push_back(table);
+    m_all_tables_lock.clear(std::memory_order_release);
+  }
+
+  static uint8_t ceil_log2(uint32_t x)
+  {
+    uint8_t exponent = 0;
+    while ((1u << exponent) < x) {
+      exponent++;
+    }
+    return exponent;
+  }
+
+#undef ITER_SLOTS_BEGIN
+#undef ITER_SLOTS_END
+};
+
+template<typename T> struct ConcurrentPointerKeyInfo {
+  static T *get_empty()
+  {
+    return nullptr;
+  }
+
+  /* Pointers to objects are aligned, so this is never a valid key. */
+  static T *get_moved()
+  {
+    return reinterpret_cast<T *>(uintptr_t(1));
+  }
+
+  static uint32_t hash(T *ptr)
+  {
+    return (uint32_t)(((uint64_t)ptr * 0x9E3779B97F4A7C15ULL) >> 32);
+  }
+};
+
+template<typename T> using ConcurrentPointerSet = ConcurrentSet<T *, ConcurrentPointerKeyInfo<T>>;
@@ -0,0 +1,412 @@
+#pragma once
+
+#include "hash_set.hpp"
+#include "hashing.hpp"
+#include "utils.hpp"
+#include <algorithm>
+#include <cstring>
+#include <memory>
+#include <queue>
+#include <stdint.h>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+#include <emmintrin.h>
+#include <xmmintrin.h>
+
+/* Variant of Group that stores a count next to every value.
+ * The counts come right after the hash bytes, so that
+ * incrementing a value with a small index usually stays in
+ * the first cache line of the group. */
+template <typename T, int N>
+class CountingGroup {
+  public:
+    static const uint8_t s_max_size = N;
+
+  private:
+    char m_hash_bytes[s_max_size];
+    uint16_t m_used_mask;
+    uint8_t m_count;
+    uint32_t m_counts[s_max_size];
+    alignas(T) char m_values[sizeof(T) * s_max_size];
+
+    struct MeasureSize {
+        char s1[sizeof(m_hash_bytes)];
+        uint16_t s2;
+        uint8_t s3;
+        uint32_t s4[s_max_size];
+        alignas(T) char s5[sizeof(m_values)];
+    };
+
+    static const uint32_t s_required_size =
+        sizeof(MeasureSize);
+    static const uint32_t s_pad_size =
+        next_multiple(64, s_required_size) -
+        s_required_size;
+    char pad[s_pad_size];
+
+  public:
+    /* can also be zero initialized */
+    CountingGroup() : m_used_mask(0x0), m_count(0) {}
+
+    ~CountingGroup() {
+        destroy_n(this->value_pointer(), m_count);
+    }
+
+    CountingGroup(const CountingGroup &other) {
+        this->copy_metadata_from(other);
+        std::uninitialized_copy_n(other.value_pointer(), m_count,
+                                  this->value_pointer());
+    }
+
+    CountingGroup(CountingGroup &&other) {
+        this->copy_metadata_from(other);
+        std::uninitialized_copy_n(
+            std::make_move_iterator(other.value_pointer()),
+            m_count, this->value_pointer());
+    }
+
+    CountingGroup &operator=(const CountingGroup &other) = delete;
+
+    inline uint8_t size() const {
+        return m_count;
+    }
+
+    inline bool is_full() const {
+        return m_count == s_max_size;
+    }
+
+    inline const T &element_at(uint8_t position) const {
+        return this->value_pointer()[position];
+    }
+
+    inline uint32_t count(uint8_t position) const {
+        return m_counts[position];
+    }
+
+    /* Returns nullptr when the value is not in the group. */
+    template <typename StatsCounter>
+    inline uint32_t *lookup(const T &value, uint8_t hash_byte,
+                            StatsCounter &stats) {
+        for (uint8_t position :
+             this->get_hash_bytes_mask(hash_byte)) {
+            bool found = this->element_at(position) == value;
+            stats.count_key_comparison(found);
+            if (found) {
+                return m_counts + position;
+            }
+        }
+        return nullptr;
+    }
+
+    inline bool try_insert_new(const T &value, uint8_t hash_byte,
+                               uint32_t count) {
+        if (this->is_full()) return false;
+        this->insert_new(value, hash_byte, count);
+        return true;
+    }
+
+    /* Copies the value and its count, see
+     * Group::try_insert_from(). */
+    inline bool try_insert_from(CountingGroup &src,
+                                uint8_t position,
+                                uint8_t hash_byte) {
+        return this->try_insert_new(src.element_at(position),
+                                    hash_byte,
+                                    src.count(position));
+    }
+
+    /* Returns false when the value is not in the group. The
+     * value is removed when its count drops to zero. */
+    template <typename StatsCounter>
+    bool decrement(const T &value, uint8_t hash_byte,
+                   StatsCounter &stats, uint32_t &r_count) {
+        for (uint8_t position :
+             this->get_hash_bytes_mask(hash_byte)) {
+            bool found = this->element_at(position) == value;
+            stats.count_key_comparison(found);
+            if (found) {
+                r_count = --m_counts[position];
+                if (r_count == 0) {
+                    this->remove_position(position);
+                }
+                return true;
+            }
+        }
+        return false;
+    }
+
+    void split(CountingGroup &g0, CountingGroup &g1,
+               uint8_t decision_mask) {
+        CountingGroup *dst[2] = {&g0, &g1};
+        T *values = this->value_pointer();
+        for (uint8_t position = 0; position < m_count;
+             position++) {
+            uint8_t hash_byte = m_hash_bytes[position];
+            uint8_t dst_index =
+                (hash_byte & decision_mask) != 0;
+            dst[dst_index]->insert_new(std::move(values[position]),
+                                       hash_byte,
+                                       m_counts[position]);
+            values[position].~T();
+        }
+        m_count = 0;
+        m_used_mask = 0x0;
+    }
+
+    template <typename HashFunc>
+    void update_hash_bytes(const HashFunc &hash_fn,
+                           uint8_t shift) {
+        uint32_t hashes[s_max_size];
+        hash_many(hash_fn, this->value_pointer(), hashes,
+                  m_count);
+        for (uint8_t position = 0; position < m_count;
+             position++) {
+            m_hash_bytes[position] = hashes[position] >> shift;
+        }
+    }
+
+  private:
+    void copy_metadata_from(const CountingGroup &other) {
+        std::memcpy(m_hash_bytes, other.m_hash_bytes,
+                    s_max_size);
+        std::memcpy(m_counts, other.m_counts,
+                    sizeof(m_counts));
+        m_used_mask = other.m_used_mask;
+        m_count = other.m_count;
+    }
+
+    /* The caller has to make sure that the group is not full. */
+    template <typename U>
+    inline void insert_new(U &&value, uint8_t hash_byte,
+                           uint32_t count) {
+        uint8_t position = m_count;
+        new (this->value_pointer() + position)
+            T(std::forward<U>(value));
+        m_hash_bytes[position] = hash_byte;
+        m_counts[position] = count;
+        m_used_mask |= 1 << position;
+        m_count++;
+    }
+
+    inline void remove_position(uint8_t position) {
+        uint8_t last_position = m_count - 1;
+        T *values = this->value_pointer();
+        if (position < last_position) {
+            values[position] = std::move(values[last_position]);
+            m_hash_bytes[position] = m_hash_bytes[last_position];
+            m_counts[position] = m_counts[last_position];
+        }
+        values[last_position].~T();
+        m_used_mask >>= 1;
+        m_count--;
+    }
+
+    inline MatchMask
+    get_hash_bytes_mask(uint8_t short_hash) const {
+        __m128i cmp_hash = _mm_set1_epi8(short_hash);
+        /* group has to be aligned to make this work */
+        __m128i all_hash_bytes = *(__m128i *)m_hash_bytes;
+        __m128i byte_mask =
+            _mm_cmpeq_epi8(all_hash_bytes, cmp_hash);
+        uint16_t bit_mask = _mm_movemask_epi8(byte_mask);
+        return MatchMask(bit_mask & m_used_mask);
+    }
+
+    inline T *value_pointer() const {
+        return (T *)m_values;
+    }
+};
+
+/* Multiset on top of the HashSet layout: every distinct value
+ * is stored once, together with how often it has been added.
+ * Incrementing is a single probe, other than with a HashSet
+ * for deduplication and a separate map for the counts.
+ *
+ * The values are kept in a HashSet with CountingGroup as
+ * group type, so growing, reseeding and the hash bytes are
+ * the ones of HashSet. */
+template <typename T, typename HashFunc>
+class CountingHashSet {
+  private:
+    using GroupType = typename std::conditional<
+        sizeof(T) == 4, CountingGroup<T, 12>,
+        CountingGroup<T, 6>>::type;
+    using SetType = HashSet<T, HashFunc, GroupType>;
+
+    /* Copies are not supported, so its groups are never
+     * shared and can be modified in place. */
+    SetType m_set;
+
+  public:
+    CountingHashSet() = default;
+
+    CountingHashSet(const CountingHashSet &other) = delete;
+    CountingHashSet &
+    operator=(const CountingHashSet &other) = delete;
+
+    /* Number of distinct values. */
+    inline uint32_t size() const {
+        return m_set.m_total_elements;
+    }
+
+    /* Makes room for amount distinct values, see
+     * HashSet::reserve(). */
+    void reserve(uint32_t amount) {
+        m_set.reserve(amount);
+    }
+
+    /* Returns the new count. */
+    uint32_t increment(const T &value, uint32_t amount = 1) {
+        return this->increment(value, m_set.calc_hash(value),
+                               amount);
+    }
+
+    /* Hashes the values in blocks and prefetches the groups
+     * of the upcoming values, like HashSet::contains_many. */
+    void increment_many(const T *values, uint32_t amount) {
+        const uint32_t block_size = 256;
+        const uint32_t prefetch_distance = 8;
+        uint32_t hashes[block_size];
+        for (uint32_t start = 0; start < amount;
+             start += block_size) {
+            uint32_t block_amount =
+                std::min(block_size, amount - start);
+            hash_many(m_set.m_hash_fn, values + start, hashes,
+                      block_amount);
+            uint32_t generation = m_set.m_hash_generation;
+            for (uint32_t i = 0; i < block_amount; i++) {
+                if (i + prefetch_distance < block_amount) {
+                    uint32_t index = m_set.group_index(
+                        hashes[i + prefetch_distance]);
+                    _mm_prefetch(
+                        (const char *)&m_set.m_groups[index],
+                        _MM_HINT_T0);
+                }
+                const T &value = values[start + i];
+                uint32_t hash =
+                    generation == m_set.m_hash_generation
+                        ? hashes[i]
+                        : m_set.calc_hash(value);
+                this->increment(value, hash, 1);
+            }
+        }
+    }
+
+    /* Returns 0 for values that are not in the set. */
+    uint32_t count(const T &value) const {
+        auto &&stats = m_set.stats_counter();
+        uint32_t hash = m_set.calc_hash(value);
+        stats.count_lookup(1);
+        uint32_t *count = this->group(hash).lookup(
+            value, m_set.to_hash_byte(hash), stats);
+        return count == nullptr ? 0 : *count;
+    }
+
+    bool contains(const T &value) const {
+        return this->count(value) > 0;
+    }
+
+    /* Returns the new count. The value is removed when it
+     * reaches zero, values that are not in the set are
+     * ignored. */
+    uint32_t decrement(const T &value) {
+        auto &&stats = m_set.stats_counter();
+        uint32_t hash = m_set.calc_hash(value);
+        stats.count_lookup(1);
+        uint32_t count;
+        bool found = this->group(hash).decrement(
+            value, m_set.to_hash_byte(hash), stats, count);
+        if (!found) {
+            return 0;
+        }
+        if (count == 0) {
+            m_set.m_total_elements--;
+        }
+        return count;
+    }
+
+    /* The k values with the highest counts, highest first.
+     * One pass over the groups with a min-heap of size k. The
+     * order of values with the same count is unspecified. */
+    std::vector<std::pair<T, uint32_t>> top_k(uint32_t k) const {
+        using Item = std::pair<uint32_t, const T *>;
+        auto higher = [](const Item &a, const Item &b) {
+            return a.first > b.first;
+        };
+        std::priority_queue<Item, std::vector<Item>,
+                            decltype(higher)>
+            heap(higher);
+        if (k > 0) {
+            for (const GroupType &group : m_set.m_groups) {
+                for (uint8_t position = 0;
+                     position < group.size(); position++) {
+                    uint32_t count = group.count(position);
+                    const T *value = &group.element_at(position);
+                    if (heap.size() < k) {
+                        heap.push({count, value});
+                    }
+                    else if (count > heap.top().first) {
+                        heap.pop();
+                        heap.push({count, value});
+                    }
+                }
+            }
+        }
+
+        std::vector<std::pair<T, uint32_t>> result;
+        result.reserve(heap.size());
+        while (!heap.empty()) {
+            result.push_back({*heap.top().second, heap.top().first});
+            heap.pop();
+        }
+        std::reverse(result.begin(), result.end());
+        return result;
+    }
+
+    float fullness() const {
+        return m_set.fullness();
+    }
+
+    uint32_t capacity() const {
+        return m_set.capacity();
+    }
+
+    uint64_t size_in_bytes() const {
+        return m_set.size_in_bytes();
+    }
+
+    /* Counters are only collected when compiled with
+     * HASH_TABLE_STATS. */
+    HashTableStats stats() const {
+        return m_set.stats();
+    }
+
+    void reset_stats() {
+        m_set.reset_stats();
+    }
+
+  private:
+    GroupType &group(uint32_t hash) const {
+        return m_set.m_groups[m_set.group_index(hash)];
+    }
+
+    uint32_t increment(const T &value, uint32_t hash,
+                       uint32_t amount) {
+        auto &&stats = m_set.stats_counter();
+        stats.count_lookup(1);
+        uint32_t *count = this->group(hash).lookup(
+            value, m_set.to_hash_byte(hash), stats);
+        if (count != nullptr) {
+            *count += amount;
+            return *count;
+        }
+        m_set.insert_new_with(
+            value, hash, [&](GroupType &group, uint8_t hash_byte) {
+                return group.try_insert_new(value, hash_byte,
+                                            amount);
+            });
+        return amount;
+    }
+};
@@ -0,0 +1,333 @@
+#pragma once
+
+#include "hash_set.hpp"
+#include <stdint.h>
+#include <type_traits>
+
+/* Variant of HashSet in which every value has two candidate
+ * groups instead of one. When both are full, a value from
+ * one of them is kicked out into its other group, which can
+ * repeat up to s_max_kicks times before the table grows.
+ * This allows the table to be filled to more than 90%, while
+ * lookups still only touch two groups.
+ *
+ * The second group is computed from the first one and the
+ * hash byte only (partial key cuckoo hashing), so kicking a
+ * value out does not require hashing it again:
+ *   group_2 = group_1 ^ scramble(hash_byte)
+ * The same formula goes back from group_2 to group_1. */
+template <typename T, typename HashFunc>
+class CuckooHashSet : WithStatsCounter {
+  private:
+    using GroupType = DefaultGroup<T, HashFunc>;
+
+    static const uint32_t s_max_kicks = 256;
+    GroupType *m_groups;
+    uint32_t m_mask;
+    uint8_t m_size_exp;
+    uint8_t m_reseed_size_exp = 0;
+    uint32_t m_total_elements = 0;
+    uint32_t m_random_state = 0x9E3779B9;
+    HashFunc m_hash_fn;
+
+  public:
+    CuckooHashSet() : m_hash_fn(HashFunc::get_new()) {
+        this->allocate(0);
+    }
+
+    CuckooHashSet(std::initializer_list<T> values)
+        : CuckooHashSet() {
+        for (T value : values) {
+            this->insert(value);
+        }
+    }
+
+    ~CuckooHashSet() {
+        this->deallocate();
+    }
+
+    CuckooHashSet(const CuckooHashSet &other) = delete;
+    CuckooHashSet &operator=(const CuckooHashSet &other) = delete;
+
+    inline uint32_t size() const {
+        return m_total_elements;
+    }
+
+    void insert(const T &value) {
+        uint32_t hash = m_hash_fn(value);
+        if (!this->contains(value, hash)) {
+            T copy = value;
+            this->insert_new(copy, hash);
+        }
+    }
+
+    void insert_new(const T &value) {
+        T copy = value;
+        this->insert_new(copy, m_hash_fn(value));
+    }
+
+    bool contains(const T &value) const {
+        return this->contains(value, m_hash_fn(value));
+    }
+
+    void remove(const T &value) {
+        auto &&stats = this->stats_counter();
+        uint32_t hash = m_hash_fn(value);
+        uint8_t hash_byte = to_hash_byte(hash);
+        uint32_t index_1 = hash & m_mask;
+        uint32_t index_2 =
+            this->alternative_index(index_1, hash_byte);
+        stats.count_lookup(2);
+        if (m_groups[index_1].remove(value, hash_byte, stats) ||
+            m_groups[index_2].remove(value, hash_byte, stats)) {
+            m_total_elements--;
+        }
+    }
+
+    float fullness() const {
+        return m_total_elements / (float)this->capacity();
+    }
+
+    uint32_t capacity() const {
+        return this->group_amount() * GroupType::s_max_size;
+    }
+
+    uint64_t size_in_bytes() const {
+        return sizeof(CuckooHashSet) +
+               (uint64_t)this->group_amount() * sizeof(GroupType);
+    }
+
+    /* Counters are only collected when compiled with
+     * HASH_TABLE_STATS. */
+    HashTableStats stats() const {
+        HashTableStats stats = this->stats_counter().snapshot();
+        stats.size = m_total_elements;
+        stats.capacity = this->capacity();
+        return stats;
+    }
+
+    void reset_stats() {
+        this->stats_counter().reset();
+    }
+
+  private:
+    /* The hash byte is mixed from all bits, because the
+     * lower bits are used for the group index already. */
+    static inline uint8_t to_hash_byte(uint32_t hash) {
+        return (hash * 0x9E3779B97F4A7C15ULL) >> 56;
+    }
+
+    /* The lowest bit is always set, so that both candidate
+     * groups are different. */
+    inline uint32_t alternative_index(uint32_t index,
+                                      uint8_t hash_byte) const {
+        return (index ^ ((hash_byte * 0x5bd1e995U) | 1)) &
+               m_mask;
+    }
+
+    inline uint32_t group_amount() const {
+        return m_mask + 1;
+    }
+
+    /* Both groups are loaded and filtered before any value is
+     * compared, so that the cache misses overlap. */
+    bool contains(const T &value, uint32_t hash) const {
+        auto &&stats = this->stats_counter();
+        uint8_t hash_byte = to_hash_byte(hash);
+        uint32_t index_1 = hash & m_mask;
+        uint32_t index_2 =
+            this->alternative_index(index_1, hash_byte);
+        GroupType &group_1 = m_groups[index_1];
+        GroupType &group_2 = m_groups[index_2];
+        MatchMask match_mask_1 =
+            group_1.get_hash_bytes_mask(hash_byte);
+        MatchMask match_mask_2 =
+            group_2.get_hash_bytes_mask(hash_byte);
+        stats.count_lookup(2);
+        return matches_value(group_1, match_mask_1, value,
+                             stats) ||
+               matches_value(group_2, match_mask_2, value, stats);
+    }
+
+    template <typename StatsCounter>
+    static inline bool matches_value(GroupType &group,
+                                     MatchMask match_mask,
+                                     const T &value,
+                                     StatsCounter &stats) {
+        for (uint8_t position : match_mask) {
+            bool found =
+                group.position_contains_value(position, value);
+            stats.count_key_comparison(found);
+            if (found) {
+                return true;
+            }
+        }
+        return false;
+    }
+
+    void insert_new(T &value, uint32_t hash) {
+        uint8_t hash_byte = to_hash_byte(hash);
+        uint32_t index = hash & m_mask;
+        if (!this->try_insert_with_kicks(value, hash_byte,
+                                         index)) {
+            /* value now is the last one that has been kicked
+             * out. Both candidate groups come from the same
+             * hash, so values with the same hash cannot be
+             * spread out by growing. */
+            if (this->should_reseed()) {
+                this->reseed(value);
+            }
+            else {
+                this->grow(value);
+            }
+        }
+        m_total_elements++;
+    }
+
+    /* Tries to place the value into one of its two groups,
+     * kicking out other values if necessary. When this fails,
+     * value, hash_byte and index are the ones of the value
+     * that could not be placed. */
+    bool try_insert_with_kicks(T &value, uint8_t &hash_byte,
+                               uint32_t &index) {
+        for (uint32_t kick = 0; kick < s_max_kicks; kick++) {
+            uint32_t other_index =
+                this->alternative_index(index, hash_byte);
+            GroupType &group_1 = m_groups[index];
+            GroupType &group_2 = m_groups[other_index];
+
+            /* Prefer the emptier group to delay kicks. */
+            GroupType &target = group_1.size() <= group_2.size()
+                                    ? group_1
+                                    : group_2;
+            if (target.try_insert_new(value, hash_byte)) {
+                return true;
+            }
+
+            /* Both are full. Replace a random value in one of
+             * them, which then has to go to its other group. */
+            uint32_t random = this->next_random();
+            uint32_t victim_index =
+                (random & 1) ? index : other_index;
+            GroupType &victim_group = m_groups[victim_index];
+            uint8_t position =
+                (random >> 1) % GroupType::s_max_size;
+
+            T victim = std::move(victim_group.element_at(position));
+            uint8_t victim_hash_byte =
+                victim_group.m_hash_bytes[position];
+            victim_group.remove_position(position);
+            victim_group.try_insert_new(value, hash_byte);
+
+            value = std::move(victim);
+            hash_byte = victim_hash_byte;
+            index = this->alternative_index(victim_index,
+                                            hash_byte);
+        }
+        return false;
+    }
+
+    /* Doubles the table until all values and the one that
+     * is homeless can be placed. Partial keys cannot be used
+     * here, since the new group index needs more hash bits. */
+    void grow(T &homeless_value) REAL_NOINLINE {
+        auto timer = this->stats_counter().time_grow();
+        this->rebuild(m_size_exp + 1, homeless_value);
+    }
+
+    /* See GroupGrowth::should_reseed(). */
+    bool should_reseed() const {
+        return GroupGrowth::should_reseed(
+            m_size_exp, m_reseed_size_exp, this->fullness());
+    }
+
+    /* Places all values again with a new hash function at the
+     * same size. The table only grows when they still do not
+     * fit. */
+    void reseed(T &homeless_value) REAL_NOINLINE {
+        auto timer = this->stats_counter().time_grow();
+        m_reseed_size_exp = m_size_exp;
+        m_hash_fn = HashFunc::get_new();
+        this->rebuild(m_size_exp, homeless_value);
+    }
+
+    /* Starts with the given size. When the values do not fit,
+     * the table reseeds or grows like on an insert. */
+    void rebuild(uint8_t size_exp, T &homeless_value) {
+        GroupType *old_groups = m_groups;
+        uint32_t old_group_amount = this->group_amount();
+
+        while (true) {
+            this->allocate(size_exp);
+            bool success = this->reinsert_all(
+                old_groups, old_group_amount, homeless_value);
+            if (success) {
+                break;
+            }
+            this->deallocate();
+            if (this->should_reseed()) {
+                m_reseed_size_exp = m_size_exp;
+                m_hash_fn = HashFunc::get_new();
+            }
+            else {
+                size_exp++;
+            }
+        }
+
+        destroy_n(old_groups, old_group_amount);
+        std::free(old_groups);
+    }
+
+    bool reinsert_all(GroupType *old_groups,
+                      uint32_t old_group_amount,
+                      T &homeless_value) {
+        for (uint32_t i = 0; i < old_group_amount; i++) {
+            GroupType &group = old_groups[i];
+            for (uint8_t position = 0; position < group.size();
+                 position++) {
+                if (!this->try_copy_in(
+                        group.element_at(position))) {
+                    return false;
+                }
+            }
+        }
+        return this->try_copy_in(homeless_value);
+    }
+
+    bool try_copy_in(const T &value) {
+        T copy = value;
+        uint32_t hash = m_hash_fn(value);
+        uint8_t hash_byte = to_hash_byte(hash);
+        uint32_t index = hash & m_mask;
+        return this->try_insert_with_kicks(copy, hash_byte,
+                                           index);
+    }
+
+    uint32_t next_random() {
+        /* xorshift32 */
+        uint32_t x = m_random_state;
+        x ^= x << 13;
+        x ^= x >> 17;
+        x ^= x << 5;
+        m_random_state = x;
+        return x;
+    }
+
+    void allocate(uint8_t size_exp) {
+        static_assert(sizeof(GroupType) % 64 == 0,
+                      "sizeof(GroupType) has to be a "
+                      "multiple of 64");
+        uint32_t length = 1 << size_exp;
+        m_size_exp = size_exp;
+        m_mask = length - 1;
+        m_groups = allocate_cache_lines<GroupType>(length);
+        for (uint32_t i = 0; i < length; i++) {
+            new (m_groups + i) GroupType();
+        }
+    }
+
+    void deallocate() {
+        destroy_n(m_groups, this->group_amount());
+        std::free(m_groups);
+    }
+};
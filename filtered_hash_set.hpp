@@ -0,0 +1,132 @@
+#pragma once
+
+#include "bloom_filter.hpp"
+#include "hash_set.hpp"
+#include <algorithm>
+
+/* HashSet with a blocked bloom filter in front of it.
+ * Lookups of values that are not in the set usually only
+ * touch the (much smaller) filter instead of a group.
+ *
+ * The filter cannot forget values. Therefore it is rebuilt
+ * from the set when too many values have been removed or
+ * when the set outgrew the size the filter was made for. */
+template <typename T, typename HashFunc>
+class FilteredHashSet {
+  private:
+    using SetType = HashSet<T, HashFunc>;
+
+    SetType m_set;
+    BlockedBloomFilter m_filter;
+    uint32_t m_filter_capacity = 0;
+    uint32_t m_removed_since_rebuild = 0;
+
+  public:
+    FilteredHashSet() {}
+
+    FilteredHashSet(std::initializer_list<T> values) {
+        for (T value : values) {
+            this->insert(value);
+        }
+    }
+
+    FilteredHashSet(std::vector<T> &values)
+        : m_set(values) {
+        this->rebuild_filter();
+    }
+
+    inline uint32_t size() {
+        return m_set.size();
+    }
+
+    void insert(T &&value) {
+        T val = value;
+        this->insert(val);
+    }
+
+    void insert(T &value) {
+        uint32_t hash = m_set.calc_hash(value);
+        if (!m_set.contains(value, hash)) {
+            this->insert_new(value, hash);
+        }
+    }
+
+    void insert_new(T &&value) {
+        T val = value;
+        this->insert_new(val);
+    }
+
+    void insert_new(T &value) {
+        uint32_t hash = m_set.calc_hash(value);
+        this->insert_new(value, hash);
+    }
+
+    bool contains(const T &value) {
+        uint32_t hash = m_set.calc_hash(value);
+        if (!m_filter.may_contain(hash)) {
+            return false;
+        }
+        return m_set.contains(value, hash);
+    }
+
+    void remove(const T &&value) {
+        T val = value;
+        this->remove(val);
+    }
+
+    void remove(const T &value) {
+        uint32_t old_size = m_set.size();
+        m_set.remove(value);
+        if (m_set.size() < old_size) {
+            m_removed_since_rebuild++;
+            if (m_removed_since_rebuild >
+                m_filter_capacity / 4) {
+                this->rebuild_filter();
+            }
+        }
+    }
+
+    void rebuild_filter() {
+        m_filter_capacity =
+            std::max<uint32_t>(m_set.size() * 3 / 2, 64);
+        m_filter = BlockedBloomFilter(m_filter_capacity);
+        for (const T &value : m_set) {
+            m_filter.insert(m_set.calc_hash(value));
+        }
+        m_removed_since_rebuild = 0;
+    }
+
+    const BlockedBloomFilter &filter() const {
+        return m_filter;
+    }
+
+    typename SetType::Iterator begin() const {
+        return m_set.begin();
+    }
+
+    typename SetType::Iterator end() const {
+        return m_set.end();
+    }
+
+  private:
+    void insert_new(T &value, uint32_t hash) {
+        uint32_t generation = m_set.m_hash_generation;
+        m_set.insert_new(value, hash);
+        if (m_set.m_hash_generation != generation) {
+            /* All hashes in the filter are stale. */
+            this->rebuild_filter();
+        }
+        else {
+            this->add_to_filter(hash);
+        }
+    }
+
+    void add_to_filter(uint32_t hash) {
+        if (m_set.size() > m_filter_capacity) {
+            this->rebuild_filter();
+        }
+        else {
+            m_filter.insert(hash);
+        }
+    }
+};
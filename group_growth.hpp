@@ -0,0 +1,78 @@
+#pragma once
+
+#include <stdint.h>
+
+/* Sizing decisions of HashSet and of the variants that use
+ * its layout: there are 2^size_exp groups, the lowest
+ * size_exp bits of the hash select the group and one byte of
+ * the hash, starting at the hash byte shift, is compared
+ * inside the group. Every table keeps its own size exponent
+ * and shift, only the decisions are made here. */
+class GroupGrowth {
+  public:
+    /* A group that is full while the set is emptier than this
+     * can only be explained by a hash function that is bad
+     * for the values, e.g. because they were chosen to
+     * collide. With random values that practically does not
+     * happen before there are around a billion groups. */
+    static constexpr float s_max_reseed_fullness = 1.0f / 64;
+
+    /* Size exponent for amount values in groups with
+     * group_size slots, with enough room that inserting them
+     * usually does not have to grow. */
+    static uint8_t size_exp_for(uint32_t amount,
+                                uint32_t group_size) {
+        uint32_t length = amount / group_size;
+        uint8_t exp = 1;
+        while ((1u << exp) < length) {
+            exp++;
+        }
+        return exp + 1;
+    }
+
+    /* Shift of the hash bytes in groups that are allocated
+     * with the size exponent directly instead of growing. */
+    static uint8_t hash_byte_shift_for(uint8_t size_exp) {
+        return (size_exp / 3) * 3;
+    }
+
+    /* Growing splits every group into two by the next bit of
+     * the hash bytes, so the values do not have to be hashed
+     * again. Every third doubling the hash bytes are moved up
+     * to the size exponent, before their bits run out. The
+     * size exponent of a merged HashSet can be up to eight
+     * above its shift, see HashSet::merge_groups_of().
+     *
+     * Returns the shift the hash bytes need before the groups
+     * of size_exp are split. When it differs from the current
+     * one, the hash bytes have to be recalculated. */
+    static uint8_t shift_for_grow(uint8_t size_exp,
+                                  uint8_t hash_byte_shift) {
+        if ((size_exp % 3 == 0 && size_exp > 0) ||
+            size_exp - hash_byte_shift > 7) {
+            return size_exp;
+        }
+        return hash_byte_shift;
+    }
+
+    /* Bit of the hash byte that decides whether a value stays
+     * in group i or moves to group i + 2^size_exp. */
+    static uint8_t decision_mask(uint8_t size_exp,
+                                 uint8_t hash_byte_shift) {
+        return 1 << (size_exp - hash_byte_shift);
+    }
+
+    /* Growing does not help against values that collide,
+     * because they stay together in the same group when it is
+     * split, so the set would grow until it is huge. Instead,
+     * the values are reinserted with a new hash function into
+     * groups of the same size. This is only tried once per
+     * size, so that a table that really is that unbalanced
+     * still grows. */
+    static bool should_reseed(uint8_t size_exp,
+                              uint8_t reseed_size_exp,
+                              float fullness) {
+        return size_exp != reseed_size_exp &&
+               fullness < s_max_reseed_fullness;
+    }
+};
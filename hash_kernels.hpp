@@ -0,0 +1,283 @@
+#pragma once
+
+#include <stdint.h>
+
+#include <immintrin.h>
+
+/* Batch versions of the hash functions in hashing.hpp, so
+ * that code that hashes many values at once (building a set
+ * from a vector, batched lookups, recomputing hash bytes)
+ * does not go through the scalar function for every value.
+ *
+ * The kernels are compiled for AVX2 and AVX-512 with target
+ * attributes and chosen at runtime, so the rest of the code
+ * does not need special compiler flags. All levels return
+ * exactly the same hashes as the scalar functions. */
+
+enum class SimdLevel {
+    Scalar = 0,
+    AVX2 = 1,
+    AVX512 = 2,
+};
+
+inline SimdLevel detect_simd_level() {
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx512f")) {
+        return SimdLevel::AVX512;
+    }
+    if (__builtin_cpu_supports("avx2")) {
+        return SimdLevel::AVX2;
+    }
+    return SimdLevel::Scalar;
+}
+
+inline SimdLevel simd_level() {
+    static const SimdLevel level = detect_simd_level();
+    return level;
+}
+
+/**************** HashBits32 ****************/
+
+/* m * value + n reduced modulo 2^31 - 1, see HashBits32. */
+inline uint32_t mersenne31_hash(uint32_t m, uint32_t n,
+                                uint32_t value) {
+    const uint64_t prime = (1ULL << 31) - 1;
+    uint64_t x = m * (uint64_t)value + n;
+    uint32_t x1 = (x >> 31) & prime;
+    uint32_t x2 = x & prime;
+    uint32_t s = x1 + x2;
+    if (s > prime) s -= prime;
+    return s;
+}
+
+inline void mersenne31_hash_many__scalar(uint32_t m, uint32_t n,
+                                         const uint32_t *values,
+                                         uint32_t *r_hashes,
+                                         uint32_t amount) {
+    for (uint32_t i = 0; i < amount; i++) {
+        r_hashes[i] = mersenne31_hash(m, n, values[i]);
+    }
+}
+
+__attribute__((target("avx2"))) inline __m256i
+mersenne31_reduce__avx2(__m256i products, __m256i n,
+                        __m256i prime) {
+    __m256i x = _mm256_add_epi64(products, n);
+    __m256i x1 = _mm256_and_si256(_mm256_srli_epi64(x, 31), prime);
+    __m256i x2 = _mm256_and_si256(x, prime);
+    __m256i s = _mm256_add_epi64(x1, x2);
+    __m256i too_large = _mm256_cmpgt_epi64(s, prime);
+    return _mm256_sub_epi64(s, _mm256_and_si256(too_large, prime));
+}
+
+/* The products need 64 bits, so the even and the odd lanes
+ * are multiplied separately and merged again at the end. */
+__attribute__((target("avx2"))) inline void
+mersenne31_hash_many__avx2(uint32_t m, uint32_t n,
+                           const uint32_t *values,
+                           uint32_t *r_hashes, uint32_t amount) {
+    const __m256i m_vec = _mm256_set1_epi64x(m);
+    const __m256i n_vec = _mm256_set1_epi64x(n);
+    const __m256i prime = _mm256_set1_epi64x((1ULL << 31) - 1);
+
+    uint32_t i = 0;
+    for (; i + 8 <= amount; i += 8) {
+        __m256i v = _mm256_loadu_si256((const __m256i *)(values + i));
+        __m256i even = mersenne31_reduce__avx2(
+            _mm256_mul_epu32(v, m_vec), n_vec, prime);
+        __m256i odd = mersenne31_reduce__avx2(
+            _mm256_mul_epu32(_mm256_srli_epi64(v, 32), m_vec),
+            n_vec, prime);
+        __m256i hashes =
+            _mm256_or_si256(even, _mm256_slli_epi64(odd, 32));
+        _mm256_storeu_si256((__m256i *)(r_hashes + i), hashes);
+    }
+    mersenne31_hash_many__scalar(m, n, values + i, r_hashes + i,
+                                 amount - i);
+}
+
+/* GCC 12 implements many AVX-512 intrinsics with an
+ * uninitialized pass-through value and then warns that it
+ * may be used, in every file that includes this header. The
+ * value is never used, so the warning is turned off for the
+ * kernels only. */
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wmaybe-uninitialized"
+
+__attribute__((target("avx512f"))) inline __m512i
+mersenne31_reduce__avx512(__m512i products, __m512i n,
+                          __m512i prime) {
+    __m512i x = _mm512_add_epi64(products, n);
+    __m512i x1 = _mm512_and_si512(_mm512_srli_epi64(x, 31), prime);
+    __m512i x2 = _mm512_and_si512(x, prime);
+    __m512i s = _mm512_add_epi64(x1, x2);
+    __mmask8 too_large = _mm512_cmpgt_epu64_mask(s, prime);
+    return _mm512_mask_sub_epi64(s, too_large, s, prime);
+}
+
+/* The remainder is handled with masked loads and stores. */
+__attribute__((target("avx512f"))) inline void
+mersenne31_hash_many__avx512(uint32_t m, uint32_t n,
+                             const uint32_t *values,
+                             uint32_t *r_hashes, uint32_t amount) {
+    const __m512i m_vec = _mm512_set1_epi64(m);
+    const __m512i n_vec = _mm512_set1_epi64(n);
+    const __m512i prime = _mm512_set1_epi64((1ULL << 31) - 1);
+
+    for (uint32_t i = 0; i < amount; i += 16) {
+        uint32_t left = amount - i;
+        __mmask16 mask =
+            left >= 16 ? 0xFFFF : (__mmask16)((1 << left) - 1);
+        __m512i v = _mm512_maskz_loadu_epi32(mask, values + i);
+        __m512i even = mersenne31_reduce__avx512(
+            _mm512_mul_epu32(v, m_vec), n_vec, prime);
+        __m512i odd = mersenne31_reduce__avx512(
+            _mm512_mul_epu32(_mm512_srli_epi64(v, 32), m_vec),
+            n_vec, prime);
+        __m512i hashes =
+            _mm512_or_si512(even, _mm512_slli_epi64(odd, 32));
+        _mm512_mask_storeu_epi32(r_hashes + i, mask, hashes);
+    }
+}
+#pragma GCC diagnostic pop
+
+inline void mersenne31_hash_many(uint32_t m, uint32_t n,
+                                 const uint32_t *values,
+                                 uint32_t *r_hashes,
+                                 uint32_t amount,
+                                 SimdLevel level = simd_level()) {
+    switch (level) {
+    case SimdLevel::AVX512:
+        mersenne31_hash_many__avx512(m, n, values, r_hashes,
+                                     amount);
+        break;
+    case SimdLevel::AVX2:
+        mersenne31_hash_many__avx2(m, n, values, r_hashes,
+                                   amount);
+        break;
+    default:
+        mersenne31_hash_many__scalar(m, n, values, r_hashes,
+                                     amount);
+        break;
+    }
+}
+
+/************** Multiply-Shift **************/
+
+/* (multiplier * value + increment) >> 32 with 64 bit
+ * arithmetic, see MultiplyShift32. */
+inline uint32_t multiply_shift_hash(uint64_t multiplier,
+                                    uint64_t increment,
+                                    uint32_t value) {
+    return (multiplier * value + increment) >> 32;
+}
+
+inline void
+multiply_shift_hash_many__scalar(uint64_t multiplier,
+                                 uint64_t increment,
+                                 const uint32_t *values,
+                                 uint32_t *r_hashes,
+                                 uint32_t amount) {
+    for (uint32_t i = 0; i < amount; i++) {
+        r_hashes[i] =
+            multiply_shift_hash(multiplier, increment, values[i]);
+    }
+}
+
+/* Bits 32 to 63 of multiplier * value + increment are
+ *   high(low(multiplier) * value + increment)
+ *   + low(high(multiplier) * value),
+ * so one 32x32->64 and one 32x32->32 multiplication per lane
+ * are enough. */
+__attribute__((target("avx2"))) inline void
+multiply_shift_hash_many__avx2(uint64_t multiplier,
+                               uint64_t increment,
+                               const uint32_t *values,
+                               uint32_t *r_hashes,
+                               uint32_t amount) {
+    const __m256i low_multiplier =
+        _mm256_set1_epi64x((uint32_t)multiplier);
+    const __m256i high_multiplier =
+        _mm256_set1_epi32(multiplier >> 32);
+    const __m256i increment_vec = _mm256_set1_epi64x(increment);
+    const __m256i high_dwords =
+        _mm256_set1_epi64x(0xFFFFFFFF00000000ULL);
+
+    uint32_t i = 0;
+    for (; i + 8 <= amount; i += 8) {
+        __m256i v = _mm256_loadu_si256((const __m256i *)(values + i));
+        __m256i even = _mm256_add_epi64(
+            _mm256_mul_epu32(v, low_multiplier), increment_vec);
+        __m256i odd = _mm256_add_epi64(
+            _mm256_mul_epu32(_mm256_srli_epi64(v, 32),
+                             low_multiplier),
+            increment_vec);
+        __m256i high_parts = _mm256_blendv_epi8(
+            _mm256_srli_epi64(even, 32), odd, high_dwords);
+        __m256i hashes = _mm256_add_epi32(
+            high_parts, _mm256_mullo_epi32(v, high_multiplier));
+        _mm256_storeu_si256((__m256i *)(r_hashes + i), hashes);
+    }
+    multiply_shift_hash_many__scalar(multiplier, increment,
+                                     values + i, r_hashes + i,
+                                     amount - i);
+}
+
+/* See the pragma before mersenne31_reduce__avx512(). */
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wmaybe-uninitialized"
+
+__attribute__((target("avx512f"))) inline void
+multiply_shift_hash_many__avx512(uint64_t multiplier,
+                                 uint64_t increment,
+                                 const uint32_t *values,
+                                 uint32_t *r_hashes,
+                                 uint32_t amount) {
+    const __m512i low_multiplier =
+        _mm512_set1_epi64((uint32_t)multiplier);
+    const __m512i high_multiplier =
+        _mm512_set1_epi32(multiplier >> 32);
+    const __m512i increment_vec = _mm512_set1_epi64(increment);
+    /* Takes the odd dwords from the second operand. */
+    const __mmask16 odd_dwords = 0xAAAA;
+
+    for (uint32_t i = 0; i < amount; i += 16) {
+        uint32_t left = amount - i;
+        __mmask16 mask =
+            left >= 16 ? 0xFFFF : (__mmask16)((1 << left) - 1);
+        __m512i v = _mm512_maskz_loadu_epi32(mask, values + i);
+        __m512i even = _mm512_add_epi64(
+            _mm512_mul_epu32(v, low_multiplier), increment_vec);
+        __m512i odd = _mm512_add_epi64(
+            _mm512_mul_epu32(_mm512_srli_epi64(v, 32),
+                             low_multiplier),
+            increment_vec);
+        __m512i high_parts = _mm512_mask_blend_epi32(
+            odd_dwords, _mm512_srli_epi64(even, 32), odd);
+        __m512i hashes = _mm512_add_epi32(
+            high_parts, _mm512_mullo_epi32(v, high_multiplier));
+        _mm512_mask_storeu_epi32(r_hashes + i, mask, hashes);
+    }
+}
+#pragma GCC diagnostic pop
+
+inline void
+multiply_shift_hash_many(uint64_t multiplier, uint64_t increment,
+                         const uint32_t *values,
+                         uint32_t *r_hashes, uint32_t amount,
+                         SimdLevel level = simd_level()) {
+    switch (level) {
+    case SimdLevel::AVX512:
+        multiply_shift_hash_many__avx512(multiplier, increment,
+                                         values, r_hashes, amount);
+        break;
+    case SimdLevel::AVX2:
+        multiply_shift_hash_many__avx2(multiplier, increment,
+                                       values, r_hashes, amount);
+        break;
+    default:
+        multiply_shift_hash_many__scalar(multiplier, increment,
+                                         values, r_hashes, amount);
+        break;
+    }
+}
@@ -0,0 +1,187 @@
+#include "hash_quality.hpp"
+#include "hashing.hpp"
+#include "open_addressing.hpp"
+#include <iomanip>
+#include <iostream>
+
+/* Prints the quality of every hash function on the bits that
+ * HashSet uses at a few sizes. Every function is measured
+ * with several random instances, because a linear function
+ * with an unlucky seed can cluster structured keys while
+ * most seeds do not. A function is rejected when the median
+ * instance clusters the group index or the hash byte on any
+ * key set; then the program returns 1.
+ *
+ * The hash byte is checked with the shift a set has after
+ * growing ("byte") and after reserve() ("rbyte"), which
+ * differ at some sizes.
+ * The chi-square columns show the median instance, "bad" is
+ * the number of instances that cluster. MyHash is only used
+ * through SeededHash, its rows are shown for comparison but
+ * do not reject anything. */
+
+static const uint8_t s_size_exps[] = {8, 12, 16};
+static const uint32_t s_key_amount = 1 << 19;
+static const uint32_t s_avalanche_key_amount = 1 << 12;
+static const uint32_t s_instance_amount = 9;
+
+/* Random keys stay below this with a probability of about
+ * 1 - 1e-9 per value. Structured keys are allowed the same,
+ * anything above is clearly not uniform. */
+static const double s_max_chi_square_z = 6;
+
+/* MyHash has a non-const call operator. */
+template <typename T>
+struct ConstMyHash {
+    uint32_t operator()(const T &value) const {
+        return MyHash<T>{}(value);
+    }
+};
+
+static std::vector<uint64_t>
+to_64_bit(const std::vector<uint32_t> &keys, uint8_t shift) {
+    std::vector<uint64_t> result(keys.size());
+    for (uint32_t i = 0; i < keys.size(); i++) {
+        result[i] = (uint64_t)keys[i] << shift;
+    }
+    return result;
+}
+
+static bool s_all_passed = true;
+
+static void print_header() {
+    std::cout << std::left << std::setw(24) << "hash"
+              << std::setw(12) << "keys";
+    for (uint8_t exp : s_size_exps) {
+        std::cout << std::setw(9) << ("group" + std::to_string(exp))
+                  << std::setw(9) << ("byte" + std::to_string(exp))
+                  << std::setw(9) << ("rbyte" + std::to_string(exp));
+    }
+    std::cout << std::setw(5) << "bad" << std::setw(11)
+              << "avalanche" << std::setw(10) << "hash/cyc"
+              << "verdict" << std::endl;
+}
+
+/* Keeps huge values from breaking the columns. */
+static double clamp_for_print(double value) {
+    return std::min(value, 99999.0);
+}
+
+template <typename NewHash, typename Key>
+static void report(const char *hash_name, const char *keys_name,
+                   const NewHash &new_hash,
+                   const std::vector<Key> &keys, bool gated) {
+    uint32_t column_amount = sizeof(s_size_exps) * 3;
+    std::vector<std::vector<double>> columns(column_amount);
+    uint32_t bad_instances = 0;
+    for (uint32_t i = 0; i < s_instance_amount; i++) {
+        auto hash_fn = new_hash();
+        double worst = 0;
+        for (uint32_t e = 0; e < sizeof(s_size_exps); e++) {
+            uint8_t exp = s_size_exps[e];
+            double group_z =
+                chi_square_z(hash_fn, keys, group_index_bits(exp));
+            double grown_byte_z = chi_square_z(
+                hash_fn, keys,
+                hash_byte_filter_bits(exp,
+                                      grown_hash_byte_shift(exp)));
+            double reserved_byte_z = chi_square_z(
+                hash_fn, keys,
+                hash_byte_filter_bits(
+                    exp, reserved_hash_byte_shift(exp)));
+            columns[e * 3].push_back(group_z);
+            columns[e * 3 + 1].push_back(grown_byte_z);
+            columns[e * 3 + 2].push_back(reserved_byte_z);
+            worst = std::max(
+                {worst, group_z, grown_byte_z, reserved_byte_z});
+        }
+        bad_instances += worst >= s_max_chi_square_z;
+    }
+
+    bool passed = true;
+    std::cout << std::left << std::setw(24) << hash_name
+              << std::setw(12) << keys_name << std::fixed
+              << std::setprecision(1);
+    for (std::vector<double> &column : columns) {
+        std::nth_element(column.begin(),
+                         column.begin() + column.size() / 2,
+                         column.end());
+        double median = column[column.size() / 2];
+        passed &= median < s_max_chi_square_z;
+        std::cout << std::setw(9) << clamp_for_print(median);
+    }
+
+    auto hash_fn = new_hash();
+    std::vector<Key> avalanche_keys(
+        keys.begin(), keys.begin() + s_avalanche_key_amount);
+    double bias = avalanche_bias(hash_fn, avalanche_keys, {0, 32});
+    double speed = hashes_per_cycle(hash_fn, avalanche_keys);
+    std::cout << std::setw(5) << bad_instances
+              << std::setprecision(3) << std::setw(11) << bias
+              << std::setw(10) << speed
+              << (passed ? "ok" : "rejected")
+              << (gated ? "" : " (not gated)") << std::endl;
+    if (gated) {
+        s_all_passed &= passed;
+    }
+}
+
+template <typename NewHash>
+static void report_32_bit(const char *name, const NewHash &new_hash,
+                          bool gated = true) {
+    report(name, "sequential", new_hash,
+           sequential_keys(s_key_amount), gated);
+    report(name, "strided", new_hash,
+           strided_keys(s_key_amount, 13), gated);
+    report(name, "random", new_hash, random_keys(s_key_amount),
+           gated);
+}
+
+template <typename NewHash>
+static void report_64_bit(const char *name, const NewHash &new_hash,
+                          bool gated = true) {
+    report(name, "sequential", new_hash,
+           to_64_bit(sequential_keys(s_key_amount), 0), gated);
+    report(name, "strided", new_hash,
+           to_64_bit(sequential_keys(s_key_amount), 32), gated);
+    std::vector<uint64_t> random(s_key_amount);
+    std::vector<uint32_t> low = random_keys(s_key_amount, 1);
+    std::vector<uint32_t> high = random_keys(s_key_amount, 2);
+    for (uint32_t i = 0; i < s_key_amount; i++) {
+        random[i] = ((uint64_t)high[i] << 32) | low[i];
+    }
+    report(name, "random", new_hash, random, gated);
+}
+
+template <typename NewHash>
+static void report_string(const char *name, const NewHash &new_hash,
+                          bool gated = true) {
+    report(name, "sequential", new_hash,
+           sequential_string_keys(s_key_amount), gated);
+    report(name, "random", new_hash,
+           random_string_keys(s_key_amount, 8), gated);
+}
+
+int main() {
+    print_header();
+    report_32_bit("HashBits32", HashBits32::get_new);
+    report_32_bit("MultiplyShift32", MultiplyShift32::get_new);
+    report_32_bit("SeededHash<uint32_t>",
+                  []() { return SeededHash<uint32_t>(); });
+    report_32_bit(
+        "MyHash<uint32_t>",
+        []() { return ConstMyHash<uint32_t>(); }, false);
+    report_64_bit("HashBits64", HashBits64::get_new);
+    report_64_bit("SeededHash<uint64_t>",
+                  []() { return SeededHash<uint64_t>(); });
+    report_64_bit(
+        "MyHash<uint64_t>",
+        []() { return ConstMyHash<uint64_t>(); }, false);
+    report_string("HashString", HashString::get_new);
+    report_string("SeededHash<std::string>",
+                  []() { return SeededHash<std::string>(); });
+    report_string(
+        "MyHash<std::string>",
+        []() { return ConstMyHash<std::string>(); }, false);
+    return s_all_passed ? 0 : 1;
+}
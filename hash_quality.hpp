@@ -0,0 +1,218 @@
+#pragma once
+
+#include "group_growth.hpp"
+#include <algorithm>
+#include <cmath>
+#include <random>
+#include <stdint.h>
+#include <string>
+#include <vector>
+
+#include <x86intrin.h>
+
+/* Measurements that tell whether a hash function works for
+ * HashSet. HashSet does not use the whole hash: the lowest
+ * size_exp bits select the group and one byte above
+ * m_hash_byte_shift is compared with SIMD inside the group.
+ * A function can look fine on all 32 bits and still put
+ * many values into few groups or give the values of a group
+ * the same hash byte, which turns every lookup into key
+ * comparisons. So the distribution is checked on exactly
+ * these bits. */
+
+struct HashBitRange {
+    uint8_t shift;
+    uint8_t bits;
+
+    uint32_t extract(uint32_t hash) const {
+        return (hash >> shift) & ((1ULL << bits) - 1);
+    }
+};
+
+/* The shift of a set that grew to size_exp one insert at a
+ * time. */
+inline uint8_t grown_hash_byte_shift(uint8_t size_exp) {
+    uint8_t shift = 0;
+    for (uint8_t exp = 0; exp < size_exp; exp++) {
+        shift = GroupGrowth::shift_for_grow(exp, shift);
+    }
+    return shift;
+}
+
+/* The shift of a set that got size_exp from reserve() or the
+ * vector constructor. It can be higher than after growing,
+ * e.g. 12 instead of 9 at size_exp 12. */
+inline uint8_t reserved_hash_byte_shift(uint8_t size_exp) {
+    return GroupGrowth::hash_byte_shift_for(size_exp);
+}
+
+inline HashBitRange group_index_bits(uint8_t size_exp) {
+    return {0, size_exp};
+}
+
+/* The bits of the hash byte that are above the group index.
+ * The ones below it are the same for all values of a group,
+ * so only these can tell them apart. */
+inline HashBitRange hash_byte_filter_bits(uint8_t size_exp,
+                                          uint8_t shift) {
+    uint8_t start = std::max(shift, size_exp);
+    return {start, (uint8_t)(shift + 8 - start)};
+}
+
+/* Chi-square test of the bucket counts, normalized to
+ * standard deviations: a uniform distribution gives values
+ * around 0, clustering gives large positive values. Keys
+ * that are spread more evenly than random ones, like
+ * sequential keys under a multiplicative hash, give
+ * negative values. There should be at least about 5 keys
+ * per bucket. */
+template <typename Hash, typename Key>
+double chi_square_z(const Hash &hash_fn,
+                    const std::vector<Key> &keys,
+                    HashBitRange range) {
+    uint32_t bucket_amount = 1 << range.bits;
+    std::vector<uint32_t> counts(bucket_amount, 0);
+    for (const Key &key : keys) {
+        counts[range.extract(hash_fn(key))]++;
+    }
+    double expected = keys.size() / (double)bucket_amount;
+    double chi_square = 0;
+    for (uint32_t count : counts) {
+        double difference = count - expected;
+        chi_square += difference * difference / expected;
+    }
+    double degrees = bucket_amount - 1;
+    return (chi_square - degrees) / std::sqrt(2 * degrees);
+}
+
+inline void flip_bit(uint32_t &key, uint32_t bit) {
+    key ^= 1u << bit;
+}
+
+inline void flip_bit(int &key, uint32_t bit) {
+    key ^= 1u << bit;
+}
+
+inline void flip_bit(uint64_t &key, uint32_t bit) {
+    key ^= 1ULL << bit;
+}
+
+inline void flip_bit(std::string &key, uint32_t bit) {
+    key[bit / 8] ^= 1 << (bit % 8);
+}
+
+inline uint32_t input_bits(const std::string &key) {
+    return key.size() * 8;
+}
+
+template <typename Key>
+uint32_t input_bits(const Key &) {
+    return sizeof(Key) * 8;
+}
+
+/* Flips every input bit of every key and returns the largest
+ * deviation from 0.5 of the probability that an output bit
+ * in range flips. 0 is a perfect avalanche, 0.5 means that
+ * an output bit always or never follows an input bit. Linear
+ * functions like HashBits32 have a large bias on purpose,
+ * HashSet only needs their distribution. */
+template <typename Hash, typename Key>
+double avalanche_bias(const Hash &hash_fn,
+                      const std::vector<Key> &keys,
+                      HashBitRange range) {
+    uint32_t in_bits = input_bits(keys[0]);
+    std::vector<uint32_t> flips(in_bits * range.bits, 0);
+    for (const Key &key : keys) {
+        uint32_t hash = range.extract(hash_fn(key));
+        for (uint32_t in_bit = 0; in_bit < in_bits; in_bit++) {
+            Key changed = key;
+            flip_bit(changed, in_bit);
+            uint32_t difference =
+                hash ^ range.extract(hash_fn(changed));
+            for (uint32_t out_bit = 0; out_bit < range.bits;
+                 out_bit++) {
+                flips[in_bit * range.bits + out_bit] +=
+                    (difference >> out_bit) & 1;
+            }
+        }
+    }
+    double max_bias = 0;
+    for (uint32_t count : flips) {
+        double bias =
+            std::abs(count / (double)keys.size() - 0.5);
+        max_bias = std::max(max_bias, bias);
+    }
+    return max_bias;
+}
+
+/* Throughput of hashing keys that are in the cache already.
+ * The time stamp counter runs at the nominal frequency, so
+ * the result is only comparable on the same machine. */
+template <typename Hash, typename Key>
+double hashes_per_cycle(const Hash &hash_fn,
+                        const std::vector<Key> &keys,
+                        uint32_t rounds = 16) {
+    uint32_t sum = 0;
+    uint64_t start = __rdtsc();
+    for (uint32_t round = 0; round < rounds; round++) {
+        for (const Key &key : keys) {
+            sum += hash_fn(key);
+        }
+    }
+    uint64_t cycles = __rdtsc() - start;
+    /* Keeps the loop from being removed. */
+    asm volatile("" : : "r"(sum));
+    return (double)keys.size() * rounds / cycles;
+}
+
+/* Key sets that are typical for the experiments. The
+ * strided ones have only high bits set, which is what
+ * breaks functions that mostly use the low bits. */
+inline std::vector<uint32_t> sequential_keys(uint32_t amount) {
+    std::vector<uint32_t> keys(amount);
+    for (uint32_t i = 0; i < amount; i++) {
+        keys[i] = i;
+    }
+    return keys;
+}
+
+inline std::vector<uint32_t> strided_keys(uint32_t amount,
+                                          uint8_t stride_exp) {
+    std::vector<uint32_t> keys(amount);
+    for (uint32_t i = 0; i < amount; i++) {
+        keys[i] = (uint64_t)i << stride_exp;
+    }
+    return keys;
+}
+
+inline std::vector<uint32_t> random_keys(uint32_t amount,
+                                         uint32_t seed = 0) {
+    std::mt19937 engine(seed);
+    std::vector<uint32_t> keys(amount);
+    for (uint32_t &key : keys) {
+        key = engine();
+    }
+    return keys;
+}
+
+inline std::vector<std::string>
+sequential_string_keys(uint32_t amount) {
+    std::vector<std::string> keys(amount);
+    for (uint32_t i = 0; i < amount; i++) {
+        keys[i] = "key_" + std::to_string(i);
+    }
+    return keys;
+}
+
+inline std::vector<std::string>
+random_string_keys(uint32_t amount, uint32_t length,
+                   uint32_t seed = 0) {
+    std::mt19937 engine(seed);
+    std::vector<std::string> keys(amount, std::string(length, ' '));
+    for (std::string &key : keys) {
+        for (char &c : key) {
+            c = 'a' + engine() % 26;
+        }
+    }
+    return keys;
+}
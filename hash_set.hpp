@@ -1,7 +1,12 @@
 #pragma once
 
+#include "group_growth.hpp"
+#include "hashing.hpp"
+#include "radix_partition.hpp"
+#include "stats.hpp"
 #include "utils.hpp"
 #include <assert.h>
+#include <atomic>
 #include <cstring>
 #include <iostream>
 #include <memory>
@@ -20,13 +25,13 @@ class Group {
     char m_hash_bytes[s_max_size];
     uint16_t m_used_mask;
     uint8_t m_count;
-    char m_values[sizeof(T) * s_max_size];
+    alignas(T) char m_values[sizeof(T) * s_max_size];
 
     struct MeasureSize {
         char s1[sizeof(m_hash_bytes)];
         uint16_t s2;
         uint8_t s3;
-        char s4[sizeof(m_values)];
+        alignas(T) char s4[sizeof(m_values)];
     };
 
     static const uint32_t s_required_size =
@@ -107,39 +112,41 @@ class Group {
         return true;
     }
 
-    inline bool contains(const T &value,
-                         uint8_t hash_byte) const NOINLINE {
-        uint16_t match_mask =
-            this->get_hash_bytes_mask(hash_byte);
+    /* Copies the value at the position of the other group,
+     * e.g. when HashSet reseeds. */
+    inline bool try_insert_from(Group &src, uint8_t position,
+                                uint8_t hash_byte) {
+        return this->try_insert_new(src.element_at(position),
+                                    hash_byte);
+    }
 
-        while (match_mask != 0) {
-            uint16_t single_bit = keep_one_bit(match_mask);
-            uint8_t position =
-                this->get_bit_position(single_bit);
-            if (this->position_contains_value(position,
-                                              value)) {
+    template <typename StatsCounter>
+    inline bool contains(const T &value, uint8_t hash_byte,
+                         StatsCounter &stats) const NOINLINE {
+        for (uint8_t position :
+             this->get_hash_bytes_mask(hash_byte)) {
+            bool found =
+                this->position_contains_value(position, value);
+            stats.count_key_comparison(found);
+            if (found) {
                 return true;
             }
-            match_mask &= ~single_bit;
         }
         return false;
     }
 
-    bool remove(const T &value,
-                uint8_t hash_byte) NOINLINE {
-        uint16_t match_mask =
-            this->get_hash_bytes_mask(hash_byte);
-
-        while (match_mask != 0) {
-            uint16_t single_bit = keep_one_bit(match_mask);
-            uint8_t position =
-                this->get_bit_position(single_bit);
-            if (this->position_contains_value(position,
-                                              value)) {
+    template <typename StatsCounter>
+    bool remove(const T &value, uint8_t hash_byte,
+                StatsCounter &stats) NOINLINE {
+        for (uint8_t position :
+             this->get_hash_bytes_mask(hash_byte)) {
+            bool found =
+                this->position_contains_value(position, value);
+            stats.count_key_comparison(found);
+            if (found) {
                 this->remove_position(position);
                 return true;
             }
-            match_mask &= ~single_bit;
         }
         return false;
     }
@@ -163,13 +170,14 @@ class Group {
         m_used_mask = 0x0;
     }
 
-    void update_hash_bytes(HashFunc hash_fn,
+    void update_hash_bytes(const HashFunc &hash_fn,
                            uint8_t shift) {
+        uint32_t hashes[s_max_size];
+        hash_many(hash_fn, this->value_pointer(), hashes,
+                  m_count);
         for (uint8_t position = 0; position < m_count;
              position++) {
-            T &value = this->element_at(position);
-            uint8_t hash_byte = hash_fn(value) >> shift;
-            m_hash_bytes[position] = hash_byte;
+            m_hash_bytes[position] = hashes[position] >> shift;
         }
     }
 
@@ -217,7 +225,7 @@ class Group {
         m_count--;
     }
 
-    inline uint16_t
+    inline MatchMask
     get_hash_bytes_mask(uint8_t short_hash) const {
         __m128i cmp_hash = _mm_set1_epi8(short_hash);
         /* group has to be aligned to make this work */
@@ -225,11 +233,7 @@ class Group {
         __m128i byte_mask =
             _mm_cmpeq_epi8(all_hash_bytes, cmp_hash);
         uint16_t bit_mask = _mm_movemask_epi8(byte_mask);
-        return bit_mask & m_used_mask;
-    }
-
-    inline uint8_t get_bit_position(uint16_t mask) const {
-        return get_bit_index_16(mask);
+        return MatchMask(bit_mask & m_used_mask);
     }
 
     inline bool
@@ -272,28 +276,60 @@ class Group {
         return (T *)m_values + position;
     }
 
-    template <typename, typename>
+    template <typename, typename, typename>
     friend class HashSet;
+    template <typename, typename>
+    friend class PersistentHashSet;
+    template <typename, typename>
+    friend class CuckooHashSet;
 };
 
+/* A group fills one cache line for 4 byte values and two
+ * for 8 byte values. */
 template <typename T, typename HashFunc>
-class HashSet {
+using DefaultGroup = typename std::conditional<
+    sizeof(T) == 4, Group<T, HashFunc, 12>,
+    Group<T, HashFunc, 6>>::type;
+
+/* GroupType can be replaced by a group that stores more per
+ * value, like CountingGroup. It needs the methods of Group
+ * that the used methods of HashSet call. */
+template <typename T, typename HashFunc,
+          typename GroupType = DefaultGroup<T, HashFunc>>
+class HashSet : WithStatsCounter {
   private:
-    using GroupType = typename std::conditional<
-        sizeof(T) == 4, Group<T, HashFunc, 12>,
-        Group<T, HashFunc, 6>>::type;
     class GroupArray;
 
+    /* Groups per range that erase_if() hands to a thread. */
+    static constexpr uint32_t s_parallel_grain = 1 << 12;
+
     uint32_t m_total_elements = 0;
     uint8_t m_hash_byte_shift = 0;
+    uint8_t m_reseed_size_exp = 0;
+    /* Changes whenever the hash function is replaced, so that
+     * callers know that hashes they computed before are
+     * stale. */
+    uint32_t m_hash_generation = 0;
     HashFunc m_hash_fn;
     GroupArray m_groups;
 
+    template <typename, typename>
+    friend class FilteredHashSet;
+    template <typename, typename>
+    friend class HashSetLoader;
+    template <typename, typename>
+    friend class CountingHashSet;
+
   public:
     HashSet()
         : m_hash_fn(HashFunc::get_new()),
           m_groups(GroupArray(0)) {}
 
+    /* Sets that are created with the same function can be
+     * merged without hashing the values again. */
+    explicit HashSet(const HashFunc &hash_fn)
+        : m_hash_fn(hash_fn), m_groups(GroupArray(0)) {}
+
     HashSet(std::initializer_list<T> values) : HashSet() {
         for (T value : values) {
             this->insert(value);
@@ -301,24 +337,20 @@ class HashSet {
     }
 
     HashSet(std::vector<T> &values) : HashSet() {
-        uint32_t length =
-            values.size() / GroupType::s_max_size;
-        uint8_t exp = 1;
-        while ((1 << exp) < length) {
-            exp++;
-        }
-        exp++;
-
-        m_groups = GroupArray(exp);
-        m_hash_byte_shift = (exp / 3) * 3;
+        uint8_t size_exp = this->reserve(values.size());
 
+        /* Sorting by group index lets the inserts walk
+         * through the groups in order. */
         std::vector<uint32_t> hashes =
             this->calc_hashes(values);
-
-        partial_sort(values.data(), hashes.data(),
-                     values.size(), 18, 6);
+        radix_partition(values.data(), hashes.data(),
+                        values.size(), 0, size_exp);
+        uint32_t generation = m_hash_generation;
         for (uint32_t i = 0; i < values.size(); i++) {
-            this->insert_new(values[i], hashes[i]);
+            uint32_t hash = generation == m_hash_generation
+                                ? hashes[i]
+                                : this->calc_hash(values[i]);
+            this->insert_new(values[i], hash);
         }
     }
 
@@ -326,6 +358,31 @@ class HashSet {
         return m_total_elements;
     }
 
+    const HashFunc &hash_function() const {
+        return m_hash_fn;
+    }
+
+    /* Makes room for amount values in total, so that adding
+     * them usually does not have to grow the set. An empty
+     * set gets its final groups directly. Returns the new
+     * size exponent. */
+    uint8_t reserve(uint32_t amount) {
+        uint8_t exp = size_exp_for(amount);
+        if (m_total_elements == 0) {
+            if (exp > m_groups.size_exp()) {
+                m_groups = GroupArray(exp);
+                m_hash_byte_shift =
+                    GroupGrowth::hash_byte_shift_for(exp);
+            }
+        }
+        else {
+            while (m_groups.size_exp() < exp) {
+                this->grow();
+            }
+        }
+        return m_groups.size_exp();
+    }
+
     void insert(T &&value) {
         T val = value;
         this->insert(val);
@@ -353,6 +410,33 @@ class HashSet {
         return this->contains(value, hash);
     }
 
+    /* Hashes the values in blocks with the batch kernel of
+     * the hash function and prefetches the groups of the
+     * upcoming values. */
+    void contains_many(const T *values, uint32_t amount,
+                       bool *r_found) {
+        const uint32_t block_size = 256;
+        const uint32_t prefetch_distance = 8;
+        uint32_t hashes[block_size];
+        for (uint32_t start = 0; start < amount;
+             start += block_size) {
+            uint32_t block_amount =
+                std::min(block_size, amount - start);
+            hash_many(m_hash_fn, values + start, hashes,
+                      block_amount);
+            for (uint32_t i = 0; i < block_amount; i++) {
+                if (i + prefetch_distance < block_amount) {
+                    uint32_t index = this->group_index(
+                        hashes[i + prefetch_distance]);
+                    _mm_prefetch((const char *)&m_groups[index],
+                                 _MM_HINT_T0);
+                }
+                r_found[start + i] =
+                    this->contains(values[start + i], hashes[i]);
+            }
+        }
+    }
+
     void remove(const T &&value) {
         T val = value;
         this->remove(val);
@@ -363,6 +447,128 @@ class HashSet {
         this->remove(value, hash);
     }
 
+    /* Adds all values of the other sets, which are empty
+     * afterwards. See merge_sets(). */
+    template <typename... Others>
+    void merge(HashSet &&other, Others &&...others) {
+        uint32_t generation = m_hash_generation;
+        std::vector<HashSet *> sets = {this, &other, &others...};
+        HashSet result = merge_sets(sets, 1);
+        bool same_hash = same_hash_function(m_hash_fn,
+                                            result.m_hash_fn);
+        *this = std::move(result);
+        m_hash_generation = same_hash ? generation
+                                      : generation + 1;
+    }
+
+    /* Merges many sets, e.g. ones that worker threads built
+     * locally, with the given number of threads. All inputs
+     * are empty afterwards. See merge_sets(). */
+    static HashSet merge_parallel(std::vector<HashSet> &inputs,
+                                  uint32_t thread_amount) {
+        std::vector<HashSet *> sets;
+        for (HashSet &input : inputs) {
+            sets.push_back(&input);
+        }
+        return merge_sets(sets, thread_amount);
+    }
+
+    /* Splits the groups into ranges of grain groups. The
+     * ranges can be given to for_each_in_groups() on different
+     * threads, e.g. by a thread pool. */
+    std::vector<IndexRange> group_ranges(uint32_t grain) const {
+        return split_range(this->group_amount(), grain);
+    }
+
+    /* Calls fn(value) for every value in the groups of the
+     * range. */
+    template <typename Fn>
+    void for_each_in_groups(IndexRange range,
+                            const Fn &fn) const {
+        for (uint32_t i = range.begin; i < range.end; i++) {
+            const GroupType &group = m_groups[i];
+            for (uint8_t position = 0; position < group.size();
+                 position++) {
+                fn(group.element_at(position));
+            }
+        }
+    }
+
+    /* Calls fn(value) for every value. Ranges of grain groups
+     * are processed by different threads at the same time, so
+     * fn has to be thread-safe. */
+    template <typename Fn>
+    void parallel_for_each(
+        const Fn &fn, uint32_t grain,
+        uint32_t thread_amount =
+            std::thread::hardware_concurrency()) const {
+        parallel_for_grains(
+            this->group_amount(), grain, thread_amount,
+            [&](uint32_t begin, uint32_t end) {
+                this->for_each_in_groups({begin, end}, fn);
+            });
+    }
+
+    /* Removes all values for which pred(value) is true and
+     * returns how many there were. Removing a value only moves
+     * the last value of its group, so the groups can be
+     * compacted by different threads at the same time. */
+    template <typename Pred>
+    uint32_t erase_if(const Pred &pred,
+                      uint32_t grain = s_parallel_grain,
+                      uint32_t thread_amount =
+                          std::thread::hardware_concurrency()) {
+        m_groups.ensure_not_shared();
+        std::atomic<uint32_t> removed{0};
+        parallel_for_grains(
+            this->group_amount(), grain, thread_amount,
+            [&](uint32_t begin, uint32_t end) {
+                uint32_t removed_in_range = 0;
+                for (uint32_t i = begin; i < end; i++) {
+                    GroupType &group = m_groups[i];
+                    uint8_t position = 0;
+                    while (position < group.size()) {
+                        if (pred(group.element_at(position))) {
+                            /* Checks the moved value next. */
+                            group.remove_position(position);
+                            removed_in_range++;
+                        } else {
+                            position++;
+                        }
+                    }
+                }
+                removed.fetch_add(removed_in_range,
+                                  std::memory_order_relaxed);
+            });
+        m_total_elements -= removed.load();
+        return removed.load();
+    }
+
+    uint32_t capacity() const {
+        return this->group_amount() * GroupType::s_max_size;
+    }
+
+    uint64_t size_in_bytes() const {
+        if (m_groups.is_inline()) {
+            return sizeof(HashSet);
+        }
+        return sizeof(HashSet) +
+               (uint64_t)m_groups.size() * sizeof(GroupType);
+    }
+
+    /* Counters are only collected when compiled with
+     * HASH_TABLE_STATS. */
+    HashTableStats stats() const {
+        HashTableStats stats = this->stats_counter().snapshot();
+        stats.size = m_total_elements;
+        stats.capacity = this->capacity();
+        return stats;
+    }
+
+    void reset_stats() {
+        this->stats_counter().reset();
+    }
+
     void print_state() {
         uint32_t amount[GroupType::s_max_size + 1] = {0};
         for (GroupType &group : m_groups) {
@@ -386,41 +592,70 @@ class HashSet {
     }
 
   private:
+    /* Size exponent that reserve() uses for amount values. */
+    static uint8_t size_exp_for(uint32_t amount) {
+        return GroupGrowth::size_exp_for(amount,
+                                         GroupType::s_max_size);
+    }
+
     void insert_new(T &value, uint32_t hash) {
+        this->insert_new_with(
+            value, hash,
+            [&](GroupType &group, uint8_t hash_byte) {
+                return group.try_insert_new(value, hash_byte);
+            });
+    }
+
+    /* Grows or reseeds until try_insert(group, hash_byte)
+     * finds room for the value in its group. The callback
+     * stores everything the group keeps for the value. */
+    template <typename TryInsertFn>
+    void insert_new_with(const T &value, uint32_t hash,
+                         const TryInsertFn &try_insert) {
+        m_groups.ensure_not_shared();
         while (true) {
             uint8_t hash_byte = this->to_hash_byte(hash);
             uint32_t index = this->group_index(hash);
             GroupType &group = m_groups[index];
-            if (group.try_insert_new(value, hash_byte)) {
+            if (try_insert(group, hash_byte)) {
                 break;
             }
-            this->grow();
+            if (this->should_reseed()) {
+                this->reseed();
+                hash = this->calc_hash(value);
+            }
+            else {
+                this->grow();
+            }
         }
         m_total_elements++;
     }
 
     bool contains(const T &value, uint32_t hash) {
+        auto &&stats = this->stats_counter();
         uint8_t hash_byte = this->to_hash_byte(hash);
         uint32_t index = this->group_index(hash);
         GroupType &group = m_groups[index];
-        return group.contains(value, hash_byte);
+        stats.count_lookup(1);
+        return group.contains(value, hash_byte, stats);
     }
 
     void remove(const T &value, uint32_t hash) {
+        m_groups.ensure_not_shared();
+        auto &&stats = this->stats_counter();
         uint8_t hash_byte = this->to_hash_byte(hash);
         uint32_t index = this->group_index(hash);
         GroupType &group = m_groups[index];
-        bool existed = group.remove(value, hash_byte);
+        stats.count_lookup(1);
+        bool existed = group.remove(value, hash_byte, stats);
         if (existed) m_total_elements--;
     }
 
     std::vector<uint32_t>
-    calc_hashes(const std::vector<T> values) {
+    calc_hashes(const std::vector<T> &values) {
         std::vector<uint32_t> hashes(values.size());
-        for (uint32_t i = 0; i < values.size(); i++) {
-            uint32_t hash = this->calc_hash(values[i]);
-            hashes[i] = hash;
-        }
+        hash_many(m_hash_fn, values.data(), hashes.data(),
+                  values.size());
         return hashes;
     }
 
@@ -445,19 +680,22 @@ class HashSet {
                (float)this->capacity();
     }
 
-    int capacity() const {
-        return this->group_amount() * GroupType::s_max_size;
-    }
-
     void grow() REAL_NOINLINE {
-        if (m_groups.size_exp() % 3 == 0 &&
-            m_groups.size_exp() > 0) {
-            m_hash_byte_shift = m_groups.size_exp();
+        auto timer = this->stats_counter().time_grow();
+
+        /* The old groups are changed in place, reserve() can
+         * get here with groups that a copy still uses. */
+        m_groups.ensure_not_shared();
+
+        uint8_t shift = GroupGrowth::shift_for_grow(
+            m_groups.size_exp(), m_hash_byte_shift);
+        if (shift != m_hash_byte_shift) {
+            m_hash_byte_shift = shift;
             this->recalculate_hash_bytes();
         }
 
-        uint8_t decision_mask =
-            1 << (m_groups.size_exp() - m_hash_byte_shift);
+        uint8_t decision_mask = GroupGrowth::decision_mask(
+            m_groups.size_exp(), m_hash_byte_shift);
 
         uint32_t old_group_amount = this->group_amount();
 
@@ -475,6 +713,36 @@ class HashSet {
         m_groups = std::move(new_groups);
     }
 
+    /* See GroupGrowth::should_reseed(). */
+    bool should_reseed() const {
+        return GroupGrowth::should_reseed(m_groups.size_exp(),
+                                          m_reseed_size_exp,
+                                          this->fullness());
+    }
+
+    void reseed() REAL_NOINLINE {
+        auto timer = this->stats_counter().time_grow();
+
+        m_reseed_size_exp = m_groups.size_exp();
+        m_hash_fn = HashFunc::get_new();
+        m_hash_generation++;
+
+        GroupArray old_groups = std::move(m_groups);
+        m_groups = GroupArray(old_groups.size_exp());
+        m_total_elements = 0;
+        for (GroupType &group : old_groups) {
+            for (uint8_t i = 0; i < group.size(); i++) {
+                const T &value = group.element_at(i);
+                this->insert_new_with(
+                    value, this->calc_hash(value),
+                    [&](GroupType &dst, uint8_t hash_byte) {
+                        return dst.try_insert_from(group, i,
+                                                   hash_byte);
+                    });
+            }
+        }
+    }
+
     void recalculate_hash_bytes() {
         for (uint32_t i = 0; i < this->group_amount();
              i++) {
@@ -483,19 +751,321 @@ class HashSet {
         }
     }
 
+    /* Sets that are created with the same hash function can
+     * be merged without hashing their values again:
+     *
+     *   1. They are grown to the same number of groups and
+     *      hash byte shift.
+     *   2. The number of distinct values is estimated from a
+     *      sample of the group indices, to choose the size of
+     *      the result.
+     *   3. Every thread takes a range of group indices. The
+     *      values of these groups in all sets are distributed
+     *      to the result groups by the bits of their hash
+     *      bytes, like grow() does. No other thread writes to
+     *      these result groups.
+     *
+     * Values that do not fit into their result group anymore
+     * are inserted afterwards. So are the values of sets with
+     * another hash function and of sets with less than half
+     * as many groups as the largest one, because growing
+     * them costs more than inserting their values. */
+    static HashSet merge_sets(const std::vector<HashSet *> &sets,
+                              uint32_t thread_amount) {
+        HashSet *first = nullptr;
+        for (HashSet *set : sets) {
+            if (set->m_total_elements > 0) {
+                first = set;
+                break;
+            }
+        }
+        if (first == nullptr) {
+            return sets.empty() ? HashSet()
+                                : HashSet(sets[0]->m_hash_fn);
+        }
+        uint8_t max_exp = 0;
+        for (HashSet *set : sets) {
+            if (set->m_total_elements > 0 &&
+                same_hash_function(set->m_hash_fn,
+                                   first->m_hash_fn)) {
+                max_exp =
+                    std::max(max_exp, set->m_groups.size_exp());
+            }
+        }
+        std::vector<HashSet *> sources;
+        std::vector<HashSet *> others;
+        for (HashSet *set : sets) {
+            if (set->m_total_elements == 0) {
+                continue;
+            }
+            if (same_hash_function(set->m_hash_fn,
+                                   first->m_hash_fn) &&
+                set->m_groups.size_exp() + 1 >= max_exp) {
+                set->m_groups.ensure_not_shared();
+                sources.push_back(set);
+            }
+            else {
+                others.push_back(set);
+            }
+        }
+
+        HashSet result(first->m_hash_fn);
+        if (sources.size() == 1) {
+            HashSet *source = sources[0];
+            result.m_groups = std::move(source->m_groups);
+            result.m_hash_byte_shift = source->m_hash_byte_shift;
+            result.m_reseed_size_exp = source->m_reseed_size_exp;
+            result.m_total_elements = source->m_total_elements;
+        }
+        else if (sources.size() > 1) {
+            result.merge_groups_of(sources, thread_amount);
+        }
+        for (HashSet *source : sources) {
+            *source = HashSet(result.m_hash_fn);
+        }
+
+        for (HashSet *other : others) {
+            for (const T &value : *other) {
+                T copy = value;
+                result.insert(copy);
+            }
+            *other = HashSet(other->m_hash_fn);
+        }
+        return result;
+    }
+
+    void merge_groups_of(const std::vector<HashSet *> &sources,
+                         uint32_t thread_amount) {
+        align_groups(sources, thread_amount);
+        uint8_t size_exp = std::max(
+            sources[0]->m_groups.size_exp(),
+            size_exp_for(estimate_distinct(sources)));
+        /* The result keeps the shift of the sources, so the
+         * bits that decide between its groups have to be in
+         * the hash bytes. */
+        while (size_exp > sources[0]->m_hash_byte_shift + 8) {
+            parallel_for_ranges(
+                sources.size(), thread_amount,
+                [&](uint32_t begin, uint32_t end) {
+                    for (uint32_t i = begin; i < end; i++) {
+                        sources[i]->grow();
+                    }
+                });
+        }
+
+        GroupArray groups(size_exp);
+        std::vector<std::vector<T>> overflows(
+            std::max(thread_amount, 1u));
+        std::atomic<uint32_t> total_added{0};
+        std::atomic<uint32_t> next_overflow{0};
+        parallel_for_ranges(
+            sources[0]->group_amount(), thread_amount,
+            [&](uint32_t begin, uint32_t end) {
+                std::vector<T> &overflow =
+                    overflows[next_overflow.fetch_add(1)];
+                uint32_t added = merge_groups(
+                    groups, sources, begin, end, overflow);
+                total_added.fetch_add(added);
+            });
+
+        m_groups = std::move(groups);
+        m_hash_byte_shift = sources[0]->m_hash_byte_shift;
+        m_total_elements = total_added.load();
+        for (std::vector<T> &overflow : overflows) {
+            for (T &value : overflow) {
+                this->insert(value);
+            }
+        }
+    }
+
+    /* Grows the sets until all have as many groups as the
+     * largest one. The hash bytes of sets with another shift
+     * than the first one are calculated again. */
+    static void align_groups(const std::vector<HashSet *> &sets,
+                             uint32_t thread_amount) {
+        uint8_t size_exp = 0;
+        for (HashSet *set : sets) {
+            size_exp =
+                std::max(size_exp, set->m_groups.size_exp());
+        }
+        parallel_for_ranges(
+            sets.size(), thread_amount,
+            [&](uint32_t begin, uint32_t end) {
+                for (uint32_t i = begin; i < end; i++) {
+                    while (sets[i]->m_groups.size_exp() <
+                           size_exp) {
+                        sets[i]->grow();
+                    }
+                }
+            });
+        uint8_t shift = sets[0]->m_hash_byte_shift;
+        parallel_for_ranges(
+            sets.size(), thread_amount,
+            [&](uint32_t begin, uint32_t end) {
+                for (uint32_t i = begin; i < end; i++) {
+                    if (sets[i]->m_hash_byte_shift != shift) {
+                        sets[i]->m_hash_byte_shift = shift;
+                        sets[i]->recalculate_hash_bytes();
+                    }
+                }
+            });
+    }
+
+    /* A range of group indices is a random sample of the
+     * values, because the indices come from their hashes. */
+    static uint32_t
+    estimate_distinct(const std::vector<HashSet *> &sets) {
+        uint32_t group_amount = sets[0]->group_amount();
+        uint32_t sample_amount = std::max(group_amount / 64, 1u);
+        HashSet sample(sets[0]->m_hash_fn);
+        for (HashSet *set : sets) {
+            for (uint32_t i = 0; i < sample_amount; i++) {
+                GroupType &group = set->m_groups[i];
+                for (uint8_t position = 0;
+                     position < group.size(); position++) {
+                    sample.insert(group.element_at(position));
+                }
+            }
+        }
+        return (uint64_t)sample.size() * group_amount /
+               sample_amount;
+    }
+
+    /* Adds the values of the groups begin to end of all
+     * sources to the result groups. Values whose group is
+     * full are appended to r_overflow. Returns how many
+     * values were added. Stats are not counted, because the
+     * counter is not thread safe. */
+    static uint32_t
+    merge_groups(GroupArray &groups,
+                 const std::vector<HashSet *> &sources,
+                 uint32_t begin, uint32_t end,
+                 std::vector<T> &r_overflow) {
+        DisabledStatsCounter stats;
+        uint8_t source_exp = sources[0]->m_groups.size_exp();
+        uint8_t byte_shift =
+            source_exp - sources[0]->m_hash_byte_shift;
+        uint32_t high_mask =
+            (1 << (groups.size_exp() - source_exp)) - 1;
+        /* All sources are walked through a few groups at a
+         * time, so that the result groups of these stay in
+         * the cache. */
+        const uint32_t block_size = 16;
+        uint32_t added = 0;
+        for (uint32_t block = begin; block < end;
+             block += block_size) {
+            uint32_t block_end = std::min(block + block_size, end);
+            for (HashSet *set : sources) {
+                for (uint32_t i = block; i < block_end; i++) {
+                    GroupType &source = set->m_groups[i];
+                    for (uint8_t position = 0;
+                         position < source.size(); position++) {
+                        T &value = source.element_at(position);
+                        uint8_t hash_byte =
+                            source.m_hash_bytes[position];
+                        uint32_t high =
+                            (hash_byte >> byte_shift) & high_mask;
+                        GroupType &group =
+                            groups[i | (high << source_exp)];
+                        if (group.contains(value, hash_byte,
+                                           stats)) {
+                            continue;
+                        }
+                        if (group.try_insert_new(value,
+                                                 hash_byte)) {
+                            added++;
+                        }
+                        else {
+                            r_overflow.push_back(value);
+                        }
+                    }
+                }
+            }
+        }
+        return added;
+    }
+
+    /* Arrays with up to s_inline_groups groups are stored
+     * inside the object itself, so that empty and small sets
+     * do not allocate at all.
+     *
+     * Larger arrays are allocated together with a user count
+     * in the first cache line. Copies share the groups until
+     * ensure_not_shared() is called before a modification, so
+     * copies that are only read from are O(1). */
     class GroupArray {
       private:
+        static const uint32_t s_inline_groups = 2;
+        static const uint32_t s_header_size = 64;
+
         GroupType *m_data;
         uint32_t m_length;
         uint32_t m_mask;
         uint8_t m_size_exp;
+        alignas(64) char m_inline_storage[sizeof(GroupType) *
+                                          s_inline_groups];
 
         GroupType *allocate(uint32_t length) {
             static_assert(sizeof(GroupType) % 64 == 0,
                           "sizeof(GroupType) has to be a "
                           "multiple of 64");
-            return (GroupType *)aligned_alloc(
-                64, length * sizeof(GroupType));
+            if (length <= s_inline_groups) {
+                return (GroupType *)m_inline_storage;
+            }
+            char *memory = (char *)aligned_alloc(
+                64, s_header_size + length * sizeof(GroupType));
+            new (memory) std::atomic<uint32_t>(1);
+            return (GroupType *)(memory + s_header_size);
+        }
+
+        void deallocate() {
+            if (m_data == nullptr) {
+                return;
+            }
+            if (this->is_inline()) {
+                destroy_n(m_data, m_length);
+            }
+            else if (this->users().fetch_sub(
+                         1, std::memory_order_acq_rel) == 1) {
+                destroy_n(m_data, m_length);
+                std::free((char *)m_data - s_header_size);
+            }
+        }
+
+        std::atomic<uint32_t> &users() const {
+            return *(std::atomic<uint32_t> *)((char *)m_data -
+                                              s_header_size);
+        }
+
+        void copy_or_share_from(const GroupArray &other) {
+            this->settings_from_exp(other.m_size_exp);
+            if (other.is_inline()) {
+                m_data = this->allocate(m_length);
+                std::uninitialized_copy_n(other.m_data,
+                                          m_length, m_data);
+            }
+            else {
+                m_data = other.m_data;
+                this->users().fetch_add(
+                    1, std::memory_order_relaxed);
+            }
+        }
+
+        /* Inline groups cannot be stolen, they have to be
+         * moved one by one. */
+        void steal_or_move_from(GroupArray &other) {
+            this->settings_from_exp(other.m_size_exp);
+            if (other.is_inline()) {
+                m_data = this->allocate(m_length);
+                std::uninitialized_copy_n(
+                    std::make_move_iterator(other.m_data),
+                    m_length, m_data);
+            }
+            else {
+                m_data = other.m_data;
+                other.m_length = 0;
+                other.m_data = nullptr;
+            }
         }
 
       public:
@@ -515,35 +1085,23 @@ class HashSet {
         }
 
         ~GroupArray() {
-            if (m_data != nullptr) {
-                destroy_n(m_data, m_length);
-                std::free(m_data);
-            }
+            this->deallocate();
         }
 
         GroupArray(const GroupArray &other) {
-            this->settings_from_exp(other.m_size_exp);
-            m_data = this->allocate(m_length);
-            std::uninitialized_copy_n(other.m_data,
-                                      m_length, m_data);
+            this->copy_or_share_from(other);
         }
 
         GroupArray(GroupArray &&other) {
-            this->settings_from_exp(other.m_size_exp);
-            m_data = other.m_data;
-            other.m_data = nullptr;
+            this->steal_or_move_from(other);
         }
 
         GroupArray &operator=(const GroupArray &other) {
             if (this == &other) {
                 return *this;
             }
-            destroy_n(m_data, m_length);
-            std::free(m_data);
-            this->settings_from_exp(other.m_size_exp);
-            m_data = this->allocate(m_length);
-            std::uninitialized_copy_n(other.m_data,
-                                      m_length, m_data);
+            this->deallocate();
+            this->copy_or_share_from(other);
             return *this;
         }
 
@@ -551,15 +1109,31 @@ class HashSet {
             if (this == &other) {
                 return *this;
             }
-            destroy_n(m_data, m_length);
-            std::free(m_data);
-            this->settings_from_exp(other.m_size_exp);
-            m_data = other.m_data;
-            other.m_length = 0;
-            other.m_data = nullptr;
+            this->deallocate();
+            this->steal_or_move_from(other);
             return *this;
         }
 
+        bool is_inline() const {
+            return m_data == (GroupType *)m_inline_storage;
+        }
+
+        bool is_shared() const {
+            return !this->is_inline() &&
+                   this->users().load(
+                       std::memory_order_acquire) > 1;
+        }
+
+        void ensure_not_shared() {
+            if (!this->is_shared()) {
+                return;
+            }
+            GroupType *data = this->allocate(m_length);
+            std::uninitialized_copy_n(m_data, m_length, data);
+            this->deallocate();
+            m_data = data;
+        }
+
         GroupType &operator[](const uint32_t index) const {
             return m_data[index];
         }
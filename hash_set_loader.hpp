@@ -0,0 +1,330 @@
+#pragma once
+
+#include "hash_set.hpp"
+#include <algorithm>
+#include <cerrno>
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <type_traits>
+#include <vector>
+
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+/* Queue with a maximum size, so that a fast producer cannot
+ * fill the memory. pop() returns false once all producers
+ * are done and the queue is empty. */
+template <typename T>
+class BoundedQueue {
+  private:
+    std::mutex m_mutex;
+    std::condition_variable m_not_empty;
+    std::condition_variable m_not_full;
+    std::deque<T> m_items;
+    uint32_t m_max_size;
+    uint32_t m_active_producers;
+
+  public:
+    BoundedQueue(uint32_t max_size, uint32_t producer_amount)
+        : m_max_size(max_size),
+          m_active_producers(producer_amount) {}
+
+    void push(T &&item) {
+        std::unique_lock<std::mutex> lock(m_mutex);
+        m_not_full.wait(lock, [this]() {
+            return m_items.size() < m_max_size;
+        });
+        m_items.push_back(std::move(item));
+        m_not_empty.notify_one();
+    }
+
+    bool pop(T &r_item) {
+        std::unique_lock<std::mutex> lock(m_mutex);
+        m_not_empty.wait(lock, [this]() {
+            return !m_items.empty() || m_active_producers == 0;
+        });
+        if (m_items.empty()) {
+            return false;
+        }
+        r_item = std::move(m_items.front());
+        m_items.pop_front();
+        m_not_full.notify_one();
+        return true;
+    }
+
+    void producer_done() {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_active_producers--;
+        m_not_empty.notify_all();
+    }
+};
+
+/* Fills a HashSet from a file without ever holding the whole
+ * file in memory. It is a pipeline of three stages that run
+ * at the same time:
+ *   1. One thread reads chunks of about s_chunk_bytes with
+ *      sequential read-ahead.
+ *   2. Hash threads compute the hashes of a chunk and sort
+ *      it by group index, so that the inserts of a chunk
+ *      walk through the groups in order.
+ *   3. The calling thread inserts the chunks into groups
+ *      that have been reserved for the expected size.
+ * Only a few chunks exist at any time, so the peak memory
+ * is the set itself plus a few MB.
+ *
+ * Values that are in the file more than once are inserted
+ * once. The functions return false when the file cannot be
+ * opened or read; in the latter case the set contains the
+ * values that have been read until then. */
+template <typename T, typename HashFunc>
+class HashSetLoader {
+  private:
+    using SetType = HashSet<T, HashFunc>;
+
+    static const uint32_t s_chunk_bytes = 1 << 20;
+    static const uint32_t s_max_queued_chunks = 4;
+
+    struct Chunk {
+        std::vector<T> values;
+        std::vector<uint32_t> hashes;
+    };
+
+    /* Fixed width values in native byte order. */
+    class BinaryReader {
+      private:
+        int m_fd;
+
+      public:
+        bool failed = false;
+
+        BinaryReader(int fd) : m_fd(fd) {}
+
+        bool next_chunk(Chunk &r_chunk) {
+            r_chunk.values.resize(s_chunk_bytes / sizeof(T));
+            uint32_t bytes = read_full(
+                m_fd, (char *)r_chunk.values.data(),
+                r_chunk.values.size() * sizeof(T), failed);
+            /* A partial value at the end is ignored. */
+            r_chunk.values.resize(bytes / sizeof(T));
+            return !r_chunk.values.empty();
+        }
+    };
+
+    /* One value per line, the last line does not need a line
+     * break. Lines that span two buffers are carried over. */
+    class LineReader {
+      private:
+        int m_fd;
+        std::vector<char> m_buffer;
+        std::string m_rest;
+        bool m_at_end = false;
+
+      public:
+        bool failed = false;
+
+        LineReader(int fd) : m_fd(fd), m_buffer(s_chunk_bytes) {}
+
+        bool next_chunk(Chunk &r_chunk) {
+            r_chunk.values.clear();
+            while (r_chunk.values.empty() && !m_at_end) {
+                uint32_t bytes = read_full(m_fd, m_buffer.data(),
+                                           m_buffer.size(), failed);
+                if (bytes == 0) {
+                    m_at_end = true;
+                    if (!m_rest.empty()) {
+                        r_chunk.values.push_back(std::move(m_rest));
+                        m_rest.clear();
+                    }
+                    break;
+                }
+                this->split_lines(bytes, r_chunk.values);
+            }
+            return !r_chunk.values.empty();
+        }
+
+      private:
+        void split_lines(uint32_t bytes,
+                         std::vector<std::string> &r_lines) {
+            const char *start = m_buffer.data();
+            const char *end = start + bytes;
+            while (true) {
+                const char *line_end = std::find(start, end, '\n');
+                if (line_end == end) {
+                    m_rest.append(start, end);
+                    return;
+                }
+                m_rest.append(start, line_end);
+                r_lines.push_back(std::move(m_rest));
+                m_rest.clear();
+                start = line_end + 1;
+            }
+        }
+    };
+
+  public:
+    static uint32_t default_thread_amount() {
+        /* The reading and inserting threads need a core each. */
+        uint32_t cores = std::thread::hardware_concurrency();
+        return std::max(2u, cores) - 1;
+    }
+
+    static bool
+    load_binary_file(const std::string &path, SetType &set,
+                     uint32_t hash_thread_amount =
+                         default_thread_amount()) {
+        static_assert(std::is_trivially_copyable<T>::value,
+                      "values are read as raw bytes");
+        int fd = open_sequential(path);
+        if (fd == -1) {
+            return false;
+        }
+        uint64_t amount = file_size(fd) / sizeof(T);
+        uint8_t size_exp = set.reserve(set.size() + amount);
+
+        BinaryReader reader(fd);
+        run_pipeline(set, reader, size_exp, hash_thread_amount);
+        close(fd);
+        return !reader.failed;
+    }
+
+    static bool
+    load_lines_file(const std::string &path, SetType &set,
+                    uint32_t hash_thread_amount =
+                        default_thread_amount()) {
+        static_assert(std::is_same<T, std::string>::value,
+                      "lines can only be loaded as strings");
+        int fd = open_sequential(path);
+        if (fd == -1) {
+            return false;
+        }
+        uint8_t size_exp =
+            set.reserve(set.size() + estimate_line_amount(fd));
+
+        LineReader reader(fd);
+        run_pipeline(set, reader, size_exp, hash_thread_amount);
+        close(fd);
+        return !reader.failed;
+    }
+
+  private:
+    /* The group index is known up front, because the groups
+     * have been reserved already. When the set has to grow
+     * anyway, the chunks are just not perfectly ordered. */
+    template <typename Reader>
+    static void run_pipeline(SetType &set, Reader &reader,
+                             uint8_t size_exp,
+                             uint32_t hash_thread_amount) {
+        hash_thread_amount = std::max(1u, hash_thread_amount);
+        /* The hash threads use a copy of the hash function,
+         * because the set may replace its own while inserting.
+         * The hashes of the chunks are stale then. */
+        const HashFunc hash_fn = set.m_hash_fn;
+        const uint32_t generation = set.m_hash_generation;
+        BoundedQueue<Chunk> read_chunks(s_max_queued_chunks, 1);
+        BoundedQueue<Chunk> hashed_chunks(s_max_queued_chunks,
+                                          hash_thread_amount);
+
+        std::thread read_thread([&]() {
+            Chunk chunk;
+            while (reader.next_chunk(chunk)) {
+                read_chunks.push(std::move(chunk));
+                chunk = Chunk();
+            }
+            read_chunks.producer_done();
+        });
+
+        std::vector<std::thread> hash_threads;
+        for (uint32_t i = 0; i < hash_thread_amount; i++) {
+            hash_threads.emplace_back([&]() {
+                Chunk chunk;
+                while (read_chunks.pop(chunk)) {
+                    hash_chunk(hash_fn, chunk, size_exp);
+                    hashed_chunks.push(std::move(chunk));
+                }
+                hashed_chunks.producer_done();
+            });
+        }
+
+        Chunk chunk;
+        while (hashed_chunks.pop(chunk)) {
+            for (uint32_t i = 0; i < chunk.values.size(); i++) {
+                T &value = chunk.values[i];
+                uint32_t hash = set.m_hash_generation == generation
+                                    ? chunk.hashes[i]
+                                    : set.calc_hash(value);
+                if (!set.contains(value, hash)) {
+                    set.insert_new(value, hash);
+                }
+            }
+        }
+
+        read_thread.join();
+        for (std::thread &thread : hash_threads) {
+            thread.join();
+        }
+    }
+
+    static void hash_chunk(const HashFunc &hash_fn, Chunk &chunk,
+                           uint8_t size_exp) {
+        chunk.hashes.resize(chunk.values.size());
+        hash_many(hash_fn, chunk.values.data(), chunk.hashes.data(),
+                  chunk.values.size());
+        radix_partition(chunk.values.data(), chunk.hashes.data(),
+                        chunk.values.size(), 0, size_exp);
+    }
+
+    static int open_sequential(const std::string &path) {
+        int fd = open(path.c_str(), O_RDONLY);
+        if (fd != -1) {
+            posix_fadvise(fd, 0, 0, POSIX_FADV_SEQUENTIAL);
+        }
+        return fd;
+    }
+
+    static uint64_t file_size(int fd) {
+        struct stat info;
+        if (fstat(fd, &info) != 0) {
+            return 0;
+        }
+        return info.st_size;
+    }
+
+    /* Extrapolates from the line lengths at the start of the
+     * file, without consuming anything. */
+    static uint32_t estimate_line_amount(int fd) {
+        std::vector<char> buffer(1 << 16);
+        ssize_t bytes = pread(fd, buffer.data(), buffer.size(), 0);
+        if (bytes <= 0) {
+            return 0;
+        }
+        uint64_t lines =
+            std::count(buffer.data(), buffer.data() + bytes, '\n');
+        return std::max<uint64_t>(lines, 1) * file_size(fd) /
+               bytes;
+    }
+
+    /* Reads until the buffer is full or the file ends. */
+    static uint32_t read_full(int fd, char *buffer,
+                              uint32_t size, bool &r_failed) {
+        uint32_t total = 0;
+        while (total < size) {
+            ssize_t bytes = read(fd, buffer + total, size - total);
+            if (bytes == 0) {
+                break;
+            }
+            if (bytes < 0) {
+                if (errno == EINTR) {
+                    continue;
+                }
+                r_failed = true;
+                break;
+            }
+            total += bytes;
+        }
+        return total;
+    }
+};
@@ -1,60 +1,238 @@
+#pragma once
+
+#include "hash_kernels.hpp"
 #include "utils.hpp"
+#include <atomic>
+#include <cstring>
 #include <random>
 #include <stdint.h>
 #include <string>
+#include <type_traits>
+
+/* Every call returns a different seed. The sequence starts at
+ * a random point in every process, so that the seeds of a
+ * table cannot be predicted from the outside. */
+inline uint64_t new_hash_seed() {
+    static std::atomic<uint64_t> state(
+        ((uint64_t)std::random_device()() << 32) ^
+        std::random_device()());
+    /* splitmix64 */
+    uint64_t z = state.fetch_add(0x9E3779B97F4A7C15ULL,
+                                 std::memory_order_relaxed) +
+                 0x9E3779B97F4A7C15ULL;
+    z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ULL;
+    z = (z ^ (z >> 27)) * 0x94D049BB133111EBULL;
+    return z ^ (z >> 31);
+}
+
+/* SipHash-1-3 of the bytes with a 128 bit key, folded to 32
+ * bits. Other than with unkeyed string hashes, collisions
+ * cannot be found without knowing the key. */
+inline uint32_t siphash13(const char *data, size_t length,
+                          uint64_t k0, uint64_t k1) {
+    uint64_t v0 = k0 ^ 0x736f6d6570736575ULL;
+    uint64_t v1 = k1 ^ 0x646f72616e646f6dULL;
+    uint64_t v2 = k0 ^ 0x6c7967656e657261ULL;
+    uint64_t v3 = k1 ^ 0x7465646279746573ULL;
+
+    auto rotl = [](uint64_t x, int b) {
+        return (x << b) | (x >> (64 - b));
+    };
+    auto round = [&]() {
+        v0 += v1;
+        v1 = rotl(v1, 13);
+        v1 ^= v0;
+        v0 = rotl(v0, 32);
+        v2 += v3;
+        v3 = rotl(v3, 16);
+        v3 ^= v2;
+        v0 += v3;
+        v3 = rotl(v3, 21);
+        v3 ^= v0;
+        v2 += v1;
+        v1 = rotl(v1, 17);
+        v1 ^= v2;
+        v2 = rotl(v2, 32);
+    };
+
+    size_t full_words = length / 8;
+    for (size_t i = 0; i < full_words; i++) {
+        uint64_t word;
+        std::memcpy(&word, data + i * 8, 8);
+        v3 ^= word;
+        round();
+        v0 ^= word;
+    }
+
+    uint64_t last = (uint64_t)length << 56;
+    std::memcpy(&last, data + full_words * 8, length % 8);
+    v3 ^= last;
+    round();
+    v0 ^= last;
 
-std::random_device rd;
-std::mt19937 eng(rd());
+    v2 ^= 0xff;
+    round();
+    round();
+    round();
+    uint64_t hash = v0 ^ v1 ^ v2 ^ v3;
+    return hash ^ (hash >> 32);
+}
 
 class HashBits32 {
   private:
     uint32_t m, n;
-    static constexpr uint8_t exp = 31;
-    static constexpr uint64_t prime = (1LL << exp) - 1;
-    static constexpr uint64_t bit_mask = (1LL << exp) - 1;
+    static constexpr uint64_t prime = (1LL << 31) - 1;
 
   public:
     HashBits32(uint32_t m, uint32_t n) : m(m), n(n) {}
 
     uint32_t operator()(uint32_t value) const {
         /* ignores highest bit */
-        uint64_t x = m * (uint64_t)value + n;
-        uint32_t x1 = (x >> exp) & bit_mask;
-        uint32_t x2 = x & bit_mask;
-        uint32_t s = x1 + x2;
-        if (s > prime) s -= prime;
-        return s;
+        return mersenne31_hash(m, n, value);
     }
 
+    void hash_many(const uint32_t *values, uint32_t *r_hashes,
+                   uint32_t amount) const {
+        mersenne31_hash_many(m, n, values, r_hashes, amount);
+    }
+
+    bool operator==(const HashBits32 &other) const {
+        return m == other.m && n == other.n;
+    }
+
+    /* Every instance gets its own random function, so that
+     * colliding values cannot be chosen in advance. */
     static HashBits32 get_new() {
-        return HashBits32(342342983, 12314123);
-        // std::uniform_int_distribution<> distr(1, prime);
-        // return HashBits32(distr(eng), distr(eng));
+        uint64_t seed = new_hash_seed();
+        uint32_t m = 1 + (seed >> 32) % (prime - 1);
+        uint32_t n = (uint32_t)seed % prime;
+        return HashBits32(m, n);
     }
 };
 
-class HashString {
+/* Multiply-add-shift with random 64 bit parameters. All 32
+ * bits of the result are usable and it is cheaper than
+ * HashBits32, because there is no modulo. */
+class MultiplyShift32 {
+  private:
+    uint64_t m_multiplier, m_increment;
+
+  public:
+    MultiplyShift32(uint64_t multiplier, uint64_t increment)
+        : m_multiplier(multiplier), m_increment(increment) {}
+
+    uint32_t operator()(uint32_t value) const {
+        return multiply_shift_hash(m_multiplier, m_increment, value);
+    }
+
+    void hash_many(const uint32_t *values, uint32_t *r_hashes,
+                   uint32_t amount) const {
+        multiply_shift_hash_many(m_multiplier, m_increment, values,
+                                 r_hashes, amount);
+    }
+
+    bool operator==(const MultiplyShift32 &other) const {
+        return m_multiplier == other.m_multiplier &&
+               m_increment == other.m_increment;
+    }
+
+    static MultiplyShift32 get_new() {
+        return MultiplyShift32(new_hash_seed(), new_hash_seed());
+    }
+};
+
+class HashBits64 {
   private:
     HashBits32 hash_fn;
 
   public:
-    HashString(HashBits32 hash_fn) : hash_fn(hash_fn) {}
+    HashBits64(HashBits32 hash_fn) : hash_fn(hash_fn) {}
+
+    uint32_t operator()(uint64_t value) const {
+        uint32_t high = hash_fn(value >> 32);
+        return hash_fn((uint32_t)value ^ high);
+    }
+
+    bool operator==(const HashBits64 &other) const {
+        return hash_fn == other.hash_fn;
+    }
+
+    static HashBits64 get_new() {
+        return HashBits64(HashBits32::get_new());
+    }
+};
+
+class HashString {
+  private:
+    uint64_t k0, k1;
+
+  public:
+    HashString(uint64_t k0, uint64_t k1) : k0(k0), k1(k1) {}
 
     uint32_t operator()(const std::string &str) const {
-        return (*this)(str.c_str());
+        return siphash13(str.data(), str.size(), k0, k1);
     }
 
     uint32_t operator()(const char *str) const {
-        uint32_t hash = 5381;
-        char c;
-        while ((c = *str++)) {
-            hash = ((hash << 5) + hash) + c;
-        }
-        hash = hash_fn(hash);
-        return hash;
+        return siphash13(str, std::strlen(str), k0, k1);
+    }
+
+    bool operator==(const HashString &other) const {
+        return k0 == other.k0 && k1 == other.k1;
     }
 
     static HashString get_new() {
-        return HashString(HashBits32::get_new());
+        return HashString(new_hash_seed(), new_hash_seed());
+    }
+};
+
+template <typename HashFunc, typename = void>
+struct IsComparable : std::false_type {};
+
+template <typename HashFunc>
+struct IsComparable<
+    HashFunc, decltype((void)(std::declval<const HashFunc &>() ==
+                              std::declval<const HashFunc &>()))>
+    : std::true_type {};
+
+/* Sets with the same hash function compute the same hash for
+ * every value, so their groups can be combined without
+ * hashing again. Functions that cannot be
+ * compared are never the same. */
+template <typename HashFunc>
+bool same_hash_function(const HashFunc &a, const HashFunc &b) {
+    if constexpr (IsComparable<HashFunc>::value) {
+        return a == b;
+    }
+    else {
+        return false;
+    }
+}
+
+template <typename HashFunc, typename T, typename = void>
+struct HasHashMany : std::false_type {};
+
+template <typename HashFunc, typename T>
+struct HasHashMany<
+    HashFunc, T,
+    decltype(std::declval<const HashFunc &>().hash_many(
+        (const uint32_t *)nullptr, (uint32_t *)nullptr, 0))>
+    : std::integral_constant<bool, std::is_integral<T>::value &&
+                                       sizeof(T) == 4> {};
+
+/* Uses the batch kernel of the hash function when it has
+ * one and the values are 4 byte integers, which it reads as
+ * uint32_t like the scalar function does. */
+template <typename HashFunc, typename T>
+void hash_many(const HashFunc &hash_fn, const T *values,
+               uint32_t *r_hashes, uint32_t amount) {
+    if constexpr (HasHashMany<HashFunc, T>::value) {
+        hash_fn.hash_many((const uint32_t *)values, r_hashes,
+                          amount);
+    }
+    else {
+        for (uint32_t i = 0; i < amount; i++) {
+            r_hashes[i] = hash_fn(values[i]);
+        }
     }
-};
\ No newline at end of file
+}
@@ -0,0 +1,428 @@
+#pragma once
+
+#include "group_growth.hpp"
+#include "hashing.hpp"
+#include "stats.hpp"
+#include "utils.hpp"
+#include <cstring>
+#include <stdint.h>
+#include <stdlib.h>
+#include <utility>
+#include <vector>
+
+#include <emmintrin.h>
+
+/* Set for large values, e.g. records of 64 to 256 bytes. The
+ * values are appended to a dense vector and the groups only
+ * store the 32 bit index of a value next to its hash byte,
+ * like the compact dict of Python. A group always holds 12
+ * indices in one cache line, no matter how large the values
+ * are, and growing only moves indices, never values.
+ *
+ * The hash of every value is stored next to it, so that the
+ * hash bytes can be recalculated and the groups rebuilt
+ * without hashing the values again.
+ *
+ * Removing a value leaves a hole in the vector. When more than
+ * half of it are holes, the remaining values are moved
+ * together and the groups are rebuilt. Iteration skips the
+ * holes, so it sees the values in insertion order. */
+template <typename T, typename HashFunc>
+class IndexedHashSet : WithStatsCounter {
+  private:
+    static const uint8_t s_group_size = 12;
+
+    struct alignas(64) Group {
+        char hash_bytes[s_group_size];
+        uint8_t count;
+        uint32_t indices[s_group_size];
+
+        /* Loads the count and the padding as well, they are
+         * masked out. */
+        MatchMask match(uint8_t hash_byte) const {
+            __m128i bytes = _mm_load_si128((const __m128i *)this);
+            __m128i equal =
+                _mm_cmpeq_epi8(bytes, _mm_set1_epi8(hash_byte));
+            uint32_t used_mask = (1 << count) - 1;
+            return MatchMask(_mm_movemask_epi8(equal) &
+                             used_mask);
+        }
+    };
+
+    static_assert(sizeof(Group) == 64,
+                  "a group has to fit into one cache line");
+
+    Group *m_groups;
+    uint32_t m_mask;
+    uint8_t m_size_exp;
+    uint8_t m_hash_byte_shift = 0;
+    uint8_t m_reseed_size_exp = 0;
+    std::vector<T> m_values;
+    std::vector<uint32_t> m_hashes;
+    std::vector<bool> m_removed;
+    uint32_t m_removed_amount = 0;
+    HashFunc m_hash_fn;
+
+  public:
+    IndexedHashSet() : m_hash_fn(HashFunc::get_new()) {
+        this->allocate(0);
+    }
+
+    IndexedHashSet(std::initializer_list<T> values)
+        : IndexedHashSet() {
+        for (const T &value : values) {
+            this->insert(value);
+        }
+    }
+
+    IndexedHashSet(const std::vector<T> &values)
+        : IndexedHashSet() {
+        this->reserve(values.size());
+        for (const T &value : values) {
+            this->insert_new(value);
+        }
+    }
+
+    ~IndexedHashSet() {
+        std::free(m_groups);
+    }
+
+    IndexedHashSet(const IndexedHashSet &other) = delete;
+    IndexedHashSet &
+    operator=(const IndexedHashSet &other) = delete;
+
+    inline uint32_t size() const {
+        return m_values.size() - m_removed_amount;
+    }
+
+    /* Same sizing as HashSet::reserve(). The vectors get room
+     * for amount values as well. */
+    void reserve(uint32_t amount) {
+        uint8_t exp =
+            GroupGrowth::size_exp_for(amount, s_group_size);
+        m_values.reserve(amount);
+        m_hashes.reserve(amount);
+        m_removed.reserve(amount);
+
+        if (m_values.empty()) {
+            if (exp > m_size_exp) {
+                std::free(m_groups);
+                this->allocate(exp);
+                m_hash_byte_shift =
+                    GroupGrowth::hash_byte_shift_for(exp);
+            }
+        }
+        else {
+            while (m_size_exp < exp) {
+                this->grow();
+            }
+        }
+    }
+
+    void insert(const T &value) {
+        uint32_t hash = m_hash_fn(value);
+        if (!this->contains(value, hash)) {
+            this->insert_new(value, hash);
+        }
+    }
+
+    void insert(T &&value) {
+        uint32_t hash = m_hash_fn(value);
+        if (!this->contains(value, hash)) {
+            this->insert_new(std::move(value), hash);
+        }
+    }
+
+    void insert_new(const T &value) {
+        this->insert_new(value, m_hash_fn(value));
+    }
+
+    void insert_new(T &&value) {
+        uint32_t hash = m_hash_fn(value);
+        this->insert_new(std::move(value), hash);
+    }
+
+    bool contains(const T &value) const {
+        return this->contains(value, m_hash_fn(value));
+    }
+
+    void remove(const T &value) {
+        auto &&stats = this->stats_counter();
+        uint32_t hash = m_hash_fn(value);
+        Group &group = m_groups[hash & m_mask];
+        uint8_t hash_byte = this->to_hash_byte(hash);
+        stats.count_lookup(1);
+        for (uint8_t position : group.match(hash_byte)) {
+            uint32_t index = group.indices[position];
+            bool found = m_values[index] == value;
+            stats.count_key_comparison(found);
+            if (found) {
+                uint8_t last_position = group.count - 1;
+                group.indices[position] =
+                    group.indices[last_position];
+                group.hash_bytes[position] =
+                    group.hash_bytes[last_position];
+                group.count--;
+
+                m_removed[index] = true;
+                m_removed_amount++;
+                if (m_removed_amount * 2 > m_values.size()) {
+                    this->compact();
+                }
+                return;
+            }
+        }
+    }
+
+    class Iterator {
+      private:
+        const IndexedHashSet *m_set;
+        uint32_t m_index;
+
+      public:
+        Iterator(const IndexedHashSet *set, uint32_t index)
+            : m_set(set), m_index(index) {
+            this->skip_removed();
+        }
+
+        Iterator &operator++() {
+            m_index++;
+            this->skip_removed();
+            return *this;
+        }
+
+        const T &operator*() const {
+            return m_set->m_values[m_index];
+        }
+
+        friend bool operator==(const Iterator &a,
+                               const Iterator &b) {
+            return a.m_index == b.m_index;
+        }
+
+        friend bool operator!=(const Iterator &a,
+                               const Iterator &b) {
+            return !(a == b);
+        }
+
+      private:
+        void skip_removed() {
+            while (m_index < m_set->m_values.size() &&
+                   m_set->m_removed[m_index]) {
+                m_index++;
+            }
+        }
+    };
+
+    /* Iterates in insertion order. */
+    Iterator begin() const {
+        return Iterator(this, 0);
+    }
+
+    Iterator end() const {
+        return Iterator(this, m_values.size());
+    }
+
+    float fullness() const {
+        return this->size() / (float)this->capacity();
+    }
+
+    /* Amount of indices the groups can hold. */
+    uint32_t capacity() const {
+        return this->group_amount() * s_group_size;
+    }
+
+    uint64_t size_in_bytes() const {
+        return sizeof(IndexedHashSet) +
+               (uint64_t)this->group_amount() * sizeof(Group) +
+               (uint64_t)m_values.capacity() * sizeof(T) +
+               (uint64_t)m_hashes.capacity() * sizeof(uint32_t) +
+               m_removed.capacity() / 8;
+    }
+
+    /* Counters are only collected when compiled with
+     * HASH_TABLE_STATS. */
+    HashTableStats stats() const {
+        HashTableStats stats = this->stats_counter().snapshot();
+        stats.size = this->size();
+        stats.capacity = this->capacity();
+        return stats;
+    }
+
+    void reset_stats() {
+        this->stats_counter().reset();
+    }
+
+  private:
+    bool contains(const T &value, uint32_t hash) const {
+        auto &&stats = this->stats_counter();
+        const Group &group = m_groups[hash & m_mask];
+        uint8_t hash_byte = this->to_hash_byte(hash);
+        stats.count_lookup(1);
+        for (uint8_t position : group.match(hash_byte)) {
+            bool found =
+                m_values[group.indices[position]] == value;
+            stats.count_key_comparison(found);
+            if (found) {
+                return true;
+            }
+        }
+        return false;
+    }
+
+    template <typename U>
+    void insert_new(U &&value, uint32_t hash) {
+        while (true) {
+            uint32_t group_index = hash & m_mask;
+            if (m_groups[group_index].count < s_group_size) {
+                this->append(group_index, m_values.size(),
+                             this->to_hash_byte(hash));
+                break;
+            }
+            if (this->should_reseed()) {
+                this->reseed();
+                hash = m_hash_fn(value);
+            }
+            else {
+                this->grow();
+            }
+        }
+        m_values.push_back(std::forward<U>(value));
+        m_hashes.push_back(hash);
+        m_removed.push_back(false);
+    }
+
+    /* Like insert_new(), but for a value that is in the vector
+     * already. Only used while the groups are rebuilt, so it
+     * does not reseed. */
+    void insert_index(uint32_t index, uint32_t hash) {
+        while (true) {
+            uint32_t group_index = hash & m_mask;
+            if (m_groups[group_index].count < s_group_size) {
+                this->append(group_index, index,
+                             this->to_hash_byte(hash));
+                return;
+            }
+            this->grow();
+        }
+    }
+
+    inline void append(uint32_t group_index, uint32_t index,
+                       uint8_t hash_byte) {
+        Group &group = m_groups[group_index];
+        group.indices[group.count] = index;
+        group.hash_bytes[group.count] = hash_byte;
+        group.count++;
+    }
+
+    inline uint8_t to_hash_byte(uint32_t hash) const {
+        return hash >> m_hash_byte_shift;
+    }
+
+    inline uint32_t group_amount() const {
+        return m_mask + 1;
+    }
+
+    /* Same as HashSet::grow(), but only the indices move. */
+    void grow() REAL_NOINLINE {
+        auto timer = this->stats_counter().time_grow();
+
+        uint8_t shift = GroupGrowth::shift_for_grow(
+            m_size_exp, m_hash_byte_shift);
+        if (shift != m_hash_byte_shift) {
+            m_hash_byte_shift = shift;
+            this->recalculate_hash_bytes();
+        }
+
+        uint8_t decision_mask = GroupGrowth::decision_mask(
+            m_size_exp, m_hash_byte_shift);
+
+        uint32_t old_group_amount = this->group_amount();
+        Group *old_groups = m_groups;
+        this->allocate(m_size_exp + 1);
+
+        for (uint32_t i = 0; i < old_group_amount; i++) {
+            const Group &group = old_groups[i];
+            for (uint8_t position = 0; position < group.count;
+                 position++) {
+                uint8_t hash_byte = group.hash_bytes[position];
+                uint32_t group_index =
+                    (hash_byte & decision_mask)
+                        ? old_group_amount + i
+                        : i;
+                this->append(group_index, group.indices[position],
+                             hash_byte);
+            }
+        }
+        std::free(old_groups);
+    }
+
+    /* See GroupGrowth::should_reseed(). */
+    bool should_reseed() const {
+        return GroupGrowth::should_reseed(
+            m_size_exp, m_reseed_size_exp, this->fullness());
+    }
+
+    void reseed() REAL_NOINLINE {
+        auto timer = this->stats_counter().time_grow();
+
+        m_reseed_size_exp = m_size_exp;
+        m_hash_fn = HashFunc::get_new();
+        hash_many(m_hash_fn, m_values.data(), m_hashes.data(),
+                  m_values.size());
+        this->rebuild_groups();
+    }
+
+    /* Moves the values that have not been removed to the front
+     * of the vector, keeping their order. */
+    void compact() REAL_NOINLINE {
+        uint32_t new_amount = 0;
+        for (uint32_t i = 0; i < m_values.size(); i++) {
+            if (m_removed[i]) {
+                continue;
+            }
+            if (i != new_amount) {
+                m_values[new_amount] = std::move(m_values[i]);
+                m_hashes[new_amount] = m_hashes[i];
+            }
+            new_amount++;
+        }
+        m_values.erase(m_values.begin() + new_amount,
+                       m_values.end());
+        m_hashes.resize(new_amount);
+        m_removed.assign(new_amount, false);
+        m_removed_amount = 0;
+        this->rebuild_groups();
+    }
+
+    void rebuild_groups() {
+        std::memset(m_groups, 0,
+                    (uint64_t)this->group_amount() * sizeof(Group));
+        for (uint32_t i = 0; i < m_values.size(); i++) {
+            if (!m_removed[i]) {
+                this->insert_index(i, m_hashes[i]);
+            }
+        }
+    }
+
+    void recalculate_hash_bytes() {
+        for (uint32_t i = 0; i < this->group_amount(); i++) {
+            Group &group = m_groups[i];
+            for (uint8_t position = 0; position < group.count;
+                 position++) {
+                uint32_t hash = m_hashes[group.indices[position]];
+                group.hash_bytes[position] =
+                    hash >> m_hash_byte_shift;
+            }
+        }
+    }
+
+    void allocate(uint8_t size_exp) {
+        uint32_t length = 1 << size_exp;
+        m_size_exp = size_exp;
+        m_mask = length - 1;
+        m_groups = allocate_cache_lines<Group>(length);
+        std::memset(m_groups, 0,
+                    (uint64_t)length * sizeof(Group));
+    }
+};
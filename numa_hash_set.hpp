@@ -0,0 +1,328 @@
+#pragma once
+
+#include "hash_set.hpp"
+#include <algorithm>
+#include <condition_variable>
+#include <fstream>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <pthread.h>
+#include <sched.h>
+#include <stdint.h>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <linux/mempolicy.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+struct NumaNode {
+    int id;
+    std::vector<int> cpus;
+};
+
+/* Reads the nodes from sysfs and changes the placement of
+ * the calling thread with plain system calls, so that there
+ * is no dependency on libnuma. Machines without that
+ * information are treated as a single node. */
+class NumaTopology {
+  public:
+    static std::vector<NumaNode> nodes() {
+        std::vector<NumaNode> nodes;
+        std::string online =
+            read_line("/sys/devices/system/node/online");
+        for (int id : parse_list(online)) {
+            std::string path = "/sys/devices/system/node/node" +
+                               std::to_string(id) + "/cpulist";
+            std::vector<int> cpus = parse_list(read_line(path));
+            /* Nodes that only have memory get no partition. */
+            if (!cpus.empty()) {
+                nodes.push_back({id, cpus});
+            }
+        }
+        if (nodes.empty()) {
+            NumaNode node = {0, {}};
+            uint32_t cpu_amount = std::thread::hardware_concurrency();
+            for (uint32_t cpu = 0; cpu < cpu_amount; cpu++) {
+                node.cpus.push_back(cpu);
+            }
+            nodes.push_back(node);
+        }
+        return nodes;
+    }
+
+    static bool pin_current_thread(const std::vector<int> &cpus) {
+        cpu_set_t set;
+        CPU_ZERO(&set);
+        for (int cpu : cpus) {
+            CPU_SET(cpu, &set);
+        }
+        return pthread_setaffinity_np(pthread_self(), sizeof(set),
+                                      &set) == 0;
+    }
+
+    /* New pages of the calling thread are only taken from the
+     * given node. */
+    static bool bind_current_thread_memory(int node) {
+        return set_mempolicy(MPOL_BIND, {node});
+    }
+
+    static bool
+    interleave_current_thread_memory(const std::vector<NumaNode> &nodes) {
+        std::vector<int> ids;
+        for (const NumaNode &node : nodes) {
+            ids.push_back(node.id);
+        }
+        return set_mempolicy(MPOL_INTERLEAVE, ids);
+    }
+
+    static bool reset_current_thread_memory() {
+        return syscall(SYS_set_mempolicy, MPOL_DEFAULT, nullptr, 0) ==
+               0;
+    }
+
+  private:
+    /* Node ids can be larger than the bits of one word, so the
+     * mask gets as many words as the largest id needs. */
+    static bool set_mempolicy(int mode, const std::vector<int> &ids) {
+        const int word_bits = sizeof(unsigned long) * 8;
+        int max_id = 0;
+        for (int id : ids) {
+            if (id < 0) {
+                return false;
+            }
+            max_id = std::max(max_id, id);
+        }
+        std::vector<unsigned long> mask(max_id / word_bits + 1, 0);
+        for (int id : ids) {
+            mask[id / word_bits] |= 1UL << (id % word_bits);
+        }
+        /* The kernel expects one more than the number of bits. */
+        unsigned long max_node = mask.size() * word_bits + 1;
+        return syscall(SYS_set_mempolicy, mode, mask.data(),
+                       max_node) == 0;
+    }
+
+    static std::string read_line(const std::string &path) {
+        std::ifstream file(path);
+        std::string line;
+        std::getline(file, line);
+        return line;
+    }
+
+    /* Parses lists like "0-3,8,10-11". */
+    static std::vector<int> parse_list(const std::string &list) {
+        std::vector<int> values;
+        size_t start = 0;
+        while (start < list.size()) {
+            size_t end = list.find(',', start);
+            if (end == std::string::npos) {
+                end = list.size();
+            }
+            std::string range = list.substr(start, end - start);
+            size_t dash = range.find('-');
+            int first = std::stoi(range.substr(0, dash));
+            int last = dash == std::string::npos
+                           ? first
+                           : std::stoi(range.substr(dash + 1));
+            for (int value = first; value <= last; value++) {
+                values.push_back(value);
+            }
+            start = end + 1;
+        }
+        return values;
+    }
+};
+
+/* Thread that is pinned to one node and only allocates
+ * memory there. It runs one task at a time. */
+class NumaWorker {
+  private:
+    std::mutex m_mutex;
+    std::condition_variable m_condition;
+    std::function<void()> m_task;
+    bool m_busy = false;
+    bool m_stop = false;
+    std::thread m_thread;
+
+  public:
+    NumaWorker(const NumaNode &node)
+        : m_thread([this, node]() { this->run(node); }) {}
+
+    ~NumaWorker() {
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            m_stop = true;
+        }
+        m_condition.notify_all();
+        m_thread.join();
+    }
+
+    void post(std::function<void()> task) {
+        {
+            std::unique_lock<std::mutex> lock(m_mutex);
+            m_condition.wait(lock, [this]() { return !m_busy; });
+            m_task = std::move(task);
+            m_busy = true;
+        }
+        m_condition.notify_all();
+    }
+
+    void wait() {
+        std::unique_lock<std::mutex> lock(m_mutex);
+        m_condition.wait(lock, [this]() { return !m_busy; });
+    }
+
+  private:
+    void run(const NumaNode &node) {
+        NumaTopology::pin_current_thread(node.cpus);
+        /* When this is not allowed, first touch from the pinned
+         * thread still places the pages on the node. */
+        NumaTopology::bind_current_thread_memory(node.id);
+        while (true) {
+            std::unique_lock<std::mutex> lock(m_mutex);
+            m_condition.wait(lock,
+                             [this]() { return m_busy || m_stop; });
+            if (!m_busy) {
+                return;
+            }
+            lock.unlock();
+            m_task();
+            lock.lock();
+            m_task = nullptr;
+            m_busy = false;
+            lock.unlock();
+            m_condition.notify_all();
+        }
+    }
+};
+
+/* HashSet that is split into one partition per NUMA node.
+ * The partition of a value is chosen by the high bits of
+ * its mixed hash, the partitions themselves use the low bits
+ * as usual. Every partition is only modified by a worker
+ * pinned to its node, so its groups end up in local memory.
+ *
+ * Batched operations are split by partition and every
+ * worker handles its own share, so that all accesses are
+ * local. Batches from multiple threads are serialized, and
+ * so are the methods that read the partitions directly. */
+template <typename T, typename HashFunc>
+class NumaHashSet {
+  private:
+    struct Partition {
+        NumaWorker worker;
+        HashSet<T, HashFunc> set;
+
+        Partition(const NumaNode &node) : worker(node) {}
+    };
+
+    std::vector<std::unique_ptr<Partition>> m_partitions;
+    HashFunc m_hash_fn;
+
+    mutable std::mutex m_batch_mutex;
+    mutable std::vector<std::vector<uint32_t>> m_batch_indices;
+
+  public:
+    NumaHashSet(const std::vector<NumaNode> &nodes =
+                    NumaTopology::nodes())
+        : m_hash_fn(HashFunc::get_new()),
+          m_batch_indices(nodes.size()) {
+        for (const NumaNode &node : nodes) {
+            m_partitions.emplace_back(new Partition(node));
+        }
+    }
+
+    NumaHashSet(const NumaHashSet &other) = delete;
+    NumaHashSet &operator=(const NumaHashSet &other) = delete;
+
+    uint32_t partition_amount() const {
+        return m_partitions.size();
+    }
+
+    uint32_t size() const {
+        std::lock_guard<std::mutex> lock(m_batch_mutex);
+        uint32_t size = 0;
+        for (auto &partition : m_partitions) {
+            size += partition->set.size();
+        }
+        return size;
+    }
+
+    uint64_t size_in_bytes() const {
+        std::lock_guard<std::mutex> lock(m_batch_mutex);
+        uint64_t size = sizeof(NumaHashSet);
+        for (auto &partition : m_partitions) {
+            size += partition->set.size_in_bytes();
+        }
+        return size;
+    }
+
+    void insert(const T &value) {
+        this->insert_many(&value, 1);
+    }
+
+    void insert_many(const T *values, uint32_t amount) {
+        this->run_batch(values, amount,
+                        [&](Partition &partition, uint32_t index) {
+                            T value = values[index];
+                            partition.set.insert(value);
+                        });
+    }
+
+    /* Reads the partition from the calling thread, which is
+     * fine for occasional lookups. Takes the batch lock, because
+     * a worker might grow the partition at the same time. */
+    bool contains(const T &value) const {
+        std::lock_guard<std::mutex> lock(m_batch_mutex);
+        return m_partitions[this->partition_index(value)]
+            ->set.contains(value);
+    }
+
+    void contains_many(const T *values, uint32_t amount,
+                       bool *r_found) const {
+        this->run_batch(values, amount,
+                        [&](Partition &partition, uint32_t index) {
+                            r_found[index] =
+                                partition.set.contains(values[index]);
+                        });
+    }
+
+  private:
+    uint32_t partition_index(const T &value) const {
+        uint32_t mixed =
+            (m_hash_fn(value) * 0x9E3779B97F4A7C15ULL) >> 32;
+        return ((uint64_t)mixed * m_partitions.size()) >> 32;
+    }
+
+    template <typename Fn>
+    void run_batch(const T *values, uint32_t amount,
+                   const Fn &fn) const {
+        std::lock_guard<std::mutex> lock(m_batch_mutex);
+        for (std::vector<uint32_t> &indices : m_batch_indices) {
+            indices.clear();
+        }
+        for (uint32_t i = 0; i < amount; i++) {
+            m_batch_indices[this->partition_index(values[i])]
+                .push_back(i);
+        }
+        for (uint32_t p = 0; p < m_partitions.size(); p++) {
+            if (m_batch_indices[p].empty()) {
+                continue;
+            }
+            Partition &partition = *m_partitions[p];
+            const std::vector<uint32_t> &indices =
+                m_batch_indices[p];
+            partition.worker.post([&partition, &indices, &fn]() {
+                for (uint32_t index : indices) {
+                    fn(partition, index);
+                }
+            });
+        }
+        for (auto &partition : m_partitions) {
+            partition->worker.wait();
+        }
+    }
+};
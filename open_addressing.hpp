@@ -0,0 +1,1764 @@
+#pragma once
+
+#include <iostream>
+#include <algorithm>
+#include <memory>
+#include <string>
+#include <type_traits>
+#include <array>
+#include <atomic>
+#include <cassert>
+#include <cstddef>
+#include <cstdlib>
+#include <cstring>
+#include <vector>
+#include <stdint.h>
+#include <emmintrin.h>
+#include <xmmintrin.h>
+#include "hashing.hpp"
+#include "radix_partition.hpp"
+#include "stats.hpp"
+#include "utils.hpp"
+
+/* The probing strategy is as follows:
+ *   hash = compute_hash(value);
+ *   perturb = hash;
+ *   while (true) {
+ *       group_index = (hash & mask) >> 2;
+ *       offset = hash & 3;
+ *       initial_offset = offset;
+ *       do {
+ *           handle_and_possibly_return(group_index, offset);
+ *           offset = (offset + 1) & 3;
+ *       } while (offset != initial_offset);
+ *       perturb >>= 5;
+ *       hash = hash * 5 + 1 + perturb;
+ *   }
+ *
+ * Features of this strategy:
+ *    1. Cache friendly. The inner loop always checks 4 items that are (usually) on the same cache
+ * line.
+ *    2. Can deal with bad/trivial hash functions. Eventually, all bits of the computed hash will
+ * have an impact. This is because the variable perturb is shifted and mixed into the hash.
+ * Therefore, clustering as known from linear probing should not happen.
+ *    3. Hits every slot in the table. This is important to guarantee correctness. Basically, when
+ * there is an empty slot it will be found. This is achieved using the hash * 5 + 1 part. The
+ * perturb will be 0 eventually.
+ *    4. The first few collisions (the common case) are handled very cheaply.
+ *    5. Naturally supports values being grouped together to avoid padding when they are
+ * interleaved.
+ */
+
+template<typename T> class MyHash {
+};
+
+template<> class MyHash<int> {
+ public:
+  uint32_t operator()(int value)
+  {
+    return (uint32_t)value;
+  }
+};
+
+template<> class MyHash<uint32_t> {
+ public:
+  uint32_t operator()(uint32_t value)
+  {
+    return value;
+  }
+};
+
+template<> class MyHash<uint64_t> {
+ public:
+  uint32_t operator()(uint64_t value)
+  {
+    return (uint32_t)(value ^ (value >> 32));
+  }
+};
+
+template<> class MyHash<std::string> {
+ public:
+  uint32_t operator()(const std::string &value)
+  {
+    uint32_t hash = 1331;
+    for (char c : value) {
+      hash = hash * 33 + c;
+    }
+    return hash;
+  }
+};
+
+/* MyHash is fixed, so values that collide can be chosen in advance. Every table therefore mixes
+ * it with its own random multiply-add-shift function. Types for which MyHash itself collides
+ * easily get their own keyed hash, because no mixing can separate values that MyHash maps to the
+ * same hash already. */
+template<typename T> class SeededHash {
+ private:
+  uint64_t m_multiplier;
+  uint64_t m_increment;
+
+ public:
+  SeededHash() : m_multiplier(new_hash_seed() | 1), m_increment(new_hash_seed())
+  {
+  }
+
+  uint32_t operator()(const T &value) const
+  {
+    return multiply_shift_hash(m_multiplier, m_increment, MyHash<T>{}(value));
+  }
+
+  void hash_many(const T *values, uint32_t *r_hashes, uint32_t amount) const
+  {
+    /* MyHash is the identity for these. */
+    if constexpr (std::is_same<T, int>::value || std::is_same<T, uint32_t>::value) {
+      multiply_shift_hash_many(
+          m_multiplier, m_increment, (const uint32_t *)values, r_hashes, amount);
+    }
+    else {
+      for (uint32_t i = 0; i < amount; i++) {
+        r_hashes[i] = (*this)(values[i]);
+      }
+    }
+  }
+};
+
+template<> class SeededHash<uint64_t> {
+ private:
+  uint64_t m_multiplier_low;
+  uint64_t m_multiplier_high;
+  uint64_t m_increment;
+
+ public:
+  SeededHash()
+      : m_multiplier_low(new_hash_seed()),
+        m_multiplier_high(new_hash_seed()),
+        m_increment(new_hash_seed())
+  {
+  }
+
+  uint32_t operator()(uint64_t value) const
+  {
+    return (m_multiplier_low * (uint32_t)value + m_multiplier_high * (value >> 32) +
+            m_increment) >>
+           32;
+  }
+
+  void hash_many(const uint64_t *values, uint32_t *r_hashes, uint32_t amount) const
+  {
+    for (uint32_t i = 0; i < amount; i++) {
+      r_hashes[i] = (*this)(values[i]);
+    }
+  }
+};
+
+template<> class SeededHash<std::string> {
+ private:
+  uint64_t m_k0;
+  uint64_t m_k1;
+
+ public:
+  SeededHash() : m_k0(new_hash_seed()), m_k1(new_hash_seed())
+  {
+  }
+
+  uint32_t operator()(const std::string &value) const
+  {
+    return siphash13(value.data(), value.size(), m_k0, m_k1);
+  }
+
+  void hash_many(const std::string *values, uint32_t *r_hashes, uint32_t amount) const
+  {
+    for (uint32_t i = 0; i < amount; i++) {
+      r_hashes[i] = (*this)(values[i]);
+    }
+  }
+};
+
+template<typename T> void uninitialized_copy_1(const T *from, T *to)
+{
+  std::uninitialized_copy_n(from, 1, to);
+}
+
+template<typename T> void uninitialized_move_1(T *from, T *to)
+{
+  std::uninitialized_copy_n(std::make_move_iterator(from), 1, to);
+}
+
+/* Compares the 4 status bytes of a group at once. Bit i is set when status[i] == wanted. */
+inline MatchMask match_status(const uint8_t status[4], uint8_t wanted)
+{
+  int32_t word;
+  std::memcpy(&word, status, 4);
+  __m128i equal = _mm_cmpeq_epi8(_mm_cvtsi32_si128(word), _mm_set1_epi8(wanted));
+  return MatchMask(_mm_movemask_epi8(equal) & 0xF);
+}
+
+constexpr unsigned floorlog2(unsigned x)
+{
+  return x == 1 ? 0 : 1 + floorlog2(x >> 1);
+}
+
+constexpr unsigned ceillog2(unsigned x)
+{
+  return x == 1 ? 0 : floorlog2(x - 1) + 1;
+}
+
+template<> class MyHash<void *> {
+ public:
+  uint32_t operator()(void *value)
+  {
+    return ((uint64_t)value) >> 2;
+  }
+};
+
+template<typename T> class MyHash<T *> {
+ public:
+  uint32_t operator()(T *value)
+  {
+    return (uint32_t)((uintptr_t)value >> ceillog2(alignof(T)));
+  }
+};
+
+const uint32_t prime_numbers[] = {
+    1,        3,        7,         13,        31,        61,         127,        251,
+    509,      1021,     2039,      4093,      8191,      16381,      32749,      65521,
+    131071,   262139,   524287,    1048573,   2097143,   4194301,    8388593,    16777213,
+    33554393, 67108859, 134217689, 268435399, 536870912, 1073741789, 2147483647, 4294967291};
+
+/* Groups that do not fit into the small storage are allocated together with a user count. Copies
+ * share these groups and only clone them when ensure_not_shared() is called before the first
+ * modification. This makes copies that are only read from O(1). */
+template<typename SlotGroup, uint32_t GroupsInSmallStorage = 1> class GroupedOpenAddressingArray {
+ private:
+  static constexpr auto slots_per_group = SlotGroup::slots_per_group;
+  static constexpr size_t header_size = alignof(std::max_align_t);
+
+  static_assert(alignof(SlotGroup) <= header_size, "groups have to be aligned by malloc");
+  static_assert(sizeof(std::atomic<uint32_t>) <= header_size, "user count does not fit");
+
+  SlotGroup *m_groups;
+  uint32_t m_group_amount;
+  uint8_t m_group_exponent;
+  uint32_t m_slots_total;
+  uint32_t m_slots_set_or_dummy;
+  uint32_t m_slots_dummy;
+  uint32_t m_slot_mask;
+  alignas(SlotGroup) char m_local_storage[sizeof(SlotGroup) * GroupsInSmallStorage];
+
+ public:
+  explicit GroupedOpenAddressingArray(uint8_t group_exponent = 0)
+  {
+    m_slots_total = (1 << group_exponent) * slots_per_group;
+    m_slots_set_or_dummy = 0;
+    m_slots_dummy = 0;
+    m_slot_mask = m_slots_total - 1;
+    m_group_amount = m_slots_total / slots_per_group;
+    m_group_exponent = group_exponent;
+
+    if (m_group_amount <= GroupsInSmallStorage) {
+      m_groups = this->small_storage();
+    }
+    else {
+      m_groups = allocate_shared_groups(m_group_amount);
+    }
+
+    for (uint32_t i = 0; i < m_group_amount; i++) {
+      new (m_groups + i) SlotGroup();
+    }
+  }
+
+  ~GroupedOpenAddressingArray()
+  {
+    if (m_groups == nullptr) {
+      return;
+    }
+    if (this->is_in_small_storage()) {
+      std::destroy_n(m_groups, m_group_amount);
+    }
+    else {
+      release_shared_groups(m_groups, m_group_amount);
+    }
+  }
+
+  GroupedOpenAddressingArray(const GroupedOpenAddressingArray &other)
+  {
+    m_slots_total = other.m_slots_total;
+    m_slots_set_or_dummy = other.m_slots_set_or_dummy;
+    m_slots_dummy = other.m_slots_dummy;
+    m_slot_mask = other.m_slot_mask;
+    m_group_amount = other.m_group_amount;
+    m_group_exponent = other.m_group_exponent;
+
+    if (other.is_in_small_storage()) {
+      m_groups = this->small_storage();
+      std::uninitialized_copy_n(other.m_groups, m_group_amount, m_groups);
+    }
+    else {
+      m_groups = other.m_groups;
+      users(m_groups).fetch_add(1, std::memory_order_relaxed);
+    }
+  }
+
+  GroupedOpenAddressingArray(GroupedOpenAddressingArray &&other)
+  {
+    m_slots_total = other.m_slots_total;
+    m_slots_set_or_dummy = other.m_slots_set_or_dummy;
+    m_slots_dummy = other.m_slots_dummy;
+    m_slot_mask = other.m_slot_mask;
+    m_group_amount = other.m_group_amount;
+    m_group_exponent = other.m_group_exponent;
+    if (other.is_in_small_storage()) {
+      m_groups = this->small_storage();
+      std::uninitialized_copy_n(std::make_move_iterator(other.m_groups), m_group_amount, m_groups);
+      for (uint32_t i = 0; i < other.m_group_amount; i++) {
+        other.m_groups[i].~SlotGroup();
+      }
+    }
+    else {
+      m_groups = other.m_groups;
+    }
+
+    other.m_groups = nullptr;
+    other.~GroupedOpenAddressingArray();
+    new (&other) GroupedOpenAddressingArray();
+  }
+
+  GroupedOpenAddressingArray &operator=(const GroupedOpenAddressingArray &other)
+  {
+    if (this == &other) {
+      return *this;
+    }
+    this->~GroupedOpenAddressingArray();
+    new (this) GroupedOpenAddressingArray(other);
+    return *this;
+  }
+
+  GroupedOpenAddressingArray &operator=(GroupedOpenAddressingArray &&other)
+  {
+    if (this == &other) {
+      return *this;
+    }
+    this->~GroupedOpenAddressingArray();
+    new (this) GroupedOpenAddressingArray(std::move(other));
+    return *this;
+  }
+
+  GroupedOpenAddressingArray init_reserved(uint32_t min_usable_slots) const
+  {
+    uint8_t group_exponent = ceillog2(min_usable_slots / slots_per_group + 1) + 1;
+    GroupedOpenAddressingArray grown(group_exponent);
+    grown.m_slots_set_or_dummy = this->slots_set();
+    return grown;
+  }
+
+  GroupedOpenAddressingArray init_same_size() const
+  {
+    GroupedOpenAddressingArray rebuilt(m_group_exponent);
+    rebuilt.m_slots_set_or_dummy = this->slots_set();
+    return rebuilt;
+  }
+
+  uint32_t slots_total() const
+  {
+    return m_slots_total;
+  }
+
+  uint32_t slots_set() const
+  {
+    return m_slots_set_or_dummy - m_slots_dummy;
+  }
+
+  uint32_t slots_dummy() const
+  {
+    return m_slots_dummy;
+  }
+
+  void update__empty_to_set()
+  {
+    m_slots_set_or_dummy++;
+  }
+
+  void update__dummy_to_set()
+  {
+    m_slots_dummy--;
+  }
+
+  void update__set_to_dummy(uint32_t amount = 1)
+  {
+    m_slots_dummy += amount;
+  }
+
+  uint32_t slot_mask() const
+  {
+    return m_slot_mask;
+  }
+
+  const SlotGroup &group(uint32_t group_index) const
+  {
+    return m_groups[group_index];
+  }
+
+  SlotGroup &group(uint32_t group_index)
+  {
+    return m_groups[group_index];
+  }
+
+  uint8_t group_exponent() const
+  {
+    return m_group_exponent;
+  }
+
+  uint32_t group_amount() const
+  {
+    return m_group_amount;
+  }
+
+  bool should_grow() const
+  {
+    return m_slots_set_or_dummy >= m_slots_total / 2;
+  }
+
+  uint64_t allocated_size_in_bytes() const
+  {
+    return this->is_in_small_storage() ? 0 : (uint64_t)m_group_amount * sizeof(SlotGroup);
+  }
+
+  bool is_shared() const
+  {
+    return !this->is_in_small_storage() && users(m_groups).load(std::memory_order_acquire) > 1;
+  }
+
+  /* Has to be called before groups are modified. */
+  void ensure_not_shared()
+  {
+    if (this->is_shared()) {
+      SlotGroup *groups = allocate_shared_groups(m_group_amount);
+      std::uninitialized_copy_n(m_groups, m_group_amount, groups);
+      release_shared_groups(m_groups, m_group_amount);
+      m_groups = groups;
+    }
+  }
+
+  SlotGroup *begin()
+  {
+    return m_groups;
+  }
+
+  SlotGroup *end()
+  {
+    return m_groups + m_group_amount;
+  }
+
+  const SlotGroup *begin() const
+  {
+    return m_groups;
+  }
+
+  const SlotGroup *end() const
+  {
+    return m_groups + m_group_amount;
+  }
+
+ private:
+  SlotGroup *small_storage() const
+  {
+    return reinterpret_cast<SlotGroup *>((char *)m_local_storage);
+  }
+
+  bool is_in_small_storage() const
+  {
+    return m_groups == this->small_storage();
+  }
+
+  static std::atomic<uint32_t> &users(SlotGroup *groups)
+  {
+    return *reinterpret_cast<std::atomic<uint32_t> *>((char *)groups - header_size);
+  }
+
+  static SlotGroup *allocate_shared_groups(uint32_t group_amount)
+  {
+    char *memory = static_cast<char *>(malloc(header_size + group_amount * sizeof(SlotGroup)));
+    new (memory) std::atomic<uint32_t>(1);
+    return reinterpret_cast<SlotGroup *>(memory + header_size);
+  }
+
+  static void release_shared_groups(SlotGroup *groups, uint32_t group_amount)
+  {
+    if (users(groups).fetch_sub(1, std::memory_order_acq_rel) == 1) {
+      std::destroy_n(groups, group_amount);
+      free(static_cast<void *>((char *)groups - header_size));
+    }
+  }
+};
+
+template<typename T> class Set : WithStatsCounter {
+ private:
+  static constexpr uint32_t OFFSET_MASK = 3;
+  static constexpr uint8_t IS_EMPTY = 0;
+  static constexpr uint8_t IS_SET = 1;
+  static constexpr uint8_t IS_DUMMY = 2;
+
+  class Group {
+   private:
+    uint8_t m_status[4];
+    alignas(T) char m_values[4 * sizeof(T)];
+
+   public:
+    static constexpr uint32_t slots_per_group = 4;
+
+    Group()
+    {
+      m_status[0] = IS_EMPTY;
+      m_status[1] = IS_EMPTY;
+      m_status[2] = IS_EMPTY;
+      m_status[3] = IS_EMPTY;
+    }
+
+    ~Group()
+    {
+      for (uint8_t offset : this->set_slots()) {
+        this->value(offset)->~T();
+      }
+    }
+
+    Group(const Group &other)
+    {
+      std::memcpy(m_status, other.m_status, 4);
+      for (uint8_t offset : other.set_slots()) {
+        uninitialized_copy_1(other.value(offset), this->value(offset));
+      }
+    }
+
+    Group(Group &&other)
+    {
+      std::memcpy(m_status, other.m_status, 4);
+      for (uint8_t offset : other.set_slots()) {
+        uninitialized_move_1(other.value(offset), this->value(offset));
+      }
+    }
+
+    Group &operator=(const Group &other) = delete;
+    Group &operator=(Group &&other) = delete;
+
+    const uint8_t &status(uint32_t offset) const
+    {
+      return m_status[offset];
+    }
+
+    uint8_t &status(uint32_t offset)
+    {
+      return m_status[offset];
+    }
+
+    MatchMask set_slots() const
+    {
+      return match_status(m_status, IS_SET);
+    }
+
+    T *value(uint32_t offset) const
+    {
+      return (T *)(m_values + offset * sizeof(T));
+    }
+
+    void copy_in(uint32_t offset, const T &value)
+    {
+      assert(m_status[offset] != IS_SET);
+      m_status[offset] = IS_SET;
+      uninitialized_copy_1(&value, this->value(offset));
+    }
+
+    void move_in(uint32_t offset, T &value)
+    {
+      assert(m_status[offset] != IS_SET);
+      m_status[offset] = IS_SET;
+      uninitialized_move_1(&value, this->value(offset));
+    }
+
+    void set_dummy(uint32_t offset)
+    {
+      assert(m_status[offset] == IS_SET);
+      m_status[offset] = IS_DUMMY;
+      this->value(offset)->~T();
+    }
+
+    bool has_value(uint32_t offset, const T &value) const
+    {
+      return m_status[offset] == IS_SET && *this->value(offset) == value;
+    }
+  };
+
+  /* Probes that are longer than this are very unlikely in a table that is at most half full,
+   * unless many values have the same initial slot. */
+  static constexpr uint32_t s_max_probe_length = 128;
+  /* Groups per range that erase_if() hands to a thread. */
+  static constexpr uint32_t s_parallel_grain = 1 << 14;
+
+  GroupedOpenAddressingArray<Group> m_array = GroupedOpenAddressingArray<Group>();
+  SeededHash<T> m_hash;
+  /* Changes whenever the hash function is replaced, so that precomputed hashes are stale. */
+  uint32_t m_hash_generation = 0;
+  uint8_t m_reseed_group_exponent = 0;
+
+ public:
+  Set() = default;
+
+  // clang-format off
+
+#define ITER_SLOTS_BEGIN(VALUE, ARRAY, OPTIONAL_CONST, R_GROUP, R_OFFSET) \
+  ITER_SLOTS_BEGIN_HASHED(m_hash(VALUE), ARRAY, OPTIONAL_CONST, R_GROUP, R_OFFSET)
+
+#define ITER_SLOTS_BEGIN_HASHED(HASH, ARRAY, OPTIONAL_CONST, R_GROUP, R_OFFSET) \
+  uint32_t hash = HASH; \
+  uint32_t perturb = hash; \
+  while (true) { \
+    uint32_t group_index = (hash & ARRAY.slot_mask()) >> 2; \
+    uint8_t R_OFFSET = hash & OFFSET_MASK; \
+    uint8_t initial_offset = R_OFFSET; \
+    OPTIONAL_CONST Group &R_GROUP = ARRAY.group(group_index); \
+    do {
+
+#define ITER_SLOTS_END(R_OFFSET) \
+      R_OFFSET = (R_OFFSET + 1) & OFFSET_MASK; \
+    } while (R_OFFSET != initial_offset); \
+    perturb >>= 5; \
+    hash = hash * 5 + 1 + perturb; \
+  } ((void)0)
+
+  // clang-format on
+
+  /* Only grows when the table would have to grow before min_usable_slots values are set. */
+  void reserve(uint32_t min_usable_slots)
+  {
+    if (min_usable_slots + m_array.slots_dummy() >= m_array.slots_total() / 2) {
+      this->grow(min_usable_slots);
+    }
+  }
+
+  void add_new(const T &value)
+  {
+    assert(!this->contains(value));
+    this->ensure_can_add();
+
+    uint32_t probe_length = 0;
+    ITER_SLOTS_BEGIN (value, m_array, , group, offset) {
+      probe_length++;
+      if (group.status(offset) == IS_EMPTY) {
+        group.copy_in(offset, value);
+        m_array.update__empty_to_set();
+        this->reseed_if_unbalanced(probe_length);
+        return;
+      }
+    }
+    ITER_SLOTS_END(offset);
+  }
+
+  /* Reserves space for all values up front, so that the table does not grow in the middle of the
+   * batch. The hashes are computed in blocks and the groups of upcoming values are prefetched.
+   *
+   * With partition_by_slot, large batches are sorted by slot first, so that the adds walk through
+   * the table in order. This changes the order of the values. */
+  void add_many(T *values, uint32_t amount, bool partition_by_slot = false)
+  {
+    this->reserve(this->size() + amount);
+    m_array.ensure_not_shared();
+
+    if (partition_by_slot && amount > radix_partition_min_length) {
+      std::vector<uint32_t> hashes(amount);
+      this->hash_many(values, hashes.data(), amount);
+      radix_partition(values, hashes.data(), amount, 2, m_array.group_exponent());
+      this->add_many__hashed(values, hashes.data(), amount);
+      return;
+    }
+
+    constexpr uint32_t block_size = 256;
+    uint32_t hashes[block_size];
+    for (uint32_t start = 0; start < amount; start += block_size) {
+      uint32_t block_amount = std::min(block_size, amount - start);
+      this->hash_many(values + start, hashes, block_amount);
+      this->add_many__hashed(values + start, hashes, block_amount);
+    }
+  }
+
+  bool add(const T &value)
+  {
+    this->ensure_can_add();
+    return this->add__hashed(value, m_hash(value));
+  }
+
+  bool contains(const T &value) const
+  {
+    auto &&stats = this->stats_counter();
+    uint32_t probe_length = 0;
+    ITER_SLOTS_BEGIN (value, m_array, const, group, offset) {
+      probe_length++;
+      uint8_t status = group.status(offset);
+      if (status == IS_EMPTY) {
+        stats.count_lookup(probe_length);
+        return false;
+      }
+      else if (status == IS_SET) {
+        bool found = *group.value(offset) == value;
+        stats.count_key_comparison(found);
+        if (found) {
+          stats.count_lookup(probe_length);
+          return true;
+        }
+      }
+    }
+    ITER_SLOTS_END(offset);
+  }
+
+  void remove(const T &value)
+  {
+    assert(this->contains(value));
+    m_array.ensure_not_shared();
+    auto &&stats = this->stats_counter();
+    uint32_t probe_length = 0;
+    ITER_SLOTS_BEGIN (value, m_array, , group, offset) {
+      probe_length++;
+      if (group.has_value(offset, value)) {
+        group.set_dummy(offset);
+        m_array.update__set_to_dummy();
+        stats.count_lookup(probe_length);
+        return;
+      }
+    }
+    ITER_SLOTS_END(offset);
+  }
+
+  uint32_t size() const
+  {
+    return m_array.slots_set();
+  }
+
+  /* Counters are only collected when compiled with HASH_TABLE_STATS. */
+  HashTableStats stats() const
+  {
+    HashTableStats stats = this->stats_counter().snapshot();
+    stats.size = m_array.slots_set();
+    stats.capacity = m_array.slots_total();
+    stats.tombstones = m_array.slots_dummy();
+    return stats;
+  }
+
+  void reset_stats()
+  {
+    this->stats_counter().reset();
+  }
+
+  uint64_t size_in_bytes() const
+  {
+    return sizeof(*this) + m_array.allocated_size_in_bytes();
+  }
+
+  /* Splits the groups into ranges of grain groups that can be given to for_each_in_groups() on
+   * different threads, e.g. by a thread pool. */
+  std::vector<IndexRange> group_ranges(uint32_t grain) const
+  {
+    return split_range(m_array.group_amount(), grain);
+  }
+
+  template<typename Fn> void for_each_in_groups(IndexRange range, const Fn &fn) const
+  {
+    for (uint32_t i = range.begin; i < range.end; i++) {
+      const Group &group = m_array.group(i);
+      for (uint8_t offset : group.set_slots()) {
+        fn(*group.value(offset));
+      }
+    }
+  }
+
+  /* fn(value) is called from different threads at the same time. */
+  template<typename Fn>
+  void parallel_for_each(const Fn &fn,
+                         uint32_t grain,
+                         uint32_t thread_amount = std::thread::hardware_concurrency()) const
+  {
+    parallel_for_grains(
+        m_array.group_amount(), grain, thread_amount, [&](uint32_t begin, uint32_t end) {
+          this->for_each_in_groups({begin, end}, fn);
+        });
+  }
+
+  /* Removed values become dummies in their slot, so the groups are independent and can be
+   * processed by different threads. Returns the number of removed values. */
+  template<typename Pred>
+  uint32_t erase_if(const Pred &pred,
+                    uint32_t grain = s_parallel_grain,
+                    uint32_t thread_amount = std::thread::hardware_concurrency())
+  {
+    m_array.ensure_not_shared();
+    std::atomic<uint32_t> removed{0};
+    parallel_for_grains(
+        m_array.group_amount(), grain, thread_amount, [&](uint32_t begin, uint32_t end) {
+          uint32_t removed_in_range = 0;
+          for (uint32_t i = begin; i < end; i++) {
+            Group &group = m_array.group(i);
+            for (uint8_t offset : group.set_slots()) {
+              if (pred(*group.value(offset))) {
+                group.set_dummy(offset);
+                removed_in_range++;
+              }
+            }
+          }
+          removed.fetch_add(removed_in_range, std::memory_order_relaxed);
+        });
+    m_array.update__set_to_dummy(removed.load());
+    return removed.load();
+  }
+
+  void print_table() const
+  {
+    std::cout << "Hash Table:\n";
+    std::cout << "  Size: " << m_array.slots_set() << '\n';
+    std::cout << "  Capacity: " << m_array.slots_total() << '\n';
+    uint32_t group_index = 0;
+    for (const Group &group : m_array) {
+      std::cout << "   Group: " << group_index++ << '\n';
+      for (uint32_t offset = 0; offset < 4; offset++) {
+        std::cout << "    " << offset << " \t";
+        uint8_t status = group.status(offset);
+        if (status == IS_EMPTY) {
+          std::cout << "    <empty>\n";
+        }
+        else if (status == IS_SET) {
+          const T &value = *group.value(offset);
+          uint32_t collisions = this->count_collisions(value);
+          std::cout << "    " << value << "  \t Collisions: " << collisions << '\n';
+        }
+
+        else if (status == IS_DUMMY) {
+          std::cout << "    <dummy>\n";
+        }
+      }
+    }
+  }
+
+  class Iterator {
+   private:
+    Set<T> *m_set;
+    uint32_t m_slot;
+    /* The set slots of the current group that come after m_slot. */
+    uint32_t m_later_slots;
+
+   public:
+    Iterator(Set *set, uint32_t slot, uint32_t later_slots = 0)
+        : m_set(set), m_slot(slot), m_later_slots(later_slots)
+    {
+    }
+
+    Iterator &operator++()
+    {
+      if (m_later_slots == 0) {
+        *this = m_set->iterator_from_group((m_slot >> 2) + 1);
+      }
+      else {
+        m_slot = (m_slot & ~OFFSET_MASK) + count_trailing_zeros(m_later_slots);
+        m_later_slots = clear_lowest_bit(m_later_slots);
+      }
+      return *this;
+    }
+
+    const T &operator*() const
+    {
+      uint32_t group_index = m_slot >> 2;
+      uint32_t offset = m_slot & OFFSET_MASK;
+      Group &group = m_set->m_array.group(group_index);
+      assert(group.status(offset) == IS_SET);
+      return *group.value(offset);
+    }
+
+    friend bool operator==(const Iterator &a, const Iterator &b)
+    {
+      assert(a.m_set == b.m_set);
+      return a.m_slot == b.m_slot;
+    }
+
+    friend bool operator!=(const Iterator &a, const Iterator &b)
+    {
+      return !(a == b);
+    }
+  };
+
+  friend Iterator;
+
+  Iterator begin()
+  {
+    return this->iterator_from_group(0);
+  }
+
+  Iterator end()
+  {
+    return Iterator(this, m_array.slots_total());
+  }
+
+ private:
+  /* Starts at the first value in the groups from group_index on. Empty groups are skipped with
+   * one comparison of their status bytes. */
+  Iterator iterator_from_group(uint32_t group_index)
+  {
+    uint32_t group_amount = m_array.slots_total() >> 2;
+    for (; group_index < group_amount; group_index++) {
+      uint32_t set_slots = m_array.group(group_index).set_slots().bits();
+      if (set_slots != 0) {
+        return Iterator(this,
+                        (group_index << 2) + count_trailing_zeros(set_slots),
+                        clear_lowest_bit(set_slots));
+      }
+    }
+    return this->end();
+  }
+
+  /* Also makes sure that the groups are not shared with a copy anymore. */
+  void ensure_can_add()
+  {
+    if (m_array.should_grow()) {
+      this->grow(this->size() + 1);
+    }
+    else {
+      m_array.ensure_not_shared();
+    }
+  }
+
+  void grow(uint32_t min_usable_slots)
+  {
+    // std::cout << "Grow at " << m_array.slots_set() << '/' << m_array.slots_total() << '\n';
+    auto timer = this->stats_counter().time_grow();
+    this->rebuild(m_array.init_reserved(min_usable_slots));
+  }
+
+  /* Growing would not shorten the probes of values that have the same hash. Instead, the table is
+   * rebuilt with a new hash function. This is only tried once per table size, so that values
+   * that collide with every hash function do not rebuild the table over and over. Returns true
+   * when the values have moved. */
+  bool reseed_if_unbalanced(uint32_t probe_length)
+  {
+    if (probe_length <= s_max_probe_length ||
+        m_array.group_exponent() == m_reseed_group_exponent) {
+      return false;
+    }
+    auto timer = this->stats_counter().time_grow();
+    m_reseed_group_exponent = m_array.group_exponent();
+    m_hash = SeededHash<T>();
+    m_hash_generation++;
+    this->rebuild(m_array.init_same_size());
+    return true;
+  }
+
+  void rebuild(GroupedOpenAddressingArray<Group> new_array)
+  {
+    /* Values can only be moved out when no copy uses the old groups anymore. */
+    bool old_is_shared = m_array.is_shared();
+    for (Group &old_group : m_array) {
+      for (uint8_t offset : old_group.set_slots()) {
+        if (old_is_shared) {
+          T value = *old_group.value(offset);
+          this->add_after_grow(value, new_array);
+        }
+        else {
+          this->add_after_grow(*old_group.value(offset), new_array);
+        }
+      }
+    }
+
+    m_array = std::move(new_array);
+  }
+
+  /* The caller has to make sure that the table does not have to grow. */
+  bool add__hashed(const T &value, uint32_t initial_hash)
+  {
+    auto &&stats = this->stats_counter();
+    uint32_t probe_length = 0;
+    ITER_SLOTS_BEGIN_HASHED (initial_hash, m_array, , group, offset) {
+      probe_length++;
+      uint8_t status = group.status(offset);
+      if (status == IS_EMPTY) {
+        group.copy_in(offset, value);
+        m_array.update__empty_to_set();
+        stats.count_lookup(probe_length);
+        this->reseed_if_unbalanced(probe_length);
+        return true;
+      }
+      else if (status == IS_SET) {
+        bool found = *group.value(offset) == value;
+        stats.count_key_comparison(found);
+        if (found) {
+          stats.count_lookup(probe_length);
+          return false;
+        }
+      }
+    }
+    ITER_SLOTS_END(offset);
+  }
+
+  void add_many__hashed(const T *values, const uint32_t *hashes, uint32_t amount)
+  {
+    constexpr uint32_t prefetch_distance = 6;
+    uint32_t generation = m_hash_generation;
+    for (uint32_t i = 0; i < amount; i++) {
+      if (i + prefetch_distance < amount) {
+        uint32_t slot = hashes[i + prefetch_distance] & m_array.slot_mask();
+        _mm_prefetch((const char *)&m_array.group(slot >> 2), _MM_HINT_T0);
+      }
+      uint32_t hash = generation == m_hash_generation ? hashes[i] : m_hash(values[i]);
+      this->add__hashed(values[i], hash);
+    }
+  }
+
+  void hash_many(const T *values, uint32_t *r_hashes, uint32_t amount) const
+  {
+    m_hash.hash_many(values, r_hashes, amount);
+  }
+
+  void add_after_grow(T &old_value, GroupedOpenAddressingArray<Group> &new_array)
+  {
+    ITER_SLOTS_BEGIN (old_value, new_array, , group, offset) {
+      if (group.status(offset) == IS_EMPTY) {
+        group.move_in(offset, old_value);
+        return;
+      }
+    }
+    ITER_SLOTS_END(offset);
+  }
+
+  uint32_t count_collisions(const T &value) const
+  {
+    uint32_t collisions = 0;
+    ITER_SLOTS_BEGIN (value, m_array, const, group, offset) {
+      if (group.status(offset) == IS_EMPTY || group.has_value(offset, value)) {
+        return collisions;
+      }
+      collisions++;
+    }
+    ITER_SLOTS_END(offset);
+  }
+
+#undef ITER_SLOTS_BEGIN
+#undef ITER_SLOTS_BEGIN_HASHED
+#undef ITER_SLOTS_END
+};
+
+template<typename KeyT, typename ValueT> class Map : WithStatsCounter {
+ private:
+  static constexpr uint32_t OFFSET_MASK = 3;
+  static constexpr uint8_t IS_EMPTY = 0;
+  static constexpr uint8_t IS_SET = 1;
+  static constexpr uint8_t IS_DUMMY = 2;
+
+  class Group {
+   private:
+    uint8_t m_status[4];
+    alignas(KeyT) char m_keys[4 * sizeof(KeyT)];
+    alignas(ValueT) char m_values[4 * sizeof(ValueT)];
+
+   public:
+    static constexpr uint32_t slots_per_group = 4;
+
+    Group()
+    {
+      m_status[0] = IS_EMPTY;
+      m_status[1] = IS_EMPTY;
+      m_status[2] = IS_EMPTY;
+      m_status[3] = IS_EMPTY;
+    }
+
+    ~Group()
+    {
+      for (uint8_t offset : this->set_slots()) {
+        this->key(offset)->~KeyT();
+        this->value(offset)->~ValueT();
+      }
+    }
+
+    Group(const Group &other)
+    {
+      std::memcpy(m_status, other.m_status, 4);
+      for (uint8_t offset : other.set_slots()) {
+        uninitialized_copy_1(other.key(offset), this->key(offset));
+        uninitialized_copy_1(other.value(offset), this->value(offset));
+      }
+    }
+
+    Group(Group &&other)
+    {
+      std::memcpy(m_status, other.m_status, 4);
+      for (uint8_t offset : other.set_slots()) {
+        uninitialized_move_1(other.key(offset), this->key(offset));
+        uninitialized_move_1(other.value(offset), this->value(offset));
+      }
+    }
+
+    bool has_key(uint32_t offset, const KeyT &key) const
+    {
+      return m_status[offset] == IS_SET && key == *this->key(offset);
+    }
+
+    KeyT *key(uint32_t offset) const
+    {
+      return (KeyT *)(m_keys + offset * sizeof(KeyT));
+    }
+
+    ValueT *value(uint32_t offset) const
+    {
+      return (ValueT *)(m_values + offset * sizeof(ValueT));
+    }
+
+    uint8_t status(uint32_t offset) const
+    {
+      return m_status[offset];
+    }
+
+    MatchMask set_slots() const
+    {
+      return match_status(m_status, IS_SET);
+    }
+
+    void copy_in(uint32_t offset, const KeyT &key, const ValueT &value)
+    {
+      assert(m_status[offset] != IS_SET);
+      m_status[offset] = IS_SET;
+      uninitialized_copy_1(&key, this->key(offset));
+      uninitialized_copy_1(&value, this->value(offset));
+    }
+
+    void move_in(uint32_t offset, KeyT &key, ValueT &value)
+    {
+      assert(m_status[offset] != IS_SET);
+      m_status[offset] = IS_SET;
+      uninitialized_move_1(&key, this->key(offset));
+      uninitialized_move_1(&value, this->value(offset));
+    }
+
+    /* The caller has to construct the value. */
+    void copy_in_key(uint32_t offset, const KeyT &key)
+    {
+      assert(m_status[offset] != IS_SET);
+      m_status[offset] = IS_SET;
+      uninitialized_copy_1(&key, this->key(offset));
+    }
+
+    void set_dummy(uint32_t offset)
+    {
+      assert(m_status[offset] == IS_SET);
+      m_status[offset] = IS_DUMMY;
+      this->key(offset)->~KeyT();
+      this->value(offset)->~ValueT();
+    }
+  };
+
+  static constexpr uint32_t s_max_probe_length = 128;
+  /* Groups per range that erase_if() hands to a thread. */
+  static constexpr uint32_t s_parallel_grain = 1 << 14;
+
+  GroupedOpenAddressingArray<Group> m_array;
+  SeededHash<KeyT> m_hash;
+  uint32_t m_hash_generation = 0;
+  uint8_t m_reseed_group_exponent = 0;
+
+ public:
+  Map() = default;
+
+  // clang-format off
+
+#define ITER_SLOTS_BEGIN(KEY, ARRAY, OPTIONAL_CONST, R_GROUP, R_OFFSET) \
+  ITER_SLOTS_BEGIN_HASHED(m_hash(KEY), ARRAY, OPTIONAL_CONST, R_GROUP, R_OFFSET)
+
+#define ITER_SLOTS_BEGIN_HASHED(HASH, ARRAY, OPTIONAL_CONST, R_GROUP, R_OFFSET) \
+  uint32_t hash = HASH; \
+  uint32_t perturb = hash; \
+  while (true) { \
+    uint32_t group_index = (hash & ARRAY.slot_mask()) >> 2; \
+    uint8_t R_OFFSET = hash & OFFSET_MASK; \
+    uint8_t initial_offset = R_OFFSET; \
+    OPTIONAL_CONST Group &R_GROUP = ARRAY.group(group_index); \
+    do {
+
+#define ITER_SLOTS_END(R_OFFSET) \
+      R_OFFSET = (R_OFFSET + 1) & OFFSET_MASK; \
+    } while (R_OFFSET != initial_offset); \
+    perturb >>= 5; \
+    hash = hash * 5 + 1 + perturb; \
+  } ((void)0)
+
+  // clang-format on
+
+  void add_new(const KeyT &key, const ValueT &value)
+  {
+    assert(!this->contains(key));
+    this->ensure_can_add();
+
+    uint32_t probe_length = 0;
+    ITER_SLOTS_BEGIN (key, m_array, , group, offset) {
+      probe_length++;
+      if (group.status(offset) == IS_EMPTY) {
+        group.copy_in(offset, key, value);
+        m_array.update__empty_to_set();
+        this->reseed_if_unbalanced(probe_length);
+        return;
+      }
+    }
+    ITER_SLOTS_END(offset);
+  }
+
+  /* Only grows when the table would have to grow before min_usable_slots keys are set. */
+  void reserve(uint32_t min_usable_slots)
+  {
+    if (min_usable_slots + m_array.slots_dummy() >= m_array.slots_total() / 2) {
+      this->grow(min_usable_slots);
+    }
+  }
+
+  /* Works like Set::add_many. Existing keys keep their value. */
+  void add_many(const KeyT *keys, const ValueT *values, uint32_t amount)
+  {
+    this->reserve(this->size() + amount);
+    m_array.ensure_not_shared();
+
+    constexpr uint32_t block_size = 256;
+    constexpr uint32_t prefetch_distance = 6;
+    uint32_t hashes[block_size];
+    for (uint32_t start = 0; start < amount; start += block_size) {
+      uint32_t block_amount = std::min(block_size, amount - start);
+      m_hash.hash_many(keys + start, hashes, block_amount);
+      uint32_t generation = m_hash_generation;
+      for (uint32_t i = 0; i < block_amount; i++) {
+        if (i + prefetch_distance < block_amount) {
+          uint32_t slot = hashes[i + prefetch_distance] & m_array.slot_mask();
+          _mm_prefetch((const char *)&m_array.group(slot >> 2), _MM_HINT_T0);
+        }
+        const KeyT &key = keys[start + i];
+        uint32_t hash = generation == m_hash_generation ? hashes[i] : m_hash(key);
+        this->add__hashed(key, values[start + i], hash);
+      }
+    }
+  }
+
+  bool add(const KeyT &key, const ValueT &value)
+  {
+    this->ensure_can_add();
+    return this->add__hashed(key, value, m_hash(key));
+  }
+
+  void remove(const KeyT &key)
+  {
+    assert(this->contains(key));
+    m_array.ensure_not_shared();
+    auto &&stats = this->stats_counter();
+    uint32_t probe_length = 0;
+    ITER_SLOTS_BEGIN (key, m_array, , group, offset) {
+      probe_length++;
+      if (group.has_key(offset, key)) {
+        group.set_dummy(offset);
+        m_array.update__set_to_dummy();
+        stats.count_lookup(probe_length);
+        return;
+      }
+    }
+    ITER_SLOTS_END(offset);
+  }
+
+  bool contains(const KeyT &key) const
+  {
+    auto &&stats = this->stats_counter();
+    uint32_t probe_length = 0;
+    ITER_SLOTS_BEGIN (key, m_array, const, group, offset) {
+      probe_length++;
+      uint8_t status = group.status(offset);
+      if (status == IS_EMPTY) {
+        stats.count_lookup(probe_length);
+        return false;
+      }
+      else if (status == IS_SET) {
+        bool found = *group.key(offset) == key;
+        stats.count_key_comparison(found);
+        if (found) {
+          stats.count_lookup(probe_length);
+          return true;
+        }
+      }
+    }
+    ITER_SLOTS_END(offset);
+  }
+
+  /* Returns nullptr when the key does not exist. The pointer is invalidated by the next add. */
+  const ValueT *lookup(const KeyT &key) const
+  {
+    auto &&stats = this->stats_counter();
+    uint32_t probe_length = 0;
+    ITER_SLOTS_BEGIN (key, m_array, const, group, offset) {
+      probe_length++;
+      uint8_t status = group.status(offset);
+      if (status == IS_EMPTY) {
+        stats.count_lookup(probe_length);
+        return nullptr;
+      }
+      else if (status == IS_SET) {
+        bool found = *group.key(offset) == key;
+        stats.count_key_comparison(found);
+        if (found) {
+          stats.count_lookup(probe_length);
+          return group.value(offset);
+        }
+      }
+    }
+    ITER_SLOTS_END(offset);
+  }
+
+  ValueT *lookup(const KeyT &key)
+  {
+    m_array.ensure_not_shared();
+    const Map *const_this = this;
+    return const_cast<ValueT *>(const_this->lookup(key));
+  }
+
+  ValueT &lookup_or_add(const KeyT &key, const ValueT &default_value)
+  {
+    bool added;
+    return *this->lookup_or_add__impl(
+        key, [&](ValueT *value) { new (value) ValueT(default_value); }, added);
+  }
+
+  /* create_value(ValueT *) has to construct the value in place, modify_value(ValueT *) is only
+   * called when the key existed already. Returns true when the key has been added. */
+  template<typename CreateValueF, typename ModifyValueF>
+  bool add_or_modify(const KeyT &key,
+                     const CreateValueF &create_value,
+                     const ModifyValueF &modify_value)
+  {
+    bool added;
+    ValueT *value = this->lookup_or_add__impl(key, create_value, added);
+    if (!added) {
+      modify_value(value);
+    }
+    return added;
+  }
+
+  uint32_t size() const
+  {
+    return m_array.slots_set();
+  }
+
+  /* Counters are only collected when compiled with HASH_TABLE_STATS. */
+  HashTableStats stats() const
+  {
+    HashTableStats stats = this->stats_counter().snapshot();
+    stats.size = m_array.slots_set();
+    stats.capacity = m_array.slots_total();
+    stats.tombstones = m_array.slots_dummy();
+    return stats;
+  }
+
+  void reset_stats()
+  {
+    this->stats_counter().reset();
+  }
+
+  uint64_t size_in_bytes() const
+  {
+    return sizeof(*this) + m_array.allocated_size_in_bytes();
+  }
+
+  /* Splits the groups into ranges of grain groups that can be given to for_each_in_groups() on
+   * different threads, e.g. by a thread pool. */
+  std::vector<IndexRange> group_ranges(uint32_t grain)
+  {
+    /* Values can be modified in the ranges. */
+    m_array.ensure_not_shared();
+    return split_range(m_array.group_amount(), grain);
+  }
+
+  /* Has to be used with ranges from group_ranges(). */
+  template<typename Fn> void for_each_in_groups(IndexRange range, const Fn &fn)
+  {
+    for (uint32_t i = range.begin; i < range.end; i++) {
+      Group &group = m_array.group(i);
+      for (uint8_t offset : group.set_slots()) {
+        fn(*group.key(offset), *group.value(offset));
+      }
+    }
+  }
+
+  /* fn(key, value) is called from different threads at the same time. */
+  template<typename Fn>
+  void parallel_for_each(const Fn &fn,
+                         uint32_t grain,
+                         uint32_t thread_amount = std::thread::hardware_concurrency())
+  {
+    m_array.ensure_not_shared();
+    parallel_for_grains(
+        m_array.group_amount(), grain, thread_amount, [&](uint32_t begin, uint32_t end) {
+          this->for_each_in_groups({begin, end}, fn);
+        });
+  }
+
+  /* Removes the items for which pred(key, value) is true, see Set::erase_if(). */
+  template<typename Pred>
+  uint32_t erase_if(const Pred &pred,
+                    uint32_t grain = s_parallel_grain,
+                    uint32_t thread_amount = std::thread::hardware_concurrency())
+  {
+    m_array.ensure_not_shared();
+    std::atomic<uint32_t> removed{0};
+    parallel_for_grains(
+        m_array.group_amount(), grain, thread_amount, [&](uint32_t begin, uint32_t end) {
+          uint32_t removed_in_range = 0;
+          for (uint32_t i = begin; i < end; i++) {
+            Group &group = m_array.group(i);
+            for (uint8_t offset : group.set_slots()) {
+              if (pred(*group.key(offset), *group.value(offset))) {
+                group.set_dummy(offset);
+                removed_in_range++;
+              }
+            }
+          }
+          removed.fetch_add(removed_in_range, std::memory_order_relaxed);
+        });
+    m_array.update__set_to_dummy(removed.load());
+    return removed.load();
+  }
+
+  struct Item {
+    const KeyT &key;
+    ValueT &value;
+  };
+
+  class Iterator {
+   private:
+    Map *m_map;
+    uint32_t m_slot;
+    /* The set slots of the current group that come after m_slot. */
+    uint32_t m_later_slots;
+
+   public:
+    Iterator(Map *map, uint32_t slot, uint32_t later_slots = 0)
+        : m_map(map), m_slot(slot), m_later_slots(later_slots)
+    {
+    }
+
+    Iterator &operator++()
+    {
+      if (m_later_slots == 0) {
+        *this = m_map->iterator_from_group((m_slot >> 2) + 1);
+      }
+      else {
+        m_slot = (m_slot & ~OFFSET_MASK) + count_trailing_zeros(m_later_slots);
+        m_later_slots = clear_lowest_bit(m_later_slots);
+      }
+      return *this;
+    }
+
+    Item operator*() const
+    {
+      uint32_t group_index = m_slot >> 2;
+      uint32_t offset = m_slot & OFFSET_MASK;
+      Group &group = m_map->m_array.group(group_index);
+      assert(group.status(offset) == IS_SET);
+      return {*group.key(offset), *group.value(offset)};
+    }
+
+    friend bool operator==(const Iterator &a, const Iterator &b)
+    {
+      assert(a.m_map == b.m_map);
+      return a.m_slot == b.m_slot;
+    }
+
+    friend bool operator!=(const Iterator &a, const Iterator &b)
+    {
+      return !(a == b);
+    }
+  };
+
+  friend Iterator;
+
+  Iterator begin()
+  {
+    /* Values can be modified through the iterator. */
+    m_array.ensure_not_shared();
+    return this->iterator_from_group(0);
+  }
+
+  Iterator end()
+  {
+    return Iterator(this, m_array.slots_total());
+  }
+
+  void print_table() const
+  {
+    std::cout << "Hash Table:\n";
+    std::cout << "  Size: " << m_array.slots_set() << '\n';
+    std::cout << "  Capacity: " << m_array.slots_total() << '\n';
+    uint32_t group_index = 0;
+    for (const Group &group : m_array) {
+      std::cout << "   Group: " << group_index++ << '\n';
+      for (uint32_t offset = 0; offset < 4; offset++) {
+        std::cout << "    " << offset << " \t";
+        uint8_t status = group.status(offset);
+        if (status == IS_EMPTY) {
+          std::cout << "    <empty>\n";
+        }
+        else if (status == IS_SET) {
+          const KeyT &key = *group.key(offset);
+          const ValueT &value = *group.value(offset);
+          uint32_t collisions = this->count_collisions(value);
+          std::cout << "    " << key << " -> " << value << "  \t Collisions: " << collisions
+                    << '\n';
+        }
+        else if (status == IS_DUMMY) {
+          std::cout << "    <dummy>\n";
+        }
+      }
+    }
+  }
+
+ private:
+  uint32_t count_collisions(const KeyT &key) const
+  {
+    uint32_t collisions = 0;
+    ITER_SLOTS_BEGIN (key, m_array, const, group, offset) {
+      if (group.status(offset) == IS_EMPTY || group.has_key(offset, key)) {
+        return collisions;
+      }
+      collisions++;
+    }
+    ITER_SLOTS_END(offset);
+  }
+
+  template<typename CreateValueF>
+  ValueT *lookup_or_add__impl(const KeyT &key, const CreateValueF &create_value, bool &r_added)
+  {
+    this->ensure_can_add();
+
+    auto &&stats = this->stats_counter();
+    uint32_t probe_length = 0;
+    ITER_SLOTS_BEGIN (key, m_array, , group, offset) {
+      probe_length++;
+      uint8_t status = group.status(offset);
+      if (status == IS_EMPTY) {
+        group.copy_in_key(offset, key);
+        create_value(group.value(offset));
+        m_array.update__empty_to_set();
+        stats.count_lookup(probe_length);
+        r_added = true;
+        if (this->reseed_if_unbalanced(probe_length)) {
+          /* The value has moved. */
+          return this->lookup(key);
+        }
+        return group.value(offset);
+      }
+      else if (status == IS_SET) {
+        bool found = *group.key(offset) == key;
+        stats.count_key_comparison(found);
+        if (found) {
+          stats.count_lookup(probe_length);
+          r_added = false;
+          return group.value(offset);
+        }
+      }
+    }
+    ITER_SLOTS_END(offset);
+  }
+
+  /* Starts at the first value in the groups from group_index on. Empty groups are skipped with
+   * one comparison of their status bytes. */
+  Iterator iterator_from_group(uint32_t group_index)
+  {
+    uint32_t group_amount = m_array.slots_total() >> 2;
+    for (; group_index < group_amount; group_index++) {
+      uint32_t set_slots = m_array.group(group_index).set_slots().bits();
+      if (set_slots != 0) {
+        return Iterator(this,
+                        (group_index << 2) + count_trailing_zeros(set_slots),
+                        clear_lowest_bit(set_slots));
+      }
+    }
+    return this->end();
+  }
+
+  /* Also makes sure that the groups are not shared with a copy anymore. */
+  void ensure_can_add()
+  {
+    if (m_array.should_grow()) {
+      this->grow(this->size() + 1);
+    }
+    else {
+      m_array.ensure_not_shared();
+    }
+  }
+
+  void grow(uint32_t min_usable_slots)
+  {
+    auto timer = this->stats_counter().time_grow();
+    this->rebuild(m_array.init_reserved(min_usable_slots));
+  }
+
+  /* Works like Set::reseed_if_unbalanced. */
+  bool reseed_if_unbalanced(uint32_t probe_length)
+  {
+    if (probe_length <= s_max_probe_length ||
+        m_array.group_exponent() == m_reseed_group_exponent) {
+      return false;
+    }
+    auto timer = this->stats_counter().time_grow();
+    m_reseed_group_exponent = m_array.group_exponent();
+    m_hash = SeededHash<KeyT>();
+    m_hash_generation++;
+    this->rebuild(m_array.init_same_size());
+    return true;
+  }
+
+  void rebuild(GroupedOpenAddressingArray<Group> new_array)
+  {
+    bool old_is_shared = m_array.is_shared();
+    for (Group &old_group : m_array) {
+      for (uint8_t offset : old_group.set_slots()) {
+        if (old_is_shared) {
+          KeyT key = *old_group.key(offset);
+          ValueT value = *old_group.value(offset);
+          this->add_after_grow(key, value, new_array);
+        }
+        else {
+          this->add_after_grow(*old_group.key(offset), *old_group.value(offset), new_array);
+        }
+      }
+    }
+    m_array = std::move(new_array);
+  }
+
+  /* The caller has to make sure that the table does not have to grow. */
+  bool add__hashed(const KeyT &key, const ValueT &value, uint32_t initial_hash)
+  {
+    auto &&stats = this->stats_counter();
+    uint32_t probe_length = 0;
+    ITER_SLOTS_BEGIN_HASHED (initial_hash, m_array, , group, offset) {
+      probe_length++;
+      uint8_t status = group.status(offset);
+      if (status == IS_EMPTY) {
+        group.copy_in(offset, key, value);
+        m_array.update__empty_to_set();
+        stats.count_lookup(probe_length);
+        this->reseed_if_unbalanced(probe_length);
+        return true;
+      }
+      else if (status == IS_SET) {
+        bool found = *group.key(offset) == key;
+        stats.count_key_comparison(found);
+        if (found) {
+          stats.count_lookup(probe_length);
+          return false;
+        }
+      }
+    }
+    ITER_SLOTS_END(offset);
+  }
+
+  void add_after_grow(KeyT &key, ValueT &value, GroupedOpenAddressingArray<Group> &new_array)
+  {
+    ITER_SLOTS_BEGIN (key, new_array, , group, offset) {
+      if (group.status(offset) == IS_EMPTY) {
+        group.move_in(offset, key, value);
+        return;
+      }
+    }
+    ITER_SLOTS_END(offset);
+  }
+
+#undef ITER_SLOTS_BEGIN
+#undef ITER_SLOTS_BEGIN_HASHED
+#undef ITER_SLOTS_END
+};
+
+template<typename T> struct PointerKeyInfo {
+  static T *get_empty()
+  {
+    return nullptr;
+  }
+
+  static bool is_empty(T *ptr)
+  {
+    return ptr == nullptr;
+  }
+
+  static bool is_set(T *ptr)
+  {
+    return (uintptr_t)ptr > 1;
+  }
+};
+
+template<typename KeyT, typename ValueT, typename KeyInfo> class KeyInfoMap {
+ private:
+  class Group {
+   private:
+    std::array<KeyT, 4> m_keys;
+    alignas(ValueT) char m_values[4 * sizeof(ValueT)];
+
+   public:
+    Group()
+        : m_keys({KeyInfo::get_empty(),
+                  KeyInfo::get_empty(),
+                  KeyInfo::get_empty(),
+                  KeyInfo::get_empty()})
+    {
+    }
+
+    Group(const Group &other)
+    {
+      for (uint32_t offset = 0; offset < 4; offset++) {
+        KeyT &key = other.key(offset);
+        if (KeyInfo::is_set(key)) {
+          uninitialized_copy_1(other.value(offset), this->value(offset));
+        }
+        uninitialized_copy_1(&key, this->key(offset));
+      }
+    }
+
+    Group(Group &&other)
+    {
+      for (uint32_t offset = 0; offset < 4; offset++) {
+        KeyT &key = other.key(offset);
+        if (KeyInfo::is_set(key)) {
+          uninitialized_move_1(other.value(offset), this->value(offset));
+        }
+        uninitialized_move_1(&key, this->key(offset));
+      }
+    }
+
+    bool is_empty(uint32_t offset) const
+    {
+      return KeyInfo::is_empty(this->key(offset));
+    }
+
+    bool is_set(uint32_t offset)
+    {
+      return KeyInfo::is_set(this->key(offset));
+    }
+
+    bool is_set_key(uint32_t offset, const KeyT &key)
+    {
+      return KeyInfo::is_set(key) && key == this->key(offset);
+    }
+
+    void move_in(uint32_t offset, KeyT &key, ValueT &value)
+    {
+      assert(!this->is_set(offset));
+      this->key(offset) = key;
+      uninitialized_move_1(&value, this->value(offset));
+    }
+
+    KeyT &key(uint32_t offset) const
+    {
+      return *(KeyT *)(m_keys + offset * sizeof(KeyT));
+    }
+
+    ValueT *value(uint32_t offset) const
+    {
+      return (ValueT *)(m_values + offset * sizeof(ValueT));
+    }
+  };
+
+  GroupedOpenAddressingArray<Group> m_array;
+
+ public:
+  KeyInfoMap() = default;
+
+ private:
+};
@@ -0,0 +1,681 @@
+#include "hash_quality.hpp"
+#include "open_addressing.hpp"
+#include "ordered_open_addressing.hpp"
+#include <gtest/gtest.h>
+
+using IntSet = Set<int>;
+using StringSet = Set<std::string>;
+using IntMap = Map<int, int>;
+
+TEST(Set, DefaultConstructor) {
+    IntSet set;
+    EXPECT_EQ(set.size(), 0);
+}
+
+TEST(Set, CopyConstructor) {
+    IntSet set1;
+    set1.add(1);
+    set1.add(2);
+    set1.add(3);
+    IntSet set2 = set1;
+
+    EXPECT_FALSE(set1.contains(4));
+    EXPECT_FALSE(set2.contains(4));
+    set2.add(4);
+    EXPECT_FALSE(set1.contains(4));
+    EXPECT_TRUE(set2.contains(4));
+}
+
+TEST(Set, CopiesAreIndependent) {
+    IntSet set1;
+    for (int i = 0; i < 1000; i++) {
+        set1.add(i);
+    }
+    IntSet set2 = set1;
+    IntSet set3;
+    set3 = set1;
+    set2.remove(5);
+    for (int i = 1000; i < 5000; i++) {
+        set3.add(i);
+    }
+    EXPECT_TRUE(set1.contains(5));
+    EXPECT_FALSE(set2.contains(5));
+    EXPECT_TRUE(set3.contains(5));
+    EXPECT_FALSE(set1.contains(1000));
+    EXPECT_TRUE(set3.contains(4999));
+    EXPECT_EQ(set1.size(), 1000);
+    EXPECT_EQ(set2.size(), 999);
+    EXPECT_EQ(set3.size(), 5000);
+}
+
+TEST(Set, AddNewIncreasesSize) {
+    IntSet set;
+    EXPECT_EQ(set.size(), 0);
+    set.add_new(4);
+    EXPECT_EQ(set.size(), 1);
+    set.add_new(5);
+    EXPECT_EQ(set.size(), 2);
+}
+
+TEST(Set, AddExistingDoesNotIncreaseSize) {
+    IntSet set;
+    EXPECT_TRUE(set.add(1));
+    EXPECT_TRUE(set.add(2));
+    EXPECT_EQ(set.size(), 2);
+    EXPECT_FALSE(set.add(2));
+    EXPECT_EQ(set.size(), 2);
+    EXPECT_FALSE(set.add(1));
+    EXPECT_EQ(set.size(), 2);
+}
+
+TEST(Set, ContainsExisting) {
+    IntSet set;
+    set.add(4);
+    set.add(5);
+    set.add(6);
+    EXPECT_TRUE(set.contains(4));
+    EXPECT_TRUE(set.contains(5));
+    EXPECT_TRUE(set.contains(6));
+    EXPECT_FALSE(set.contains(3));
+    EXPECT_FALSE(set.contains(7));
+}
+
+TEST(Set, RemoveExistingDecreasesSize) {
+    IntSet set;
+    set.add(4);
+    set.add(5);
+    EXPECT_EQ(set.size(), 2);
+    set.remove(5);
+    EXPECT_EQ(set.size(), 1);
+    EXPECT_FALSE(set.contains(5));
+    set.remove(4);
+    EXPECT_EQ(set.size(), 0);
+}
+
+TEST(Set, AddManyTimes) {
+    IntSet set;
+    int N = 1000;
+    for (int i = 0; i < N; i += 4) {
+        set.add(i);
+    }
+    for (int i = 0; i < N; i++) {
+        EXPECT_EQ(set.contains(i), (i % 4) == 0);
+    }
+}
+
+TEST(Set, RemoveManyTimes) {
+    IntSet set;
+    int N = 1000;
+    for (int i = 0; i < N; i++) {
+        set.add(i);
+    }
+    EXPECT_EQ(set.size(), 1000);
+    for (int i = 0; i < N; i += 5) {
+        set.remove(i);
+    }
+    EXPECT_EQ(set.size(), 800);
+    for (int i = 0; i < N; i++) {
+        EXPECT_EQ(set.contains(i), (i % 5) != 0);
+    }
+}
+
+TEST(Set, AddMany) {
+    std::vector<int> values;
+    for (int i = 0; i < 100; i++) {
+        values.push_back(i * 3);
+    }
+    IntSet set;
+    set.add_many(values.data(), values.size());
+    EXPECT_EQ(set.size(), 100);
+    for (int i = 0; i < 300; i++) {
+        EXPECT_EQ(set.contains(i), (i % 3) == 0);
+    }
+}
+
+TEST(Set, AddManyPartitioned) {
+    std::vector<int> values;
+    for (int i = 0; i < 100000; i++) {
+        values.push_back(i * 3);
+    }
+    IntSet set;
+    set.add(1);
+    set.add(3);
+    set.add_many(values.data(), values.size(), true);
+    EXPECT_EQ(set.size(), 100001);
+    for (int i = 0; i < 300000; i++) {
+        EXPECT_EQ(set.contains(i), (i % 3) == 0 || i == 1);
+    }
+}
+
+TEST(Set, AddManySmallBatches) {
+    IntSet set;
+    for (int amount = 0; amount < 10; amount++) {
+        std::vector<int> values;
+        for (int i = 0; i < amount; i++) {
+            values.push_back(amount * 100 + i);
+        }
+        set.add_many(values.data(), values.size());
+        EXPECT_EQ(set.size(), amount * (amount + 1) / 2);
+    }
+    EXPECT_TRUE(set.contains(908));
+    EXPECT_FALSE(set.contains(909));
+}
+
+TEST(Set, Iterator) {
+    IntSet set;
+    for (int i = 0; i < 100; i++) {
+        set.add(i);
+    }
+    set.remove(50);
+    int sum = 0, count = 0;
+    for (int value : set) {
+        sum += value;
+        count++;
+    }
+    EXPECT_EQ(count, 99);
+    EXPECT_EQ(sum, 99 * 100 / 2 - 50);
+}
+
+TEST(Set, IteratorSkipsRemovedValues) {
+    IntSet set;
+    for (int i = 0; i < 1000; i++) {
+        set.add(i);
+    }
+    for (int i = 0; i < 1000; i++) {
+        if (i % 97 != 0) {
+            set.remove(i);
+        }
+    }
+    std::vector<int> values;
+    for (int value : set) {
+        values.push_back(value);
+    }
+    std::sort(values.begin(), values.end());
+    std::vector<int> expected;
+    for (int i = 0; i < 1000; i += 97) {
+        expected.push_back(i);
+    }
+    EXPECT_EQ(values, expected);
+
+    IntSet empty;
+    EXPECT_FALSE(empty.begin() != empty.end());
+}
+
+TEST(Set, Strings) {
+    StringSet set;
+    set.add("Where");
+    set.add("Who");
+    set.add("When");
+    EXPECT_EQ(set.size(), 3);
+    EXPECT_TRUE(set.contains("Who"));
+    EXPECT_FALSE(set.contains("Hello"));
+
+    set.add("Hello");
+    EXPECT_TRUE(set.contains("Hello"));
+
+    set.remove("Who");
+    EXPECT_FALSE(set.contains("Who"));
+}
+
+TEST(Set, PointerKeys) {
+    std::vector<int> objects(100);
+    Set<int *> set;
+    for (int &object : objects) {
+        set.add(&object);
+    }
+    EXPECT_EQ(set.size(), 100);
+    EXPECT_TRUE(set.contains(&objects[42]));
+    int other = 0;
+    EXPECT_FALSE(set.contains(&other));
+}
+
+struct SameHashKey {
+    int value;
+
+    bool operator==(const SameHashKey &other) const {
+        return value == other.value;
+    }
+};
+
+template <> class MyHash<SameHashKey> {
+  public:
+    uint32_t operator()(const SameHashKey &) {
+        return 0;
+    }
+};
+
+TEST(Set, KeysWithSameHash) {
+    /* A new hash function does not help here, the set must
+     * not try it over and over. */
+    Set<SameHashKey> set;
+    for (int i = 0; i < 300; i++) {
+        set.add({i});
+    }
+    EXPECT_EQ(set.size(), 300);
+    for (int i = 0; i < 310; i++) {
+        EXPECT_EQ(set.contains({i}), i < 300);
+    }
+}
+
+TEST(Map, LookupOrAddWithSameHash) {
+    Map<SameHashKey, int> map;
+    for (int i = 0; i < 300; i++) {
+        map.lookup_or_add({i}, 0) = i;
+    }
+    EXPECT_EQ(map.size(), 300);
+    for (int i = 0; i < 300; i++) {
+        EXPECT_EQ(*map.lookup({i}), i);
+    }
+}
+
+/* Single instances can cluster arithmetic progressions, so the
+ * median of a few is checked. */
+template <typename Key>
+static double median_chi_square_z(const std::vector<Key> &keys,
+                                  uint8_t bits) {
+    std::vector<double> values;
+    for (int i = 0; i < 5; i++) {
+        values.push_back(chi_square_z(SeededHash<Key>(), keys, {0, bits}));
+    }
+    std::sort(values.begin(), values.end());
+    return values[2];
+}
+
+TEST(SeededHash, HashManyMatchesScalar) {
+    SeededHash<int> hash;
+    std::vector<int> values;
+    for (int i = -50; i < 50; i++) {
+        values.push_back(i * 12345);
+    }
+    std::vector<uint32_t> hashes(values.size());
+    hash.hash_many(values.data(), hashes.data(), values.size());
+    for (uint32_t i = 0; i < values.size(); i++) {
+        EXPECT_EQ(hashes[i], hash(values[i]));
+    }
+}
+
+TEST(SeededHash, SpreadsStructuredKeys) {
+    /* MyHash alone puts all of these into slot 0. */
+    std::vector<uint32_t> keys = strided_keys(1 << 16, 16);
+    std::vector<std::string> strings = sequential_string_keys(1 << 16);
+    for (uint8_t bits = 4; bits <= 12; bits += 4) {
+        EXPECT_LT(median_chi_square_z(keys, bits), 6);
+        EXPECT_LT(median_chi_square_z(strings, bits), 6);
+    }
+}
+
+TEST(Map, AddAndContains) {
+    IntMap map;
+    EXPECT_TRUE(map.add(1, 10));
+    EXPECT_TRUE(map.add(2, 20));
+    EXPECT_FALSE(map.add(2, 30));
+    EXPECT_EQ(map.size(), 2);
+    EXPECT_TRUE(map.contains(1));
+    EXPECT_FALSE(map.contains(3));
+}
+
+TEST(Map, AddMany) {
+    std::vector<int> keys, values;
+    for (int i = 0; i < 1000; i++) {
+        keys.push_back(i % 700);
+        values.push_back(i);
+    }
+    IntMap map;
+    map.add(5, -1);
+    map.add_many(keys.data(), values.data(), keys.size());
+    EXPECT_EQ(map.size(), 700);
+    EXPECT_EQ(*map.lookup(5), -1);
+    EXPECT_EQ(*map.lookup(6), 6);
+    EXPECT_EQ(*map.lookup(699), 699);
+}
+
+TEST(Map, RemoveManyTimes) {
+    IntMap map;
+    int N = 1000;
+    for (int i = 0; i < N; i++) {
+        map.add_new(i, i * 2);
+    }
+    for (int i = 0; i < N; i += 5) {
+        map.remove(i);
+    }
+    EXPECT_EQ(map.size(), 800);
+    for (int i = 0; i < N; i++) {
+        EXPECT_EQ(map.contains(i), (i % 5) != 0);
+    }
+}
+
+TEST(Map, CopiesAreIndependent) {
+    Map<int, std::string> map1;
+    for (int i = 0; i < 100; i++) {
+        map1.add_new(i, std::to_string(i));
+    }
+    Map<int, std::string> map2 = map1;
+    *map2.lookup(3) = "three";
+    for (auto item : map2) {
+        item.value += "!";
+    }
+    const Map<int, std::string> &const_map1 = map1;
+    EXPECT_EQ(*const_map1.lookup(3), "3");
+    EXPECT_EQ(*map2.lookup(3), "three!");
+    EXPECT_EQ(*map2.lookup(4), "4!");
+}
+
+TEST(Map, Lookup) {
+    IntMap map;
+    map.add(1, 10);
+    map.add(2, 20);
+    EXPECT_EQ(*map.lookup(1), 10);
+    EXPECT_EQ(*map.lookup(2), 20);
+    EXPECT_EQ(map.lookup(3), nullptr);
+    *map.lookup(1) = 15;
+    EXPECT_EQ(*map.lookup(1), 15);
+}
+
+TEST(Map, LookupOrAdd) {
+    IntMap map;
+    int N = 1000;
+    for (int i = 0; i < N; i++) {
+        map.lookup_or_add(i % 100, 0)++;
+    }
+    EXPECT_EQ(map.size(), 100);
+    for (int i = 0; i < 100; i++) {
+        EXPECT_EQ(*map.lookup(i), 10);
+    }
+}
+
+TEST(Map, AddOrModify) {
+    Map<std::string, std::vector<int>> map;
+    auto add = [&](const std::string &key, int value) {
+        return map.add_or_modify(
+            key,
+            [&](std::vector<int> *list) {
+                new (list) std::vector<int>({value});
+            },
+            [&](std::vector<int> *list) {
+                list->push_back(value);
+            });
+    };
+    EXPECT_TRUE(add("a", 1));
+    EXPECT_TRUE(add("b", 2));
+    EXPECT_FALSE(add("a", 3));
+    EXPECT_EQ(map.size(), 2);
+    EXPECT_EQ(*map.lookup("a"), std::vector<int>({1, 3}));
+    EXPECT_EQ(*map.lookup("b"), std::vector<int>({2}));
+}
+
+TEST(Map, Iterator) {
+    IntMap map;
+    for (int i = 0; i < 100; i++) {
+        map.add_new(i, i * 2);
+    }
+    map.remove(50);
+    int key_sum = 0, value_sum = 0, count = 0;
+    for (auto item : map) {
+        EXPECT_EQ(item.value, item.key * 2);
+        item.value++;
+        key_sum += item.key;
+        value_sum += item.value;
+        count++;
+    }
+    EXPECT_EQ(count, 99);
+    EXPECT_EQ(key_sum, 99 * 100 / 2 - 50);
+    EXPECT_EQ(value_sum, 2 * key_sum + 99);
+    EXPECT_EQ(*map.lookup(10), 21);
+}
+
+TEST(Set, ParallelForEach) {
+    IntSet set;
+    for (int i = 0; i < 100000; i++) {
+        set.add(i);
+    }
+    set.remove(7);
+    std::atomic<int64_t> sum{0};
+    set.parallel_for_each([&](int value) { sum += value; }, 64, 4);
+    EXPECT_EQ(sum, (int64_t)99999 * 100000 / 2 - 7);
+
+    int64_t range_sum = 0;
+    for (IndexRange range : set.group_ranges(1000)) {
+        set.for_each_in_groups(range, [&](int value) { range_sum += value; });
+    }
+    EXPECT_EQ(range_sum, sum);
+}
+
+TEST(Set, EraseIf) {
+    IntSet set;
+    for (int i = 0; i < 100000; i++) {
+        set.add(i);
+    }
+    IntSet copy = set;
+    uint32_t removed = set.erase_if([](int value) { return value % 3 != 0; }, 64, 4);
+    EXPECT_EQ(removed, 66666);
+    EXPECT_EQ(set.size(), 33334);
+    EXPECT_EQ(copy.size(), 100000);
+    for (int i = 0; i < 100000; i++) {
+        EXPECT_EQ(set.contains(i), i % 3 == 0);
+        EXPECT_TRUE(copy.contains(i));
+    }
+    /* The dummies are reused. */
+    for (int i = 0; i < 100000; i++) {
+        set.add(i);
+    }
+    EXPECT_EQ(set.size(), 100000);
+}
+
+TEST(Map, ParallelForEachAndEraseIf) {
+    IntMap map;
+    for (int i = 0; i < 100000; i++) {
+        map.add_new(i, i);
+    }
+    map.parallel_for_each([](int key, int &value) { value = key * 2; }, 64, 4);
+    uint32_t removed = map.erase_if([](int key, int) { return key >= 1000; }, 64, 4);
+    EXPECT_EQ(removed, 99000);
+    EXPECT_EQ(map.size(), 1000);
+    int count = 0;
+    for (IndexRange range : map.group_ranges(1000)) {
+        map.for_each_in_groups(range, [&](int key, int value) {
+            EXPECT_EQ(value, key * 2);
+            EXPECT_LT(key, 1000);
+            count++;
+        });
+    }
+    EXPECT_EQ(count, 1000);
+}
+
+TEST(OrderedSet, AddManyTimes) {
+    /* Crosses all three slot widths. */
+    OrderedSet<int> set;
+    for (int i = 0; i < 200000; i += 2) {
+        EXPECT_TRUE(set.add(i));
+    }
+    EXPECT_FALSE(set.add(0));
+    EXPECT_EQ(set.size(), 100000);
+    for (int i = 0; i < 200000; i++) {
+        EXPECT_EQ(set.contains(i), i % 2 == 0);
+    }
+}
+
+TEST(OrderedSet, RemoveManyTimes) {
+    OrderedSet<std::string> set;
+    for (int i = 0; i < 1000; i++) {
+        set.add_new(std::to_string(i));
+    }
+    for (int i = 0; i < 1000; i += 3) {
+        set.remove(std::to_string(i));
+    }
+    for (int i = 1000; i < 2000; i++) {
+        set.add(std::to_string(i));
+    }
+    EXPECT_EQ(set.size(), 1666);
+    for (int i = 0; i < 2000; i++) {
+        EXPECT_EQ(set.contains(std::to_string(i)), i >= 1000 || i % 3 != 0);
+    }
+}
+
+TEST(OrderedSet, IteratesInInsertionOrder) {
+    OrderedSet<int> set;
+    std::vector<int> expected;
+    for (int i = 0; i < 1000; i++) {
+        int value = (i * 7919) % 1000;
+        set.add_new(value);
+        expected.push_back(value);
+    }
+    set.remove(expected[10]);
+    set.remove(expected[500]);
+    /* Added again, so it moves to the end. */
+    set.add(expected[10]);
+    expected.push_back(expected[10]);
+    expected.erase(expected.begin() + 500);
+    expected.erase(expected.begin() + 10);
+
+    std::vector<int> values;
+    for (int value : set) {
+        values.push_back(value);
+    }
+    EXPECT_EQ(values, expected);
+
+    /* Rebuilding the table keeps the order. */
+    for (int i = 1000; i < 5000; i++) {
+        set.add_new(i);
+        expected.push_back(i);
+    }
+    values.clear();
+    for (int value : set) {
+        values.push_back(value);
+    }
+    EXPECT_EQ(values, expected);
+
+    OrderedSet<int> empty;
+    EXPECT_FALSE(empty.begin() != empty.end());
+}
+
+TEST(OrderedSet, CopiesAreIndependent) {
+    OrderedSet<int> set1;
+    for (int i = 0; i < 1000; i++) {
+        set1.add(i);
+    }
+    OrderedSet<int> set2 = set1;
+    set2.remove(5);
+    set2.add(2000);
+    EXPECT_TRUE(set1.contains(5));
+    EXPECT_FALSE(set1.contains(2000));
+    EXPECT_FALSE(set2.contains(5));
+    EXPECT_TRUE(set2.contains(2000));
+}
+
+TEST(OrderedSet, SmallerThanSet) {
+    /* Set has room for a value in every slot, but at most half
+     * of the slots are used. */
+    StringSet set;
+    OrderedSet<std::string> ordered_set;
+    for (int i = 0; i < 1000; i++) {
+        set.add(std::to_string(i));
+        ordered_set.add(std::to_string(i));
+    }
+    EXPECT_LT(ordered_set.size_in_bytes(), set.size_in_bytes());
+}
+
+TEST(OrderedSet, KeysWithSameHash) {
+    OrderedSet<SameHashKey> set;
+    for (int i = 0; i < 300; i++) {
+        set.add({i});
+    }
+    EXPECT_EQ(set.size(), 300);
+    for (int i = 0; i < 310; i++) {
+        EXPECT_EQ(set.contains({i}), i < 300);
+    }
+}
+
+TEST(OrderedMap, IteratesInInsertionOrder) {
+    OrderedMap<std::string, int> map;
+    std::vector<std::string> keys = {"c", "a", "d", "b", "e"};
+    for (uint32_t i = 0; i < keys.size(); i++) {
+        map.add_new(keys[i], i);
+    }
+    map.remove("d");
+    std::vector<std::string> found_keys;
+    for (auto item : map) {
+        EXPECT_EQ(keys[item.value], item.key);
+        item.value *= 10;
+        found_keys.push_back(item.key);
+    }
+    EXPECT_EQ(found_keys, std::vector<std::string>({"c", "a", "b", "e"}));
+    EXPECT_EQ(*map.lookup("b"), 30);
+    EXPECT_EQ(map.lookup("d"), nullptr);
+}
+
+TEST(OrderedMap, LookupOrAdd) {
+    OrderedMap<int, int> map;
+    for (int i = 0; i < 10000; i++) {
+        map.lookup_or_add(i % 100, 0)++;
+    }
+    EXPECT_EQ(map.size(), 100);
+    for (int i = 0; i < 100; i++) {
+        EXPECT_EQ(*map.lookup(i), 100);
+    }
+}
+
+TEST(OrderedMap, AddOrModify) {
+    OrderedMap<std::string, std::vector<int>> map;
+    auto add = [&](const std::string &key, int value) {
+        return map.add_or_modify(
+            key,
+            [&](std::vector<int> *list) {
+                new (list) std::vector<int>({value});
+            },
+            [&](std::vector<int> *list) {
+                list->push_back(value);
+            });
+    };
+    EXPECT_TRUE(add("a", 1));
+    EXPECT_TRUE(add("b", 2));
+    EXPECT_FALSE(add("a", 3));
+    EXPECT_FALSE(map.add("b", {4}));
+    EXPECT_EQ(map.size(), 2);
+    EXPECT_EQ(*map.lookup("a"), std::vector<int>({1, 3}));
+    EXPECT_EQ(*map.lookup("b"), std::vector<int>({2}));
+}
+
+TEST(OrderedMap, RemoveManyTimes) {
+    OrderedMap<int, int> map;
+    for (int i = 0; i < 100000; i++) {
+        map.add_new(i, i * 2);
+    }
+    for (int i = 0; i < 100000; i++) {
+        if (i % 10 != 0) {
+            map.remove(i);
+        }
+    }
+    EXPECT_EQ(map.size(), 10000);
+    for (int i = 0; i < 100000; i++) {
+        const int *value = map.lookup(i);
+        if (i % 10 == 0) {
+            EXPECT_EQ(*value, i * 2);
+        }
+        else {
+            EXPECT_EQ(value, nullptr);
+        }
+    }
+}
+
+#if HASH_TABLE_STATS
+TEST(Set, StatsCountTombstones) {
+    IntSet set;
+    for (int i = 0; i < 100; i++) {
+        set.add(i);
+    }
+    for (int i = 0; i < 10; i++) {
+        set.remove(i);
+    }
+    HashTableStats stats = set.stats();
+    EXPECT_TRUE(stats.enabled);
+    EXPECT_EQ(stats.size, 90);
+    EXPECT_EQ(stats.tombstones, 10);
+    EXPECT_GT(stats.grows, 0);
+    EXPECT_GE(stats.max_probe_length, 1);
+}
+#endif
+
+int main(int argc, char **argv) {
+    testing::InitGoogleTest(&argc, argv);
+    return RUN_ALL_TESTS();
+}
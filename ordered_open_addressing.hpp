@@ -0,0 +1,836 @@
+#pragma once
+
+#include <cassert>
+#include <cstdlib>
+#include <cstring>
+#include <new>
+#include <utility>
+#include <vector>
+#include <stdint.h>
+#include "open_addressing.hpp"
+#include "stats.hpp"
+
+/* Insertion ordered variants of Set and Map, laid out like the compact dict of CPython. The
+ * values are appended to a dense entries array, the probe table only stores the position of an
+ * entry. Probing is the same as in Set, see open_addressing.hpp, but over single slots of the
+ * index table, four of which are one group.
+ *
+ * Iteration walks the entries array, so it is in insertion order and does not have to look at
+ * empty slots. Removed entries stay in the array as holes until the next rebuild of the table,
+ * iteration skips them. */
+
+/* Every slot holds the position of an entry, or EMPTY or DUMMY. The slots are 1, 2 or 4 bytes
+ * wide, depending on the size of the table. Because at most half of the slots are used, the
+ * largest position is always below the two special values of the slot width. */
+class OrderedIndexTable {
+ private:
+  void *m_slots;
+  uint32_t m_slot_mask;
+  uint8_t m_slot_exponent;
+  uint8_t m_slot_size;
+
+ public:
+  static constexpr uint32_t EMPTY = UINT32_MAX;
+  static constexpr uint32_t DUMMY = UINT32_MAX - 1;
+
+  explicit OrderedIndexTable(uint8_t slot_exponent = 3)
+  {
+    uint32_t slots_total = 1 << slot_exponent;
+    m_slot_exponent = slot_exponent;
+    m_slot_mask = slots_total - 1;
+    m_slot_size = slots_total <= (1 << 8) ? 1 : slots_total <= (1 << 16) ? 2 : 4;
+    m_slots = malloc(this->size_in_bytes());
+    /* All bits set is EMPTY in every width. */
+    std::memset(m_slots, 0xFF, this->size_in_bytes());
+  }
+
+  ~OrderedIndexTable()
+  {
+    free(m_slots);
+  }
+
+  OrderedIndexTable(const OrderedIndexTable &other)
+  {
+    m_slot_mask = other.m_slot_mask;
+    m_slot_exponent = other.m_slot_exponent;
+    m_slot_size = other.m_slot_size;
+    m_slots = malloc(this->size_in_bytes());
+    std::memcpy(m_slots, other.m_slots, this->size_in_bytes());
+  }
+
+  OrderedIndexTable(OrderedIndexTable &&other)
+  {
+    m_slot_mask = other.m_slot_mask;
+    m_slot_exponent = other.m_slot_exponent;
+    m_slot_size = other.m_slot_size;
+    m_slots = other.m_slots;
+    new (&other) OrderedIndexTable();
+  }
+
+  OrderedIndexTable &operator=(const OrderedIndexTable &other)
+  {
+    if (this == &other) {
+      return *this;
+    }
+    this->~OrderedIndexTable();
+    new (this) OrderedIndexTable(other);
+    return *this;
+  }
+
+  OrderedIndexTable &operator=(OrderedIndexTable &&other)
+  {
+    if (this == &other) {
+      return *this;
+    }
+    this->~OrderedIndexTable();
+    new (this) OrderedIndexTable(std::move(other));
+    return *this;
+  }
+
+  /* Same sizing as GroupedOpenAddressingArray::init_reserved. */
+  static uint8_t slot_exponent_for(uint32_t min_usable_slots)
+  {
+    return ceillog2(min_usable_slots / 4 + 1) + 3;
+  }
+
+  uint32_t get(uint32_t slot) const
+  {
+    switch (m_slot_size) {
+      case 1: {
+        uint32_t index = ((const uint8_t *)m_slots)[slot];
+        return index >= 0xFE ? index | 0xFFFFFF00 : index;
+      }
+      case 2: {
+        uint32_t index = ((const uint16_t *)m_slots)[slot];
+        return index >= 0xFFFE ? index | 0xFFFF0000 : index;
+      }
+      default:
+        return ((const uint32_t *)m_slots)[slot];
+    }
+  }
+
+  /* EMPTY and DUMMY are truncated to the special values of the slot width. */
+  void set(uint32_t slot, uint32_t index)
+  {
+    switch (m_slot_size) {
+      case 1:
+        ((uint8_t *)m_slots)[slot] = (uint8_t)index;
+        break;
+      case 2:
+        ((uint16_t *)m_slots)[slot] = (uint16_t)index;
+        break;
+      default:
+        ((uint32_t *)m_slots)[slot] = index;
+        break;
+    }
+  }
+
+  uint32_t slot_mask() const
+  {
+    return m_slot_mask;
+  }
+
+  uint8_t slot_exponent() const
+  {
+    return m_slot_exponent;
+  }
+
+  uint32_t slots_total() const
+  {
+    return m_slot_mask + 1;
+  }
+
+  /* Every entry uses one slot, removed ones as DUMMY. */
+  uint32_t usable_slots() const
+  {
+    return this->slots_total() / 2;
+  }
+
+  uint8_t slot_size() const
+  {
+    return m_slot_size;
+  }
+
+  uint64_t size_in_bytes() const
+  {
+    return (uint64_t)this->slots_total() * m_slot_size;
+  }
+};
+
+template<typename T> class OrderedSet : WithStatsCounter {
+ private:
+  static constexpr uint32_t OFFSET_MASK = 3;
+  /* See Set::s_max_probe_length. */
+  static constexpr uint32_t s_max_probe_length = 128;
+
+  struct Entry {
+    uint32_t hash;
+    T value;
+  };
+
+  OrderedIndexTable m_table;
+  std::vector<Entry> m_entries;
+  std::vector<bool> m_removed;
+  uint32_t m_removed_amount = 0;
+  SeededHash<T> m_hash;
+  uint8_t m_reseed_slot_exponent = 0;
+
+ public:
+  OrderedSet() = default;
+
+  // clang-format off
+
+#define ITER_SLOTS_BEGIN(HASH, TABLE, R_SLOT) \
+  uint32_t hash = HASH; \
+  uint32_t perturb = hash; \
+  while (true) { \
+    uint32_t group_start = hash & TABLE.slot_mask() & ~OFFSET_MASK; \
+    uint8_t offset = hash & OFFSET_MASK; \
+    uint8_t initial_offset = offset; \
+    do { \
+      uint32_t R_SLOT = group_start + offset;
+
+#define ITER_SLOTS_END \
+      offset = (offset + 1) & OFFSET_MASK; \
+    } while (offset != initial_offset); \
+    perturb >>= 5; \
+    hash = hash * 5 + 1 + perturb; \
+  } ((void)0)
+
+  // clang-format on
+
+  /* Only rebuilds when the table would have to grow before min_usable_slots values are added. */
+  void reserve(uint32_t min_usable_slots)
+  {
+    if (min_usable_slots + m_removed_amount > m_table.usable_slots()) {
+      this->rebuild(min_usable_slots);
+    }
+    m_entries.reserve(min_usable_slots + m_removed_amount);
+  }
+
+  void add_new(const T &value)
+  {
+    assert(!this->contains(value));
+    this->ensure_can_add();
+
+    uint32_t initial_hash = m_hash(value);
+    uint32_t probe_length = 0;
+    ITER_SLOTS_BEGIN (initial_hash, m_table, slot) {
+      probe_length++;
+      if (m_table.get(slot) == OrderedIndexTable::EMPTY) {
+        this->append(slot, initial_hash, value);
+        this->reseed_if_unbalanced(probe_length);
+        return;
+      }
+    }
+    ITER_SLOTS_END;
+  }
+
+  bool add(const T &value)
+  {
+    this->ensure_can_add();
+
+    auto &&stats = this->stats_counter();
+    uint32_t initial_hash = m_hash(value);
+    uint32_t probe_length = 0;
+    ITER_SLOTS_BEGIN (initial_hash, m_table, slot) {
+      probe_length++;
+      uint32_t index = m_table.get(slot);
+      if (index == OrderedIndexTable::EMPTY) {
+        this->append(slot, initial_hash, value);
+        stats.count_lookup(probe_length);
+        this->reseed_if_unbalanced(probe_length);
+        return true;
+      }
+      else if (index != OrderedIndexTable::DUMMY && m_entries[index].hash == initial_hash) {
+        bool found = m_entries[index].value == value;
+        stats.count_key_comparison(found);
+        if (found) {
+          stats.count_lookup(probe_length);
+          return false;
+        }
+      }
+    }
+    ITER_SLOTS_END;
+  }
+
+  bool contains(const T &value) const
+  {
+    return this->find_slot(value) != OrderedIndexTable::EMPTY;
+  }
+
+  /* The entry stays in the entries array until the table is rebuilt. */
+  void remove(const T &value)
+  {
+    assert(this->contains(value));
+    uint32_t slot = this->find_slot(value);
+    uint32_t index = m_table.get(slot);
+    m_table.set(slot, OrderedIndexTable::DUMMY);
+    m_removed[index] = true;
+    m_removed_amount++;
+  }
+
+  uint32_t size() const
+  {
+    return m_entries.size() - m_removed_amount;
+  }
+
+  /* Counters are only collected when compiled with HASH_TABLE_STATS. */
+  HashTableStats stats() const
+  {
+    HashTableStats stats = this->stats_counter().snapshot();
+    stats.size = this->size();
+    stats.capacity = m_table.slots_total();
+    stats.tombstones = m_removed_amount;
+    return stats;
+  }
+
+  void reset_stats()
+  {
+    this->stats_counter().reset();
+  }
+
+  uint64_t size_in_bytes() const
+  {
+    return sizeof(*this) + m_table.size_in_bytes() +
+           (uint64_t)m_entries.capacity() * sizeof(Entry) + m_removed.capacity() / 8;
+  }
+
+  class Iterator {
+   private:
+    const OrderedSet *m_set;
+    uint32_t m_index;
+
+   public:
+    Iterator(const OrderedSet *set, uint32_t index) : m_set(set), m_index(index)
+    {
+      this->skip_removed();
+    }
+
+    Iterator &operator++()
+    {
+      m_index++;
+      this->skip_removed();
+      return *this;
+    }
+
+    const T &operator*() const
+    {
+      return m_set->m_entries[m_index].value;
+    }
+
+    friend bool operator==(const Iterator &a, const Iterator &b)
+    {
+      assert(a.m_set == b.m_set);
+      return a.m_index == b.m_index;
+    }
+
+    friend bool operator!=(const Iterator &a, const Iterator &b)
+    {
+      return !(a == b);
+    }
+
+   private:
+    void skip_removed()
+    {
+      while (m_index < m_set->m_entries.size() && m_set->m_removed[m_index]) {
+        m_index++;
+      }
+    }
+  };
+
+  friend Iterator;
+
+  /* Iterates in insertion order. */
+  Iterator begin() const
+  {
+    return Iterator(this, 0);
+  }
+
+  Iterator end() const
+  {
+    return Iterator(this, m_entries.size());
+  }
+
+ private:
+  /* Returns EMPTY when the value does not exist. */
+  uint32_t find_slot(const T &value) const
+  {
+    auto &&stats = this->stats_counter();
+    uint32_t initial_hash = m_hash(value);
+    uint32_t probe_length = 0;
+    ITER_SLOTS_BEGIN (initial_hash, m_table, slot) {
+      probe_length++;
+      uint32_t index = m_table.get(slot);
+      if (index == OrderedIndexTable::EMPTY) {
+        stats.count_lookup(probe_length);
+        return OrderedIndexTable::EMPTY;
+      }
+      else if (index != OrderedIndexTable::DUMMY && m_entries[index].hash == initial_hash) {
+        bool found = m_entries[index].value == value;
+        stats.count_key_comparison(found);
+        if (found) {
+          stats.count_lookup(probe_length);
+          return slot;
+        }
+      }
+    }
+    ITER_SLOTS_END;
+  }
+
+  void append(uint32_t slot, uint32_t hash, const T &value)
+  {
+    m_table.set(slot, m_entries.size());
+    m_entries.push_back({hash, value});
+    m_removed.push_back(false);
+  }
+
+  void ensure_can_add()
+  {
+    if (m_entries.size() >= m_table.usable_slots()) {
+      this->rebuild(this->size() + 1);
+    }
+  }
+
+  /* Drops the removed entries and builds a new table from the stored hashes. The table only
+   * grows when there are not enough removed entries to make room. */
+  void rebuild(uint32_t min_usable_slots)
+  {
+    auto timer = this->stats_counter().time_grow();
+    this->remove_holes();
+    m_table = OrderedIndexTable(OrderedIndexTable::slot_exponent_for(min_usable_slots));
+    /* The entries do not move until the next rebuild. */
+    m_entries.reserve(m_table.usable_slots());
+    this->fill_table();
+  }
+
+  /* Works like Set::reseed_if_unbalanced. */
+  bool reseed_if_unbalanced(uint32_t probe_length)
+  {
+    if (probe_length <= s_max_probe_length ||
+        m_table.slot_exponent() == m_reseed_slot_exponent) {
+      return false;
+    }
+    auto timer = this->stats_counter().time_grow();
+    m_reseed_slot_exponent = m_table.slot_exponent();
+    m_hash = SeededHash<T>();
+    this->remove_holes();
+    for (Entry &entry : m_entries) {
+      entry.hash = m_hash(entry.value);
+    }
+    m_table = OrderedIndexTable(m_table.slot_exponent());
+    this->fill_table();
+    return true;
+  }
+
+  void remove_holes()
+  {
+    if (m_removed_amount == 0) {
+      return;
+    }
+    uint32_t new_amount = 0;
+    for (uint32_t i = 0; i < m_entries.size(); i++) {
+      if (m_removed[i]) {
+        continue;
+      }
+      if (i != new_amount) {
+        m_entries[new_amount] = std::move(m_entries[i]);
+      }
+      new_amount++;
+    }
+    m_entries.erase(m_entries.begin() + new_amount, m_entries.end());
+    m_removed.assign(new_amount, false);
+    m_removed_amount = 0;
+  }
+
+  /* Expects an empty table and no removed entries. */
+  void fill_table()
+  {
+    for (uint32_t i = 0; i < m_entries.size(); i++) {
+      this->add_index_after_rebuild(i, m_entries[i].hash);
+    }
+  }
+
+  void add_index_after_rebuild(uint32_t index, uint32_t initial_hash)
+  {
+    ITER_SLOTS_BEGIN (initial_hash, m_table, slot) {
+      if (m_table.get(slot) == OrderedIndexTable::EMPTY) {
+        m_table.set(slot, index);
+        return;
+      }
+    }
+    ITER_SLOTS_END;
+  }
+
+#undef ITER_SLOTS_BEGIN
+#undef ITER_SLOTS_END
+};
+
+template<typename KeyT, typename ValueT> class OrderedMap : WithStatsCounter {
+ private:
+  static constexpr uint32_t OFFSET_MASK = 3;
+  static constexpr uint32_t s_max_probe_length = 128;
+
+  struct Entry {
+    uint32_t hash;
+    KeyT key;
+    ValueT value;
+  };
+
+  OrderedIndexTable m_table;
+  std::vector<Entry> m_entries;
+  std::vector<bool> m_removed;
+  uint32_t m_removed_amount = 0;
+  SeededHash<KeyT> m_hash;
+  uint8_t m_reseed_slot_exponent = 0;
+
+ public:
+  OrderedMap() = default;
+
+  // clang-format off
+
+#define ITER_SLOTS_BEGIN(HASH, TABLE, R_SLOT) \
+  uint32_t hash = HASH; \
+  uint32_t perturb = hash; \
+  while (true) { \
+    uint32_t group_start = hash & TABLE.slot_mask() & ~OFFSET_MASK; \
+    uint8_t offset = hash & OFFSET_MASK; \
+    uint8_t initial_offset = offset; \
+    do { \
+      uint32_t R_SLOT = group_start + offset;
+
+#define ITER_SLOTS_END \
+      offset = (offset + 1) & OFFSET_MASK; \
+    } while (offset != initial_offset); \
+    perturb >>= 5; \
+    hash = hash * 5 + 1 + perturb; \
+  } ((void)0)
+
+  // clang-format on
+
+  /* Only rebuilds when the table would have to grow before min_usable_slots keys are added. */
+  void reserve(uint32_t min_usable_slots)
+  {
+    if (min_usable_slots + m_removed_amount > m_table.usable_slots()) {
+      this->rebuild(min_usable_slots);
+    }
+    m_entries.reserve(min_usable_slots + m_removed_amount);
+  }
+
+  void add_new(const KeyT &key, const ValueT &value)
+  {
+    assert(!this->contains(key));
+    this->ensure_can_add();
+
+    uint32_t initial_hash = m_hash(key);
+    uint32_t probe_length = 0;
+    ITER_SLOTS_BEGIN (initial_hash, m_table, slot) {
+      probe_length++;
+      if (m_table.get(slot) == OrderedIndexTable::EMPTY) {
+        this->append(slot, {initial_hash, key, value});
+        this->reseed_if_unbalanced(probe_length);
+        return;
+      }
+    }
+    ITER_SLOTS_END;
+  }
+
+  /* Existing keys keep their value. */
+  bool add(const KeyT &key, const ValueT &value)
+  {
+    bool added;
+    this->lookup_or_add__impl(
+        key, [&](ValueT *new_value) { new (new_value) ValueT(value); }, added);
+    return added;
+  }
+
+  /* The entry stays in the entries array until the table is rebuilt. */
+  void remove(const KeyT &key)
+  {
+    assert(this->contains(key));
+    uint32_t slot = this->find_slot(key);
+    uint32_t index = m_table.get(slot);
+    m_table.set(slot, OrderedIndexTable::DUMMY);
+    m_removed[index] = true;
+    m_removed_amount++;
+  }
+
+  bool contains(const KeyT &key) const
+  {
+    return this->find_slot(key) != OrderedIndexTable::EMPTY;
+  }
+
+  /* Returns nullptr when the key does not exist. The pointer is invalidated by the next add. */
+  const ValueT *lookup(const KeyT &key) const
+  {
+    uint32_t slot = this->find_slot(key);
+    if (slot == OrderedIndexTable::EMPTY) {
+      return nullptr;
+    }
+    return &m_entries[m_table.get(slot)].value;
+  }
+
+  ValueT *lookup(const KeyT &key)
+  {
+    const OrderedMap *const_this = this;
+    return const_cast<ValueT *>(const_this->lookup(key));
+  }
+
+  ValueT &lookup_or_add(const KeyT &key, const ValueT &default_value)
+  {
+    bool added;
+    return *this->lookup_or_add__impl(
+        key, [&](ValueT *value) { new (value) ValueT(default_value); }, added);
+  }
+
+  /* Works like Map::add_or_modify. */
+  template<typename CreateValueF, typename ModifyValueF>
+  bool add_or_modify(const KeyT &key,
+                     const CreateValueF &create_value,
+                     const ModifyValueF &modify_value)
+  {
+    bool added;
+    ValueT *value = this->lookup_or_add__impl(key, create_value, added);
+    if (!added) {
+      modify_value(value);
+    }
+    return added;
+  }
+
+  uint32_t size() const
+  {
+    return m_entries.size() - m_removed_amount;
+  }
+
+  /* Counters are only collected when compiled with HASH_TABLE_STATS. */
+  HashTableStats stats() const
+  {
+    HashTableStats stats = this->stats_counter().snapshot();
+    stats.size = this->size();
+    stats.capacity = m_table.slots_total();
+    stats.tombstones = m_removed_amount;
+    return stats;
+  }
+
+  void reset_stats()
+  {
+    this->stats_counter().reset();
+  }
+
+  uint64_t size_in_bytes() const
+  {
+    return sizeof(*this) + m_table.size_in_bytes() +
+           (uint64_t)m_entries.capacity() * sizeof(Entry) + m_removed.capacity() / 8;
+  }
+
+  struct Item {
+    const KeyT &key;
+    ValueT &value;
+  };
+
+  class Iterator {
+   private:
+    OrderedMap *m_map;
+    uint32_t m_index;
+
+   public:
+    Iterator(OrderedMap *map, uint32_t index) : m_map(map), m_index(index)
+    {
+      this->skip_removed();
+    }
+
+    Iterator &operator++()
+    {
+      m_index++;
+      this->skip_removed();
+      return *this;
+    }
+
+    Item operator*() const
+    {
+      Entry &entry = m_map->m_entries[m_index];
+      return {entry.key, entry.value};
+    }
+
+    friend bool operator==(const Iterator &a, const Iterator &b)
+    {
+      assert(a.m_map == b.m_map);
+      return a.m_index == b.m_index;
+    }
+
+    friend bool operator!=(const Iterator &a, const Iterator &b)
+    {
+      return !(a == b);
+    }
+
+   private:
+    void skip_removed()
+    {
+      while (m_index < m_map->m_entries.size() && m_map->m_removed[m_index]) {
+        m_index++;
+      }
+    }
+  };
+
+  friend Iterator;
+
+  /* Iterates in insertion order. Values can be modified through the iterator. */
+  Iterator begin()
+  {
+    return Iterator(this, 0);
+  }
+
+  Iterator end()
+  {
+    return Iterator(this, m_entries.size());
+  }
+
+ private:
+  /* Returns EMPTY when the key does not exist. */
+  uint32_t find_slot(const KeyT &key) const
+  {
+    auto &&stats = this->stats_counter();
+    uint32_t initial_hash = m_hash(key);
+    uint32_t probe_length = 0;
+    ITER_SLOTS_BEGIN (initial_hash, m_table, slot) {
+      probe_length++;
+      uint32_t index = m_table.get(slot);
+      if (index == OrderedIndexTable::EMPTY) {
+        stats.count_lookup(probe_length);
+        return OrderedIndexTable::EMPTY;
+      }
+      else if (index != OrderedIndexTable::DUMMY && m_entries[index].hash == initial_hash) {
+        bool found = m_entries[index].key == key;
+        stats.count_key_comparison(found);
+        if (found) {
+          stats.count_lookup(probe_length);
+          return slot;
+        }
+      }
+    }
+    ITER_SLOTS_END;
+  }
+
+  template<typename CreateValueF>
+  ValueT *lookup_or_add__impl(const KeyT &key, const CreateValueF &create_value, bool &r_added)
+  {
+    this->ensure_can_add();
+
+    auto &&stats = this->stats_counter();
+    uint32_t initial_hash = m_hash(key);
+    uint32_t probe_length = 0;
+    ITER_SLOTS_BEGIN (initial_hash, m_table, slot) {
+      probe_length++;
+      uint32_t index = m_table.get(slot);
+      if (index == OrderedIndexTable::EMPTY) {
+        /* The entries array may reallocate, so the value is created outside of it first. */
+        alignas(ValueT) char buffer[sizeof(ValueT)];
+        ValueT *new_value = (ValueT *)buffer;
+        create_value(new_value);
+        this->append(slot, {initial_hash, key, std::move(*new_value)});
+        new_value->~ValueT();
+        stats.count_lookup(probe_length);
+        r_added = true;
+        this->reseed_if_unbalanced(probe_length);
+        return &m_entries.back().value;
+      }
+      else if (index != OrderedIndexTable::DUMMY && m_entries[index].hash == initial_hash) {
+        bool found = m_entries[index].key == key;
+        stats.count_key_comparison(found);
+        if (found) {
+          stats.count_lookup(probe_length);
+          r_added = false;
+          return &m_entries[index].value;
+        }
+      }
+    }
+    ITER_SLOTS_END;
+  }
+
+  void append(uint32_t slot, Entry &&entry)
+  {
+    m_table.set(slot, m_entries.size());
+    m_entries.push_back(std::move(entry));
+    m_removed.push_back(false);
+  }
+
+  void ensure_can_add()
+  {
+    if (m_entries.size() >= m_table.usable_slots()) {
+      this->rebuild(this->size() + 1);
+    }
+  }
+
+  /* Works like OrderedSet::rebuild. */
+  void rebuild(uint32_t min_usable_slots)
+  {
+    auto timer = this->stats_counter().time_grow();
+    this->remove_holes();
+    m_table = OrderedIndexTable(OrderedIndexTable::slot_exponent_for(min_usable_slots));
+    /* The entries do not move until the next rebuild. */
+    m_entries.reserve(m_table.usable_slots());
+    this->fill_table();
+  }
+
+  /* Works like Set::reseed_if_unbalanced. Reseeding does not change the order of the entries
+   * that are not removed, so the newest entry stays at the back. */
+  bool reseed_if_unbalanced(uint32_t probe_length)
+  {
+    if (probe_length <= s_max_probe_length ||
+        m_table.slot_exponent() == m_reseed_slot_exponent) {
+      return false;
+    }
+    auto timer = this->stats_counter().time_grow();
+    m_reseed_slot_exponent = m_table.slot_exponent();
+    m_hash = SeededHash<KeyT>();
+    this->remove_holes();
+    for (Entry &entry : m_entries) {
+      entry.hash = m_hash(entry.key);
+    }
+    m_table = OrderedIndexTable(m_table.slot_exponent());
+    this->fill_table();
+    return true;
+  }
+
+  void remove_holes()
+  {
+    if (m_removed_amount == 0) {
+      return;
+    }
+    uint32_t new_amount = 0;
+    for (uint32_t i = 0; i < m_entries.size(); i++) {
+      if (m_removed[i]) {
+        continue;
+      }
+      if (i != new_amount) {
+        m_entries[new_amount] = std::move(m_entries[i]);
+      }
+      new_amount++;
+    }
+    m_entries.erase(m_entries.begin() + new_amount, m_entries.end());
+    m_removed.assign(new_amount, false);
+    m_removed_amount = 0;
+  }
+
+  /* Expects an empty table and no removed entries. */
+  void fill_table()
+  {
+    for (uint32_t i = 0; i < m_entries.size(); i++) {
+      this->add_index_after_rebuild(i, m_entries[i].hash);
+    }
+  }
+
+  void add_index_after_rebuild(uint32_t index, uint32_t initial_hash)
+  {
+    ITER_SLOTS_BEGIN (initial_hash, m_table, slot) {
+      if (m_table.get(slot) == OrderedIndexTable::EMPTY) {
+        m_table.set(slot, index);
+        return;
+      }
+    }
+    ITER_SLOTS_END;
+  }
+
+#undef ITER_SLOTS_BEGIN
+#undef ITER_SLOTS_END
+};
@@ -0,0 +1,713 @@
+#pragma once
+
+#include "hash_set.hpp"
+#include <atomic>
+#include <stdint.h>
+#include <type_traits>
+
+/* Immutable hash set. Inserting or removing returns a new
+ * version that shares everything except the path to the
+ * changed leaf with the old version.
+ *
+ * The structure is a hash array mapped trie. Every inner
+ * node uses the next 5 hash bits to select one of its 32
+ * slots. The leaves are the same groups that HashSet uses,
+ * so a lookup still ends with comparing 16 hash bytes at
+ * once.
+ *
+ * Like in extendible hashing, a leaf can be referenced by
+ * multiple neighbouring slots. A full leaf is split in two
+ * based on the next hash bit, the same way HashSet::grow
+ * splits group i into i and i + n. Only when a leaf is
+ * referenced by a single slot, a new inner node is created
+ * below it. This keeps the leaves reasonably full. Leaves
+ * on the lowest level cannot be split anymore and are
+ * chained instead.
+ *
+ * A Transient can be used to do many updates without
+ * copying the path every time. Nodes that a transient
+ * created itself are modified in place until persistent()
+ * is called. */
+template <typename T, typename HashFunc>
+class PersistentHashSet {
+  private:
+    using GroupType = typename std::conditional<
+        sizeof(T) == 4, Group<T, HashFunc, 12>,
+        Group<T, HashFunc, 6>>::type;
+
+    static const uint32_t s_bits_per_level = 5;
+    static const uint32_t s_slots_per_inner = 32;
+    static const uint32_t s_max_depth = 4;
+    /* The levels use the lower 25 bits. */
+    static const uint32_t s_hash_byte_shift = 23;
+
+    struct Node {
+        std::atomic<uint32_t> users;
+        /* Transient or operation that is allowed to change
+         * this node in place. */
+        uint32_t owner;
+        bool is_leaf;
+
+        Node(uint32_t owner, bool is_leaf)
+            : users(1), owner(owner), is_leaf(is_leaf) {}
+    };
+
+    struct Leaf : Node {
+        /* The leaf is referenced by all slots whose lowest
+         * local_bits bits are the same. */
+        uint8_t local_bits;
+        /* Only used on the lowest level. */
+        Leaf *next = nullptr;
+        /* The hash byte comparison needs 16 byte alignment. */
+        alignas(16) GroupType group;
+
+        Leaf(uint32_t owner, uint8_t local_bits)
+            : Node(owner, true), local_bits(local_bits) {}
+
+        Leaf(const Leaf &other, uint32_t owner)
+            : Node(owner, true), local_bits(other.local_bits),
+              next((Leaf *)retain(other.next)),
+              group(const_cast<GroupType &>(other.group)) {}
+    };
+
+    struct Inner : Node {
+        Node *children[s_slots_per_inner];
+
+        Inner(uint32_t owner) : Node(owner, false) {}
+    };
+
+    Node *m_root;
+    uint32_t m_size;
+    HashFunc m_hash_fn;
+
+    PersistentHashSet(Node *root, uint32_t size,
+                      HashFunc hash_fn)
+        : m_root(root), m_size(size), m_hash_fn(hash_fn) {}
+
+  public:
+    PersistentHashSet()
+        : m_root(nullptr), m_size(0),
+          m_hash_fn(HashFunc::get_new()) {}
+
+    ~PersistentHashSet() {
+        release(m_root);
+    }
+
+    PersistentHashSet(const PersistentHashSet &other)
+        : m_root(retain(other.m_root)), m_size(other.m_size),
+          m_hash_fn(other.m_hash_fn) {}
+
+    PersistentHashSet(PersistentHashSet &&other)
+        : m_root(other.m_root), m_size(other.m_size),
+          m_hash_fn(other.m_hash_fn) {
+        other.m_root = nullptr;
+        other.m_size = 0;
+    }
+
+    PersistentHashSet &operator=(const PersistentHashSet &other) {
+        if (this == &other) {
+            return *this;
+        }
+        Node *root = retain(other.m_root);
+        release(m_root);
+        m_root = root;
+        m_size = other.m_size;
+        m_hash_fn = other.m_hash_fn;
+        return *this;
+    }
+
+    PersistentHashSet &operator=(PersistentHashSet &&other) {
+        if (this == &other) {
+            return *this;
+        }
+        release(m_root);
+        m_root = other.m_root;
+        m_size = other.m_size;
+        m_hash_fn = other.m_hash_fn;
+        other.m_root = nullptr;
+        other.m_size = 0;
+        return *this;
+    }
+
+    uint32_t size() const {
+        return m_size;
+    }
+
+    bool contains(const T &value) const {
+        return contains_in_node(m_root, value,
+                                m_hash_fn(value));
+    }
+
+    PersistentHashSet insert(const T &value) const {
+        bool added;
+        Node *root = insert_in_root(m_root, value, m_hash_fn,
+                                    new_owner(), added);
+        if (!added) {
+            return *this;
+        }
+        return PersistentHashSet(root, m_size + 1, m_hash_fn);
+    }
+
+    PersistentHashSet remove(const T &value) const {
+        bool removed;
+        Node *root = remove_from_root(m_root, value,
+                                      m_hash_fn(value),
+                                      new_owner(), removed);
+        if (!removed) {
+            return *this;
+        }
+        return PersistentHashSet(root, m_size - 1, m_hash_fn);
+    }
+
+    /* Memory used by all nodes of this version, including
+     * the ones shared with other versions. */
+    uint64_t size_in_bytes() const {
+        return sizeof(PersistentHashSet) +
+               node_size_in_bytes(m_root);
+    }
+
+    /*************** Iterator *******************/
+
+    class Iterator {
+      private:
+        Inner *m_inners[s_max_depth + 1];
+        uint8_t m_slots[s_max_depth + 1];
+        uint32_t m_depth = 0;
+        Leaf *m_leaf = nullptr;
+        uint8_t m_position = 0;
+
+      public:
+        Iterator(Node *root) {
+            if (root != nullptr) {
+                this->descend(root);
+                this->skip_empty_leaves();
+            }
+        }
+
+        Iterator &operator++() {
+            m_position++;
+            this->skip_empty_leaves();
+            return *this;
+        }
+
+        bool operator!=(const Iterator &it) const {
+            return m_leaf != it.m_leaf ||
+                   m_position != it.m_position;
+        }
+
+        const T &operator*() const {
+            return m_leaf->group.element_at(m_position);
+        }
+
+      private:
+        void descend(Node *node) {
+            while (!node->is_leaf) {
+                Inner *inner = (Inner *)node;
+                m_inners[m_depth] = inner;
+                m_slots[m_depth] = 0;
+                m_depth++;
+                node = inner->children[0];
+            }
+            m_leaf = (Leaf *)node;
+            m_position = 0;
+        }
+
+        void skip_empty_leaves() {
+            while (m_position >= m_leaf->group.size()) {
+                if (m_leaf->next != nullptr) {
+                    m_leaf = m_leaf->next;
+                    m_position = 0;
+                    continue;
+                }
+                if (!this->next_leaf()) {
+                    m_leaf = nullptr;
+                    m_position = 0;
+                    return;
+                }
+            }
+        }
+
+        /* Leaves that are referenced by multiple slots are
+         * only visited from the first one. */
+        bool next_leaf() {
+            while (m_depth > 0) {
+                Inner *inner = m_inners[m_depth - 1];
+                uint8_t &slot = m_slots[m_depth - 1];
+                for (slot++; slot < s_slots_per_inner; slot++) {
+                    Node *child = inner->children[slot];
+                    if (!child->is_leaf ||
+                        slot < (1u << ((Leaf *)child)->local_bits)) {
+                        this->descend(child);
+                        return true;
+                    }
+                }
+                m_depth--;
+            }
+            return false;
+        }
+    };
+
+    Iterator begin() const {
+        return Iterator(m_root);
+    }
+
+    Iterator end() const {
+        return Iterator(nullptr);
+    }
+
+    /*************** Transient *******************/
+
+    class Transient {
+      private:
+        Node *m_root;
+        uint32_t m_size;
+        uint32_t m_owner;
+        HashFunc m_hash_fn;
+
+      public:
+        Transient(const PersistentHashSet &set)
+            : m_root(retain(set.m_root)), m_size(set.m_size),
+              m_owner(new_owner()), m_hash_fn(set.m_hash_fn) {}
+
+        ~Transient() {
+            release(m_root);
+        }
+
+        Transient(const Transient &other) = delete;
+        Transient &operator=(const Transient &other) = delete;
+
+        uint32_t size() const {
+            return m_size;
+        }
+
+        bool contains(const T &value) const {
+            return contains_in_node(m_root, value,
+                                    m_hash_fn(value));
+        }
+
+        bool insert(const T &value) {
+            bool added;
+            Node *root = insert_in_root(m_root, value, m_hash_fn,
+                                        m_owner, added);
+            this->replace_root(root);
+            m_size += added;
+            return added;
+        }
+
+        bool remove(const T &value) {
+            bool removed;
+            Node *root =
+                remove_from_root(m_root, value, m_hash_fn(value),
+                                 m_owner, removed);
+            this->replace_root(root);
+            m_size -= removed;
+            return removed;
+        }
+
+        /* Nodes created so far become immutable. The transient
+         * can still be used afterwards. */
+        PersistentHashSet persistent() {
+            m_owner = new_owner();
+            return PersistentHashSet(retain(m_root), m_size,
+                                     m_hash_fn);
+        }
+
+      private:
+        void replace_root(Node *root) {
+            if (root != m_root) {
+                release(m_root);
+                m_root = root;
+            }
+        }
+    };
+
+    Transient transient() const {
+        return Transient(*this);
+    }
+
+  private:
+    /* Persistent operations use a new owner every time, so
+     * that their nodes are immutable once they are done. */
+    static uint32_t new_owner() {
+        static std::atomic<uint32_t> last_owner{0};
+        return last_owner.fetch_add(1, std::memory_order_relaxed) +
+               1;
+    }
+
+    static inline uint8_t to_hash_byte(uint32_t hash) {
+        return hash >> s_hash_byte_shift;
+    }
+
+    static inline uint32_t slot_index(uint32_t hash,
+                                      uint32_t depth) {
+        return (hash >> (depth * s_bits_per_level)) &
+               (s_slots_per_inner - 1);
+    }
+
+    static Node *retain(Node *node) {
+        if (node != nullptr) {
+            node->users.fetch_add(1, std::memory_order_relaxed);
+        }
+        return node;
+    }
+
+    static void release(Node *node) {
+        if (node == nullptr) {
+            return;
+        }
+        if (node->users.fetch_sub(1, std::memory_order_acq_rel) !=
+            1) {
+            return;
+        }
+        if (node->is_leaf) {
+            Leaf *leaf = (Leaf *)node;
+            release(leaf->next);
+            delete leaf;
+        }
+        else {
+            Inner *inner = (Inner *)node;
+            for (Node *child : inner->children) {
+                release(child);
+            }
+            delete inner;
+        }
+    }
+
+    /* Returns the node itself when the owner is allowed to
+     * change it, otherwise a copy. */
+    static Leaf *editable_leaf(Leaf *leaf, uint32_t owner) {
+        if (leaf->owner == owner) {
+            return leaf;
+        }
+        return new Leaf(*leaf, owner);
+    }
+
+    static Inner *editable_inner(Inner *inner, uint32_t owner) {
+        if (inner->owner == owner) {
+            return inner;
+        }
+        Inner *copy = new Inner(owner);
+        for (uint32_t i = 0; i < s_slots_per_inner; i++) {
+            copy->children[i] = retain(inner->children[i]);
+        }
+        return copy;
+    }
+
+    static void replace_child(Node *&slot, Node *new_child) {
+        if (slot != new_child) {
+            release(slot);
+            slot = new_child;
+        }
+    }
+
+    static void replace_next(Leaf *leaf, Leaf *new_next) {
+        if (leaf->next != new_next) {
+            release(leaf->next);
+            leaf->next = new_next;
+        }
+    }
+
+    /* Makes all slots that referenced the leaf at the given
+     * slot reference new_leaf instead. The reference the
+     * caller had to new_leaf is moved into the inner node. */
+    static void replace_leaf(Inner *inner, uint32_t slot,
+                             Leaf *old_leaf, Leaf *new_leaf) {
+        uint32_t step = 1 << old_leaf->local_bits;
+        for (uint32_t i = slot & (step - 1);
+             i < s_slots_per_inner; i += step) {
+            release(inner->children[i]);
+            inner->children[i] = retain(new_leaf);
+        }
+        release(new_leaf);
+    }
+
+    static Leaf *new_leaf_with(const T &value, uint32_t hash,
+                               uint8_t local_bits,
+                               uint32_t owner) {
+        Leaf *leaf = new Leaf(owner, local_bits);
+        T copy = value;
+        leaf->group.try_insert_new(copy, to_hash_byte(hash));
+        return leaf;
+    }
+
+    static bool contains_in_node(Node *node, const T &value,
+                                 uint32_t hash) {
+        if (node == nullptr) {
+            return false;
+        }
+        uint32_t depth = 0;
+        while (!node->is_leaf) {
+            node = ((Inner *)node)
+                       ->children[slot_index(hash, depth)];
+            depth++;
+        }
+        return chain_contains((Leaf *)node, value, hash);
+    }
+
+    static bool chain_contains(Leaf *leaf, const T &value,
+                               uint32_t hash) {
+        DisabledStatsCounter stats;
+        uint8_t hash_byte = to_hash_byte(hash);
+        for (; leaf != nullptr; leaf = leaf->next) {
+            if (leaf->group.contains(value, hash_byte, stats)) {
+                return true;
+            }
+        }
+        return false;
+    }
+
+    /* All insert and remove functions return the node that
+     * should be stored in the parent from now on. When that
+     * is not the given node, the caller owns one reference to
+     * it and has to release the old node. */
+    static Node *insert_in_root(Node *root, const T &value,
+                                const HashFunc &hash_fn,
+                                uint32_t owner, bool &r_added) {
+        uint32_t hash = hash_fn(value);
+        if (root == nullptr) {
+            r_added = true;
+            return new_leaf_with(value, hash, 0, owner);
+        }
+        if (!root->is_leaf) {
+            return insert_in_inner((Inner *)root, 0, value, hash,
+                                   hash_fn, owner, r_added);
+        }
+
+        Leaf *leaf = (Leaf *)root;
+        if (chain_contains(leaf, value, hash)) {
+            r_added = false;
+            return root;
+        }
+        r_added = true;
+        if (leaf->group.size() < GroupType::s_max_size) {
+            return insert_new_in_chain(leaf, value, hash, owner);
+        }
+        /* The root leaf is full, put it below a new inner node
+         * that references it from every slot. */
+        Inner *inner = new Inner(owner);
+        for (Node *&child : inner->children) {
+            child = retain(leaf);
+        }
+        Node *result = insert_in_inner(inner, 0, value, hash,
+                                       hash_fn, owner, r_added);
+        return result;
+    }
+
+    static Node *insert_in_inner(Inner *inner, uint32_t depth,
+                                 const T &value, uint32_t hash,
+                                 const HashFunc &hash_fn,
+                                 uint32_t owner, bool &r_added) {
+        uint32_t slot = slot_index(hash, depth);
+        Node *child = inner->children[slot];
+
+        if (!child->is_leaf) {
+            Node *new_child =
+                insert_in_inner((Inner *)child, depth + 1, value,
+                                hash, hash_fn, owner, r_added);
+            if (new_child == child) {
+                return inner;
+            }
+            Inner *edited = editable_inner(inner, owner);
+            replace_child(edited->children[slot], new_child);
+            return edited;
+        }
+
+        Leaf *leaf = (Leaf *)child;
+        if (chain_contains(leaf, value, hash)) {
+            r_added = false;
+            return inner;
+        }
+        r_added = true;
+
+        if (leaf->group.size() < GroupType::s_max_size ||
+            (depth == s_max_depth &&
+             leaf->local_bits == s_bits_per_level)) {
+            Leaf *new_leaf =
+                insert_new_in_chain(leaf, value, hash, owner);
+            if (new_leaf == leaf) {
+                return inner;
+            }
+            Inner *edited = editable_inner(inner, owner);
+            replace_leaf(edited, slot, leaf, new_leaf);
+            return edited;
+        }
+
+        Inner *edited = editable_inner(inner, owner);
+        if (leaf->local_bits < s_bits_per_level) {
+            split_leaf(edited, slot, depth, leaf, hash_fn, owner);
+        }
+        else {
+            Inner *below =
+                new_inner_below(leaf, depth + 1, hash_fn, owner);
+            replace_child(edited->children[slot], below);
+        }
+        /* The value might still belong into a full leaf. */
+        bool added;
+        Node *result = insert_in_inner(edited, depth, value, hash,
+                                       hash_fn, owner, added);
+        return result;
+    }
+
+    /* Distributes the values of the leaf into two new leaves
+     * based on the next hash bit. */
+    static void split_leaf(Inner *inner, uint32_t slot,
+                           uint32_t depth, Leaf *leaf,
+                           const HashFunc &hash_fn,
+                           uint32_t owner) {
+        uint8_t bit = leaf->local_bits;
+        uint32_t decision_mask =
+            1 << (depth * s_bits_per_level + bit);
+        Leaf *new_leaves[2] = {new Leaf(owner, bit + 1),
+                               new Leaf(owner, bit + 1)};
+        for (uint8_t i = 0; i < leaf->group.size(); i++) {
+            T value = leaf->group.element_at(i);
+            uint32_t hash = hash_fn(value);
+            new_leaves[(hash & decision_mask) != 0]
+                ->group.try_insert_new(value, to_hash_byte(hash));
+        }
+
+        retain(leaf);
+        uint32_t step = 1 << bit;
+        for (uint32_t i = slot & (step - 1);
+             i < s_slots_per_inner; i += step) {
+            release(inner->children[i]);
+            inner->children[i] =
+                retain(new_leaves[(i & step) != 0]);
+        }
+        release(leaf);
+        release(new_leaves[0]);
+        release(new_leaves[1]);
+    }
+
+    /* Creates an inner node with two leaves that contain the
+     * values of the given leaf, which was referenced by a
+     * single slot. */
+    static Inner *new_inner_below(Leaf *leaf, uint32_t depth,
+                                  const HashFunc &hash_fn,
+                                  uint32_t owner) {
+        Inner *inner = new Inner(owner);
+        Leaf *copy = new Leaf(*leaf, owner);
+        copy->local_bits = 0;
+        for (Node *&child : inner->children) {
+            child = retain(copy);
+        }
+        split_leaf(inner, 0, depth, copy, hash_fn, owner);
+        release(copy);
+        return inner;
+    }
+
+    static Leaf *insert_new_in_chain(Leaf *leaf, const T &value,
+                                     uint32_t hash,
+                                     uint32_t owner) {
+        if (leaf->group.size() < GroupType::s_max_size) {
+            Leaf *edited = editable_leaf(leaf, owner);
+            T copy = value;
+            edited->group.try_insert_new(copy, to_hash_byte(hash));
+            return edited;
+        }
+        Leaf *next =
+            leaf->next
+                ? insert_new_in_chain(leaf->next, value, hash,
+                                      owner)
+                : new_leaf_with(value, hash, leaf->local_bits,
+                                owner);
+        Leaf *edited = editable_leaf(leaf, owner);
+        replace_next(edited, next);
+        return edited;
+    }
+
+    static Node *remove_from_root(Node *root, const T &value,
+                                  uint32_t hash, uint32_t owner,
+                                  bool &r_removed) {
+        if (root == nullptr) {
+            r_removed = false;
+            return nullptr;
+        }
+        if (root->is_leaf) {
+            return remove_from_chain((Leaf *)root, value, hash,
+                                     owner, r_removed);
+        }
+        return remove_from_inner((Inner *)root, 0, value, hash,
+                                 owner, r_removed);
+    }
+
+    /* Emptied leaves stay in place, inner nodes are never
+     * merged back into leaves. */
+    static Node *remove_from_inner(Inner *inner, uint32_t depth,
+                                   const T &value, uint32_t hash,
+                                   uint32_t owner,
+                                   bool &r_removed) {
+        uint32_t slot = slot_index(hash, depth);
+        Node *child = inner->children[slot];
+        if (!child->is_leaf) {
+            Node *new_child =
+                remove_from_inner((Inner *)child, depth + 1,
+                                  value, hash, owner, r_removed);
+            if (new_child == child) {
+                return inner;
+            }
+            Inner *edited = editable_inner(inner, owner);
+            replace_child(edited->children[slot], new_child);
+            return edited;
+        }
+
+        Leaf *leaf = (Leaf *)child;
+        Leaf *new_leaf =
+            remove_from_chain(leaf, value, hash, owner, r_removed);
+        if (new_leaf == leaf) {
+            return inner;
+        }
+        Inner *edited = editable_inner(inner, owner);
+        replace_leaf(edited, slot, leaf, new_leaf);
+        return edited;
+    }
+
+    static Leaf *remove_from_chain(Leaf *leaf, const T &value,
+                                   uint32_t hash, uint32_t owner,
+                                   bool &r_removed) {
+        DisabledStatsCounter stats;
+        uint8_t hash_byte = to_hash_byte(hash);
+        if (!leaf->group.contains(value, hash_byte, stats)) {
+            if (leaf->next == nullptr) {
+                r_removed = false;
+                return leaf;
+            }
+            Leaf *next = remove_from_chain(leaf->next, value, hash,
+                                           owner, r_removed);
+            if (next == leaf->next) {
+                return leaf;
+            }
+            Leaf *edited = editable_leaf(leaf, owner);
+            replace_next(edited, next);
+            return edited;
+        }
+
+        r_removed = true;
+        if (leaf->group.size() == 1 && leaf->next != nullptr) {
+            return (Leaf *)retain(leaf->next);
+        }
+        Leaf *edited = editable_leaf(leaf, owner);
+        edited->group.remove(value, hash_byte, stats);
+        return edited;
+    }
+
+    static uint64_t node_size_in_bytes(Node *node) {
+        if (node == nullptr) {
+            return 0;
+        }
+        if (node->is_leaf) {
+            Leaf *leaf = (Leaf *)node;
+            return sizeof(Leaf) + node_size_in_bytes(leaf->next);
+        }
+        Inner *inner = (Inner *)node;
+        uint64_t size = sizeof(Inner);
+        for (uint32_t i = 0; i < s_slots_per_inner; i++) {
+            Node *child = inner->children[i];
+            if (!child->is_leaf ||
+                i < (1u << ((Leaf *)child)->local_bits)) {
+                size += node_size_in_bytes(child);
+            }
+        }
+        return size;
+    }
+};
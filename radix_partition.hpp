@@ -0,0 +1,89 @@
+#pragma once
+
+#include <algorithm>
+#include <stdint.h>
+#include <utility>
+
+/* Buckets with at most this many elements are not
+ * partitioned further. With 4 byte values and their keys
+ * they fit into the L1 cache, so the order inside of them
+ * does not matter to the callers. */
+constexpr uint32_t radix_partition_min_length = 1024;
+
+/* Reorders data and keys in place, so that they are sorted
+ * by the bits [shift, shift + bits) of the keys, up to
+ * buckets of min_length elements.
+ *
+ * This is an American flag sort. A pass computes the
+ * histogram of the highest 8 bit digit that is left and
+ * then moves every element directly into its bucket with
+ * swaps. Afterwards every bucket is partitioned by the
+ * next digit, so that the later passes work on memory
+ * that is in the cache already. With 256
+ * buckets per pass the write positions stay in the L1
+ * cache, which is what write-combining buffers would
+ * otherwise be needed for.
+ *
+ * Nothing is allocated and elements are only swapped, so
+ * this works for all movable types. */
+template <typename T>
+void radix_partition(T *data, uint32_t *keys, uint32_t length,
+                     uint8_t shift, uint8_t bits,
+                     uint32_t min_length =
+                         radix_partition_min_length) {
+    if (bits == 0 || length <= min_length) {
+        return;
+    }
+
+    uint8_t digit_bits = std::min<uint8_t>(bits, 8);
+    uint8_t digit_shift = shift + bits - digit_bits;
+    uint32_t mask = (1 << digit_bits) - 1;
+    uint32_t bucket_amount = 1 << digit_bits;
+
+    uint32_t counts[256] = {0};
+    for (uint32_t i = 0; i < length; i++) {
+        counts[(keys[i] >> digit_shift) & mask]++;
+    }
+
+    uint32_t heads[256];
+    uint32_t ends[256];
+    uint32_t offset = 0;
+    for (uint32_t bucket = 0; bucket < bucket_amount; bucket++) {
+        heads[bucket] = offset;
+        offset += counts[bucket];
+        ends[bucket] = offset;
+    }
+
+    /* Every step swaps the element at index into the next
+     * free slot of its bucket, which places it finally. The
+     * steps do not depend on each other, unlike when cycles
+     * are followed, so the loads of many steps overlap. The
+     * elements that have been swapped in are handled in
+     * further rounds. */
+    bool unfinished = true;
+    while (unfinished) {
+        unfinished = false;
+        for (uint32_t bucket = 0; bucket < bucket_amount;
+             bucket++) {
+            uint32_t end = ends[bucket];
+            for (uint32_t index = heads[bucket]; index < end;
+                 index++) {
+                uint32_t target =
+                    (keys[index] >> digit_shift) & mask;
+                uint32_t dst = heads[target]++;
+                if (dst != index) {
+                    std::swap(data[index], data[dst]);
+                    std::swap(keys[index], keys[dst]);
+                }
+            }
+            unfinished |= heads[bucket] < end;
+        }
+    }
+
+    uint32_t start = 0;
+    for (uint32_t bucket = 0; bucket < bucket_amount; bucket++) {
+        radix_partition(data + start, keys + start, counts[bucket],
+                        shift, bits - digit_bits, min_length);
+        start += counts[bucket];
+    }
+}
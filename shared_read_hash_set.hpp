@@ -0,0 +1,489 @@
+#pragma once
+
+#include "group_growth.hpp"
+#include "hashing.hpp"
+#include "utils.hpp"
+#include <atomic>
+#include <stdint.h>
+#include <stdlib.h>
+#include <thread>
+#include <type_traits>
+#include <vector>
+
+#include <emmintrin.h>
+
+/* Variant of HashSet for one writer thread and many reader
+ * threads. Readers never lock and never wait for the writer.
+ *
+ * A group has seven slots. Its hash bytes and the used mask
+ * share one 64 bit word, so that a reader gets a consistent
+ * view of the group with a single acquire load. The writer
+ * stores the value into a free slot first and then publishes
+ * the slot with a release store of that word. Removing only
+ * clears the bit, values never move inside a group. A reader
+ * that still has the old word might compare against a value
+ * that is written into a reused slot just now, but since the
+ * slots are atomic it sees either the old or the new value
+ * and never a mix of both.
+ *
+ * Growing and reseeding never touch the published groups.
+ * The writer builds a new table and swaps it in with an
+ * atomic pointer. The old table is retired and freed once
+ * every reader that might still use it has left its read
+ * section (epoch based grace period). Every Reader owns a
+ * slot in which it announces the epoch it entered with.
+ *
+ * Values have to be word sized and trivially copyable,
+ * because every slot is a std::atomic<T>. */
+template <typename T, typename HashFunc>
+class SharedReadHashSet {
+  private:
+    static const uint8_t s_group_size = 7;
+
+    static_assert(std::is_trivially_copyable<T>::value &&
+                      std::atomic<T>::is_always_lock_free,
+                  "values have to be word sized");
+
+    struct alignas(64) Group {
+        /* Bytes 0 to 6 are the hash bytes, the highest byte
+         * is the used mask. */
+        std::atomic<uint64_t> meta{0};
+        std::atomic<T> values[s_group_size];
+
+        static MatchMask match(uint64_t meta,
+                               uint8_t hash_byte) {
+            __m128i bytes = _mm_cvtsi64_si128(meta);
+            __m128i equal =
+                _mm_cmpeq_epi8(bytes, _mm_set1_epi8(hash_byte));
+            return MatchMask(_mm_movemask_epi8(equal) &
+                             used_mask(meta));
+        }
+
+        static uint8_t used_mask(uint64_t meta) {
+            return meta >> 56;
+        }
+    };
+
+    /* Everything a reader needs, so that one pointer load
+     * gives a consistent view even across a reseed. */
+    struct Table {
+        Group *groups;
+        uint32_t mask;
+        uint8_t size_exp;
+        uint8_t hash_byte_shift;
+        HashFunc hash_fn;
+        uint64_t retired_epoch = 0;
+
+        Table(uint8_t size_exp, uint8_t hash_byte_shift,
+              const HashFunc &hash_fn)
+            : mask((1 << size_exp) - 1), size_exp(size_exp),
+              hash_byte_shift(hash_byte_shift),
+              hash_fn(hash_fn) {
+            uint32_t length = this->group_amount();
+            groups = allocate_cache_lines<Group>(length);
+            for (uint32_t i = 0; i < length; i++) {
+                new (groups + i) Group();
+            }
+        }
+
+        ~Table() {
+            std::free(groups);
+        }
+
+        Table(const Table &other) = delete;
+        Table &operator=(const Table &other) = delete;
+
+        uint32_t group_amount() const {
+            return mask + 1;
+        }
+
+        uint8_t to_hash_byte(uint32_t hash) const {
+            return hash >> hash_byte_shift;
+        }
+    };
+
+    /* Epoch zero means that the reader is not reading right
+     * now. Slots are never freed before the set, a destructed
+     * Reader only gives its slot back. */
+    struct alignas(64) ReaderSlot {
+        std::atomic<uint64_t> epoch{0};
+        std::atomic<bool> taken{true};
+        ReaderSlot *next = nullptr;
+    };
+
+    std::atomic<Table *> m_table;
+    std::atomic<uint64_t> m_epoch{1};
+    mutable std::atomic<ReaderSlot *> m_reader_slots{nullptr};
+
+    /* Only used by the writer. Kept on another cache line,
+     * so that inserting does not invalidate the line that
+     * every reader loads. */
+    alignas(64) uint32_t m_total_elements = 0;
+    uint8_t m_reseed_size_exp = 0;
+    std::vector<Table *> m_retired;
+
+  public:
+    /* A reader is used by one thread at a time. All readers
+     * have to be destructed before the set. */
+    class Reader {
+      private:
+        const SharedReadHashSet *m_set;
+        ReaderSlot *m_slot;
+
+      public:
+        explicit Reader(const SharedReadHashSet &set)
+            : m_set(&set), m_slot(set.acquire_reader_slot()) {}
+
+        ~Reader() {
+            if (m_slot != nullptr) {
+                m_slot->taken.store(false,
+                                    std::memory_order_release);
+            }
+        }
+
+        Reader(const Reader &other) = delete;
+        Reader &operator=(const Reader &other) = delete;
+
+        Reader(Reader &&other)
+            : m_set(other.m_set), m_slot(other.m_slot) {
+            other.m_slot = nullptr;
+        }
+
+        bool contains(const T &value) const {
+            const Table *table = this->enter();
+            bool found = SharedReadHashSet::lookup(table, value);
+            this->leave();
+            return found;
+        }
+
+        /* Same as calling contains() for every value, but the
+         * read section is only entered once. */
+        uint32_t count_contained(const T *values,
+                                 uint32_t amount) const {
+            const Table *table = this->enter();
+            uint32_t found_amount = 0;
+            for (uint32_t i = 0; i < amount; i++) {
+                found_amount +=
+                    SharedReadHashSet::lookup(table, values[i]);
+            }
+            this->leave();
+            return found_amount;
+        }
+
+      private:
+        /* The announcement and the pointer load have to be
+         * sequentially consistent. Otherwise the writer could
+         * miss the announcement while this reader still loads
+         * the old pointer. */
+        const Table *enter() const {
+            m_slot->epoch.store(m_set->m_epoch.load());
+            return m_set->m_table.load();
+        }
+
+        void leave() const {
+            m_slot->epoch.store(0, std::memory_order_release);
+        }
+    };
+
+    SharedReadHashSet() {
+        m_table.store(new Table(0, 0, HashFunc::get_new()));
+    }
+
+    ~SharedReadHashSet() {
+        delete m_table.load();
+        for (Table *table : m_retired) {
+            delete table;
+        }
+        ReaderSlot *slot = m_reader_slots.load();
+        while (slot != nullptr) {
+            ReaderSlot *next = slot->next;
+            delete slot;
+            slot = next;
+        }
+    }
+
+    SharedReadHashSet(const SharedReadHashSet &other) = delete;
+    SharedReadHashSet &
+    operator=(const SharedReadHashSet &other) = delete;
+
+    Reader reader() const {
+        return Reader(*this);
+    }
+
+    /* The remaining methods may only be called by the writer
+     * thread. */
+
+    inline uint32_t size() const {
+        return m_total_elements;
+    }
+
+    /* Same sizing as HashSet::reserve(). */
+    void reserve(uint32_t amount) {
+        uint8_t exp =
+            GroupGrowth::size_exp_for(amount, s_group_size);
+        Table *table = this->table();
+        if (exp <= table->size_exp) {
+            return;
+        }
+        if (m_total_elements == 0) {
+            this->publish(new Table(
+                exp, GroupGrowth::hash_byte_shift_for(exp),
+                table->hash_fn));
+            return;
+        }
+        while (this->table()->size_exp < exp) {
+            this->grow();
+        }
+    }
+
+    void insert(const T &value) {
+        if (!this->contains(value)) {
+            this->insert_new(value);
+        }
+    }
+
+    void insert_new(const T &value) {
+        while (true) {
+            Table *table = this->table();
+            uint32_t hash = table->hash_fn(value);
+            if (try_append(table, hash, value)) {
+                break;
+            }
+            if (this->should_reseed()) {
+                this->reseed();
+            }
+            else {
+                this->grow();
+            }
+        }
+        m_total_elements++;
+    }
+
+    /* The writer never frees the table it is using itself,
+     * so it does not have to enter a read section. */
+    bool contains(const T &value) const {
+        return lookup(this->table(), value);
+    }
+
+    void remove(const T &value) {
+        Table *table = this->table();
+        uint32_t hash = table->hash_fn(value);
+        Group &group = table->groups[hash & table->mask];
+        uint64_t meta =
+            group.meta.load(std::memory_order_relaxed);
+        for (uint8_t position :
+             Group::match(meta, table->to_hash_byte(hash))) {
+            if (group.values[position].load(
+                    std::memory_order_relaxed) == value) {
+                meta &= ~((uint64_t)1 << (56 + position));
+                group.meta.store(meta,
+                                 std::memory_order_release);
+                m_total_elements--;
+                return;
+            }
+        }
+    }
+
+    float fullness() const {
+        return m_total_elements / (float)this->capacity();
+    }
+
+    uint32_t capacity() const {
+        return this->table()->group_amount() * s_group_size;
+    }
+
+    /* Tables that wait for readers to leave. */
+    uint32_t retired_amount() const {
+        return m_retired.size();
+    }
+
+    /* Waits until all retired tables are freed. Only the
+     * writer waits here, readers are never blocked. */
+    void synchronize() {
+        this->free_retired();
+        while (!m_retired.empty()) {
+            std::this_thread::yield();
+            this->free_retired();
+        }
+    }
+
+  private:
+    Table *table() const {
+        return m_table.load(std::memory_order_relaxed);
+    }
+
+    static bool lookup(const Table *table, const T &value) {
+        uint32_t hash = table->hash_fn(value);
+        const Group &group = table->groups[hash & table->mask];
+        /* Pairs with the release store in try_append(), so
+         * the values of all published slots are visible. */
+        uint64_t meta =
+            group.meta.load(std::memory_order_acquire);
+        for (uint8_t position :
+             Group::match(meta, table->to_hash_byte(hash))) {
+            if (group.values[position].load(
+                    std::memory_order_relaxed) == value) {
+                return true;
+            }
+        }
+        return false;
+    }
+
+    static bool try_append(Table *table, uint32_t hash,
+                           const T &value) {
+        return try_append(table->groups[hash & table->mask],
+                          table->to_hash_byte(hash), value);
+    }
+
+    static bool try_append(Group &group, uint8_t hash_byte,
+                           const T &value) {
+        uint64_t meta =
+            group.meta.load(std::memory_order_relaxed);
+        uint8_t used_mask = Group::used_mask(meta);
+        if (used_mask == (1 << s_group_size) - 1) {
+            return false;
+        }
+        uint8_t position = count_trailing_zeros(~used_mask);
+        group.values[position].store(value,
+                                     std::memory_order_relaxed);
+        uint8_t shift = position * 8;
+        meta &= ~((uint64_t)0xFF << shift);
+        meta |= (uint64_t)hash_byte << shift;
+        meta |= (uint64_t)1 << (56 + position);
+        group.meta.store(meta, std::memory_order_release);
+        return true;
+    }
+
+    /* See GroupGrowth::should_reseed(). */
+    bool should_reseed() const {
+        return GroupGrowth::should_reseed(
+            this->table()->size_exp, m_reseed_size_exp,
+            this->fullness());
+    }
+
+    /* Same split as HashSet::grow(), but into a new table,
+     * because readers might still be in the old one. */
+    void grow() REAL_NOINLINE {
+        Table *old_table = this->table();
+        uint8_t old_exp = old_table->size_exp;
+        uint8_t shift = GroupGrowth::shift_for_grow(
+            old_exp, old_table->hash_byte_shift);
+        bool recalculate = shift != old_table->hash_byte_shift;
+        uint8_t decision_mask =
+            GroupGrowth::decision_mask(old_exp, shift);
+
+        Table *new_table =
+            new Table(old_exp + 1, shift, old_table->hash_fn);
+        uint32_t old_group_amount = old_table->group_amount();
+        for (uint32_t i = 0; i < old_group_amount; i++) {
+            const Group &group = old_table->groups[i];
+            uint64_t meta =
+                group.meta.load(std::memory_order_relaxed);
+            for (uint8_t position :
+                 MatchMask(Group::used_mask(meta))) {
+                T value = group.values[position].load(
+                    std::memory_order_relaxed);
+                uint8_t hash_byte =
+                    recalculate ? new_table->to_hash_byte(
+                                      new_table->hash_fn(value))
+                                : (uint8_t)(meta >> (position * 8));
+                uint32_t index = (hash_byte & decision_mask)
+                                     ? old_group_amount + i
+                                     : i;
+                try_append(new_table->groups[index], hash_byte,
+                           value);
+            }
+        }
+        this->publish(new_table);
+    }
+
+    /* Inserts everything again with a new hash function. A
+     * group that overflows nonetheless makes the new table
+     * twice as large. */
+    void reseed() REAL_NOINLINE {
+        Table *old_table = this->table();
+        m_reseed_size_exp = old_table->size_exp;
+        HashFunc hash_fn = HashFunc::get_new();
+
+        uint8_t exp = old_table->size_exp;
+        while (true) {
+            Table *new_table = new Table(
+                exp, GroupGrowth::hash_byte_shift_for(exp), hash_fn);
+            if (this->copy_values(old_table, new_table)) {
+                this->publish(new_table);
+                return;
+            }
+            delete new_table;
+            exp++;
+        }
+    }
+
+    static bool copy_values(const Table *src, Table *dst) {
+        for (uint32_t i = 0; i < src->group_amount(); i++) {
+            const Group &group = src->groups[i];
+            uint64_t meta =
+                group.meta.load(std::memory_order_relaxed);
+            for (uint8_t position :
+                 MatchMask(Group::used_mask(meta))) {
+                T value = group.values[position].load(
+                    std::memory_order_relaxed);
+                if (!try_append(dst, dst->hash_fn(value),
+                                value)) {
+                    return false;
+                }
+            }
+        }
+        return true;
+    }
+
+    /* Readers that announce the new epoch are guaranteed to
+     * load the new table, so the old one only has to wait for
+     * readers that announced an older or the same epoch. */
+    void publish(Table *new_table) {
+        Table *old_table = m_table.exchange(new_table);
+        old_table->retired_epoch = m_epoch.load();
+        m_epoch.store(old_table->retired_epoch + 1);
+        m_retired.push_back(old_table);
+        this->free_retired();
+    }
+
+    void free_retired() {
+        uint64_t oldest_active = UINT64_MAX;
+        ReaderSlot *slot = m_reader_slots.load();
+        for (; slot != nullptr; slot = slot->next) {
+            uint64_t epoch = slot->epoch.load();
+            if (epoch != 0 && epoch < oldest_active) {
+                oldest_active = epoch;
+            }
+        }
+
+        uint32_t kept = 0;
+        for (Table *table : m_retired) {
+            if (table->retired_epoch < oldest_active) {
+                delete table;
+            }
+            else {
+                m_retired[kept++] = table;
+            }
+        }
+        m_retired.resize(kept);
+    }
+
+    ReaderSlot *acquire_reader_slot() const {
+        ReaderSlot *head = m_reader_slots.load();
+        for (ReaderSlot *slot = head; slot != nullptr;
+             slot = slot->next) {
+            bool expected = false;
+            if (slot->taken.compare_exchange_strong(expected,
+                                                    true)) {
+                return slot;
+            }
+        }
+        ReaderSlot *slot = new ReaderSlot();
+        slot->next = head;
+        while (!m_reader_slots.compare_exchange_weak(slot->next,
+                                                     slot)) {
+        }
+        return slot;
+    }
+};
@@ -0,0 +1,342 @@
+#pragma once
+
+#include "group_growth.hpp"
+#include "hashing.hpp"
+#include "stats.hpp"
+#include "utils.hpp"
+#include <cstring>
+#include <stdint.h>
+#include <stdlib.h>
+#include <utility>
+#include <vector>
+
+#include <emmintrin.h>
+
+/* Variant of HashSet that keeps the metadata of the groups
+ * apart from the values (hot/cold split). The hash bytes and
+ * the size of a group fit into 16 bytes, so that four groups
+ * share a cache line. The values of all groups are in a
+ * second array that is only read when a hash byte matches.
+ *
+ * A miss usually only touches the metadata array, which is
+ * much smaller than the groups of HashSet, so more of it
+ * stays in the cache. The number of slots per group also does
+ * not depend on the size of the values anymore. A hit has to
+ * load from both arrays though, while in HashSet small values
+ * are on the same cache line as their hash bytes.
+ *
+ * Growing works like in HashSet: every group is split into
+ * two by one bit of the hash bytes. */
+template <typename T, typename HashFunc>
+class SplitHashSet : WithStatsCounter {
+  private:
+    static const uint8_t s_group_size = 15;
+
+    struct alignas(16) GroupMetadata {
+        char hash_bytes[s_group_size];
+        uint8_t count;
+
+        MatchMask match(uint8_t hash_byte) const {
+            __m128i bytes = _mm_load_si128((const __m128i *)this);
+            __m128i equal =
+                _mm_cmpeq_epi8(bytes, _mm_set1_epi8(hash_byte));
+            uint32_t used_mask = (1 << count) - 1;
+            return MatchMask(_mm_movemask_epi8(equal) &
+                             used_mask);
+        }
+    };
+
+    static_assert(sizeof(GroupMetadata) == 16,
+                  "four groups have to share a cache line");
+
+    GroupMetadata *m_metadata;
+    T *m_values;
+    uint32_t m_mask;
+    uint8_t m_size_exp;
+    uint8_t m_hash_byte_shift = 0;
+    uint8_t m_reseed_size_exp = 0;
+    uint32_t m_total_elements = 0;
+    HashFunc m_hash_fn;
+
+  public:
+    SplitHashSet() : m_hash_fn(HashFunc::get_new()) {
+        this->allocate(0);
+    }
+
+    SplitHashSet(std::initializer_list<T> values)
+        : SplitHashSet() {
+        for (T value : values) {
+            this->insert(value);
+        }
+    }
+
+    SplitHashSet(const std::vector<T> &values)
+        : SplitHashSet() {
+        this->reserve(values.size());
+        for (const T &value : values) {
+            this->insert_new(value);
+        }
+    }
+
+    ~SplitHashSet() {
+        this->deallocate();
+    }
+
+    SplitHashSet(const SplitHashSet &other) = delete;
+    SplitHashSet &operator=(const SplitHashSet &other) = delete;
+
+    inline uint32_t size() const {
+        return m_total_elements;
+    }
+
+    /* Same sizing as HashSet::reserve(). */
+    void reserve(uint32_t amount) {
+        uint8_t exp =
+            GroupGrowth::size_exp_for(amount, s_group_size);
+        if (m_total_elements == 0) {
+            if (exp > m_size_exp) {
+                this->deallocate();
+                this->allocate(exp);
+                m_hash_byte_shift =
+                    GroupGrowth::hash_byte_shift_for(exp);
+            }
+        }
+        else {
+            while (m_size_exp < exp) {
+                this->grow();
+            }
+        }
+    }
+
+    void insert(const T &value) {
+        uint32_t hash = m_hash_fn(value);
+        if (!this->contains(value, hash)) {
+            this->insert_new(value, hash);
+        }
+    }
+
+    void insert_new(const T &value) {
+        this->insert_new(value, m_hash_fn(value));
+    }
+
+    bool contains(const T &value) const {
+        return this->contains(value, m_hash_fn(value));
+    }
+
+    void remove(const T &value) {
+        auto &&stats = this->stats_counter();
+        uint32_t hash = m_hash_fn(value);
+        uint8_t hash_byte = this->to_hash_byte(hash);
+        uint32_t index = hash & m_mask;
+        GroupMetadata &metadata = m_metadata[index];
+        T *values = this->group_values(index);
+        stats.count_lookup(1);
+        for (uint8_t position : metadata.match(hash_byte)) {
+            bool found = values[position] == value;
+            stats.count_key_comparison(found);
+            if (found) {
+                uint8_t last_position = metadata.count - 1;
+                if (position < last_position) {
+                    values[position] =
+                        std::move(values[last_position]);
+                    metadata.hash_bytes[position] =
+                        metadata.hash_bytes[last_position];
+                }
+                values[last_position].~T();
+                metadata.count--;
+                m_total_elements--;
+                return;
+            }
+        }
+    }
+
+    float fullness() const {
+        return m_total_elements / (float)this->capacity();
+    }
+
+    uint32_t capacity() const {
+        return this->group_amount() * s_group_size;
+    }
+
+    uint64_t size_in_bytes() const {
+        return sizeof(SplitHashSet) +
+               (uint64_t)this->group_amount() *
+                   (sizeof(GroupMetadata) +
+                    s_group_size * sizeof(T));
+    }
+
+    /* Counters are only collected when compiled with
+     * HASH_TABLE_STATS. */
+    HashTableStats stats() const {
+        HashTableStats stats = this->stats_counter().snapshot();
+        stats.size = m_total_elements;
+        stats.capacity = this->capacity();
+        return stats;
+    }
+
+    void reset_stats() {
+        this->stats_counter().reset();
+    }
+
+  private:
+    bool contains(const T &value, uint32_t hash) const {
+        auto &&stats = this->stats_counter();
+        uint8_t hash_byte = this->to_hash_byte(hash);
+        uint32_t index = hash & m_mask;
+        const T *values = this->group_values(index);
+        stats.count_lookup(1);
+        for (uint8_t position :
+             m_metadata[index].match(hash_byte)) {
+            bool found = values[position] == value;
+            stats.count_key_comparison(found);
+            if (found) {
+                return true;
+            }
+        }
+        return false;
+    }
+
+    void insert_new(const T &value, uint32_t hash) {
+        while (true) {
+            uint32_t index = hash & m_mask;
+            if (m_metadata[index].count < s_group_size) {
+                this->append(index, value,
+                             this->to_hash_byte(hash));
+                break;
+            }
+            if (this->should_reseed()) {
+                this->reseed();
+                hash = m_hash_fn(value);
+            }
+            else {
+                this->grow();
+            }
+        }
+        m_total_elements++;
+    }
+
+    template <typename U>
+    inline void append(uint32_t index, U &&value,
+                       uint8_t hash_byte) {
+        GroupMetadata &metadata = m_metadata[index];
+        uint8_t position = metadata.count;
+        new (this->group_values(index) + position)
+            T(std::forward<U>(value));
+        metadata.hash_bytes[position] = hash_byte;
+        metadata.count++;
+    }
+
+    inline T *group_values(uint32_t index) const {
+        return m_values + (uint64_t)index * s_group_size;
+    }
+
+    inline uint8_t to_hash_byte(uint32_t hash) const {
+        return hash >> m_hash_byte_shift;
+    }
+
+    inline uint32_t group_amount() const {
+        return m_mask + 1;
+    }
+
+    /* Same as HashSet::grow(), but the values are moved into
+     * a new value array. */
+    void grow() REAL_NOINLINE {
+        auto timer = this->stats_counter().time_grow();
+
+        uint8_t shift = GroupGrowth::shift_for_grow(
+            m_size_exp, m_hash_byte_shift);
+        if (shift != m_hash_byte_shift) {
+            m_hash_byte_shift = shift;
+            this->recalculate_hash_bytes();
+        }
+
+        uint8_t decision_mask = GroupGrowth::decision_mask(
+            m_size_exp, m_hash_byte_shift);
+
+        uint32_t old_group_amount = this->group_amount();
+        GroupMetadata *old_metadata = m_metadata;
+        T *old_values = m_values;
+        this->allocate(m_size_exp + 1);
+
+        for (uint32_t i = 0; i < old_group_amount; i++) {
+            const GroupMetadata &metadata = old_metadata[i];
+            T *values = old_values + (uint64_t)i * s_group_size;
+            for (uint8_t position = 0; position < metadata.count;
+                 position++) {
+                uint8_t hash_byte = metadata.hash_bytes[position];
+                uint32_t index = (hash_byte & decision_mask)
+                                     ? old_group_amount + i
+                                     : i;
+                this->append(index, std::move(values[position]),
+                             hash_byte);
+                values[position].~T();
+            }
+        }
+        std::free(old_metadata);
+        std::free(old_values);
+    }
+
+    /* See GroupGrowth::should_reseed(). */
+    bool should_reseed() const {
+        return GroupGrowth::should_reseed(
+            m_size_exp, m_reseed_size_exp, this->fullness());
+    }
+
+    void reseed() REAL_NOINLINE {
+        auto timer = this->stats_counter().time_grow();
+
+        m_reseed_size_exp = m_size_exp;
+        m_hash_fn = HashFunc::get_new();
+
+        uint32_t old_group_amount = this->group_amount();
+        GroupMetadata *old_metadata = m_metadata;
+        T *old_values = m_values;
+        this->allocate(m_size_exp);
+        m_total_elements = 0;
+
+        for (uint32_t i = 0; i < old_group_amount; i++) {
+            T *values = old_values + (uint64_t)i * s_group_size;
+            for (uint8_t position = 0;
+                 position < old_metadata[i].count; position++) {
+                this->insert_new(values[position],
+                                 m_hash_fn(values[position]));
+                values[position].~T();
+            }
+        }
+        std::free(old_metadata);
+        std::free(old_values);
+    }
+
+    void recalculate_hash_bytes() {
+        uint32_t hashes[s_group_size];
+        for (uint32_t i = 0; i < this->group_amount(); i++) {
+            GroupMetadata &metadata = m_metadata[i];
+            hash_many(m_hash_fn, this->group_values(i), hashes,
+                      metadata.count);
+            for (uint8_t position = 0; position < metadata.count;
+                 position++) {
+                metadata.hash_bytes[position] =
+                    hashes[position] >> m_hash_byte_shift;
+            }
+        }
+    }
+
+    void allocate(uint8_t size_exp) {
+        uint32_t length = 1 << size_exp;
+        m_size_exp = size_exp;
+        m_mask = length - 1;
+        m_metadata = allocate_cache_lines<GroupMetadata>(length);
+        std::memset(m_metadata, 0,
+                    (uint64_t)length * sizeof(GroupMetadata));
+        m_values = allocate_cache_lines<T>((uint64_t)length *
+                                           s_group_size);
+    }
+
+    void deallocate() {
+        for (uint32_t i = 0; i < this->group_amount(); i++) {
+            destroy_n(this->group_values(i), m_metadata[i].count);
+        }
+        std::free(m_metadata);
+        std::free(m_values);
+    }
+};
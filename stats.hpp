@@ -0,0 +1,168 @@
+#pragma once
+
+#include <chrono>
+#include <sstream>
+#include <stdint.h>
+#include <string>
+
+/* Compile with HASH_TABLE_STATS=1 to let the hash tables
+ * count what they are doing. When disabled, the tables use
+ * DisabledStatsCounter, whose methods do nothing and which
+ * is not stored in the table at all. */
+#ifndef HASH_TABLE_STATS
+#define HASH_TABLE_STATS 0
+#endif
+
+struct HashTableStats {
+    bool enabled = false;
+
+    uint32_t size = 0;
+    uint32_t capacity = 0;
+    uint32_t tombstones = 0;
+
+    /* Probes are groups in HashSet and slots in Set/Map. */
+    uint64_t lookups = 0;
+    uint64_t probes = 0;
+    uint32_t max_probe_length = 0;
+
+    /* In HashSet a key is only compared after its hash
+     * byte matched, so failed comparisons are hash byte
+     * false positives. */
+    uint64_t key_comparisons = 0;
+    uint64_t failed_key_comparisons = 0;
+
+    uint32_t grows = 0;
+    double grow_seconds = 0;
+
+    float probes_per_lookup() const {
+        return lookups ? probes / (float)lookups : 0;
+    }
+
+    float false_positive_rate() const {
+        return key_comparisons ? failed_key_comparisons /
+                                     (float)key_comparisons
+                               : 0;
+    }
+
+    float tombstone_ratio() const {
+        return capacity ? tombstones / (float)capacity : 0;
+    }
+
+    std::string to_json() const {
+        std::ostringstream ss;
+        ss << "{\"enabled\": " << (enabled ? "true" : "false")
+           << ", \"size\": " << size
+           << ", \"capacity\": " << capacity
+           << ", \"tombstones\": " << tombstones
+           << ", \"tombstone_ratio\": " << tombstone_ratio()
+           << ", \"lookups\": " << lookups
+           << ", \"probes\": " << probes
+           << ", \"probes_per_lookup\": "
+           << probes_per_lookup()
+           << ", \"max_probe_length\": " << max_probe_length
+           << ", \"key_comparisons\": " << key_comparisons
+           << ", \"failed_key_comparisons\": "
+           << failed_key_comparisons
+           << ", \"false_positive_rate\": "
+           << false_positive_rate() << ", \"grows\": " << grows
+           << ", \"grow_seconds\": " << grow_seconds << "}";
+        return ss.str();
+    }
+};
+
+class HashTableStatsCounter {
+  private:
+    HashTableStats m_stats;
+
+  public:
+    class GrowTimer {
+      private:
+        HashTableStats &m_stats;
+        std::chrono::steady_clock::time_point m_start;
+
+      public:
+        GrowTimer(HashTableStats &stats)
+            : m_stats(stats),
+              m_start(std::chrono::steady_clock::now()) {}
+
+        ~GrowTimer() {
+            std::chrono::duration<double> duration =
+                std::chrono::steady_clock::now() - m_start;
+            m_stats.grows++;
+            m_stats.grow_seconds += duration.count();
+        }
+    };
+
+    HashTableStatsCounter() {
+        m_stats.enabled = true;
+    }
+
+    inline void count_lookup(uint32_t probe_length) {
+        m_stats.lookups++;
+        m_stats.probes += probe_length;
+        if (probe_length > m_stats.max_probe_length) {
+            m_stats.max_probe_length = probe_length;
+        }
+    }
+
+    inline void count_key_comparison(bool equal) {
+        m_stats.key_comparisons++;
+        m_stats.failed_key_comparisons += !equal;
+    }
+
+    GrowTimer time_grow() {
+        return GrowTimer(m_stats);
+    }
+
+    void reset() {
+        m_stats = HashTableStats();
+        m_stats.enabled = true;
+    }
+
+    HashTableStats snapshot() const {
+        return m_stats;
+    }
+};
+
+class DisabledStatsCounter {
+  public:
+    /* The destructor marks the timer as used, so that the
+     * unused timer variables do not cause warnings. */
+    struct GrowTimer {
+        ~GrowTimer() {}
+    };
+
+    inline void count_lookup(uint32_t) {}
+
+    inline void count_key_comparison(bool) {}
+
+    GrowTimer time_grow() {
+        return GrowTimer();
+    }
+
+    void reset() {}
+
+    HashTableStats snapshot() const {
+        return HashTableStats();
+    }
+};
+
+/* Base class that gives a table stats_counter(). It is empty
+ * when the stats are disabled, so that it does not make the
+ * table any larger. */
+class WithStatsCounter {
+#if HASH_TABLE_STATS
+  private:
+    mutable HashTableStatsCounter m_stats;
+
+  protected:
+    HashTableStatsCounter &stats_counter() const {
+        return m_stats;
+    }
+#else
+  protected:
+    DisabledStatsCounter stats_counter() const {
+        return DisabledStatsCounter();
+    }
+#endif
+};
@@ -1,8 +1,13 @@
 #pragma once
 
+#include <atomic>
 #include <stdint.h>
+#include <stdlib.h>
+#include <thread>
 #include <vector>
 
+#include <immintrin.h>
+
 #define LIKEKLY(x) __builtin_expect((x), 1)
 #define UNLIKELY(x) __builtin_expect((x), 0)
 
@@ -14,41 +19,107 @@
 #define NOINLINE
 #endif
 
-/* http://supertech.csail.mit.edu/papers/debruijn.pdf */
+/* Bit operations on the masks that SIMD comparisons return.
+ * They compile to tzcnt, popcnt and blsr when the target has
+ * them. The fallbacks are only for other compilers. */
 
-inline uint8_t get_bit_identifier_32(uint32_t v) {
-    return ((uint32_t)(v * 0x07C4ACDD)) >> 27;
+/* v must not be 0. */
+inline uint8_t count_trailing_zeros(uint32_t v) {
+#if defined(__BMI__)
+    return _tzcnt_u32(v);
+#elif defined(__GNUC__)
+    return __builtin_ctz(v);
+#else
+    /* http://supertech.csail.mit.edu/papers/debruijn.pdf */
+    static const uint8_t table[32] = {
+        0,  1,  28, 2,  29, 14, 24, 3,  30, 22, 20,
+        15, 25, 17, 4,  8,  31, 27, 13, 23, 21, 19,
+        16, 7,  26, 12, 18, 6,  11, 5,  10, 9};
+    return table[(uint32_t)((v & -v) * 0x077CB531u) >> 27];
+#endif
 }
 
-inline uint8_t get_bit_identifier_16(uint16_t v) {
-    return ((uint16_t)(v * 0x0F65)) >> 12;
+inline uint8_t count_bits(uint32_t v) {
+#if defined(__POPCNT__)
+    return _mm_popcnt_u32(v);
+#elif defined(__GNUC__)
+    return __builtin_popcount(v);
+#else
+    v = v - ((v >> 1) & 0x55555555);
+    v = (v & 0x33333333) + ((v >> 2) & 0x33333333);
+    v = (v + (v >> 4)) & 0x0F0F0F0F;
+    return (v * 0x01010101) >> 24;
+#endif
 }
 
-inline uint8_t get_bit_index_16(uint16_t v) {
-    static const uint8_t table[16] = {0, 1, 11, 2,  14, 12,
-                                      8, 3, 15, 10, 13, 7,
-                                      9, 6, 5,  4};
-    uint8_t identifier = ((uint16_t)(v * 0x0F65)) >> 12;
-    uint8_t index = table[identifier];
-    return index;
+inline uint32_t clear_lowest_bit(uint32_t v) {
+#if defined(__BMI__)
+    return _blsr_u32(v);
+#else
+    return v & (v - 1);
+#endif
 }
 
-inline uint8_t get_bit_identifier_8(uint8_t v) {
-    return ((uint8_t)(v * 0x1C)) >> 5;
-}
+/* The positions in a group whose bit is set in the mask,
+ * from the lowest to the highest:
+ *
+ *   for (uint8_t position : MatchMask(mask)) { ... }
+ *
+ * Every step is a tzcnt and a blsr, nothing depends on a
+ * table in memory. */
+class MatchMask {
+  private:
+    uint32_t m_mask;
+
+  public:
+    class Iterator {
+      private:
+        uint32_t m_mask;
+
+      public:
+        Iterator(uint32_t mask) : m_mask(mask) {}
+
+        uint8_t operator*() const {
+            return count_trailing_zeros(m_mask);
+        }
+
+        Iterator &operator++() {
+            m_mask = clear_lowest_bit(m_mask);
+            return *this;
+        }
+
+        bool operator!=(const Iterator &other) const {
+            return m_mask != other.m_mask;
+        }
+    };
+
+    explicit MatchMask(uint32_t mask) : m_mask(mask) {}
+
+    bool any() const {
+        return m_mask != 0;
+    }
 
-inline uint16_t keep_one_bit(uint16_t v) {
-    return v & -v;
-}
+    /* Only valid when any() is true. */
+    uint8_t lowest() const {
+        return count_trailing_zeros(m_mask);
+    }
 
-inline uint8_t count_bits(uint32_t n) {
-    uint8_t count = 0;
-    while (n) {
-        count += n & 1;
-        n >>= 1;
+    uint8_t count() const {
+        return count_bits(m_mask);
+    }
+
+    uint32_t bits() const {
+        return m_mask;
     }
-    return count;
-}
+
+    Iterator begin() const {
+        return Iterator(m_mask);
+    }
+
+    Iterator end() const {
+        return Iterator(0);
+    }
+};
 
 inline constexpr uint32_t
 next_multiple(uint32_t multiple_of, uint32_t value) {
@@ -66,33 +137,91 @@ void destroy_n(T *ptr, uint32_t amount) {
     }
 }
 
+/* Uninitialized memory for amount values that starts at a
+ * cache line, free it with std::free(). The size is rounded
+ * up, because aligned_alloc needs a multiple of the
+ * alignment. */
 template <typename T>
-void partial_sort(T *data, uint32_t *keys, uint32_t length,
-                  uint8_t shift, uint8_t digits) {
-    uint32_t bucket_amount = 1 << digits;
-    std::vector<uint32_t> sizes(bucket_amount);
-    uint32_t mask = (1 << digits) - 1;
-
-    for (uint32_t i = 0; i < length; i++) {
-        uint32_t index = (keys[i] >> shift) & mask;
-        sizes[index]++;
+T *allocate_cache_lines(uint64_t amount) {
+    uint64_t size = amount * sizeof(T);
+    return (T *)aligned_alloc(64, (size + 63) & ~(uint64_t)63);
+}
+
+
+/* Splits [0, amount) into one contiguous range per thread and
+ * calls fn(begin, end) for every range. The calling thread
+ * takes the first range itself. */
+template <typename Fn>
+void parallel_for_ranges(uint32_t amount,
+                         uint32_t thread_amount, const Fn &fn) {
+    if (thread_amount <= 1 || amount <= 1) {
+        fn(0, amount);
+        return;
     }
+    if (thread_amount > amount) {
+        thread_amount = amount;
+    }
+    std::vector<std::thread> threads;
+    for (uint32_t t = 1; t < thread_amount; t++) {
+        uint32_t begin = (uint64_t)amount * t / thread_amount;
+        uint32_t end =
+            (uint64_t)amount * (t + 1) / thread_amount;
+        threads.emplace_back(
+            [&fn, begin, end]() { fn(begin, end); });
+    }
+    fn(0, amount / thread_amount);
+    for (std::thread &thread : threads) {
+        thread.join();
+    }
+}
 
-    std::vector<uint32_t> offsets(bucket_amount);
-    for (uint32_t i = 0; i < bucket_amount - 1; i++) {
-        offsets[i + 1] = offsets[i] + sizes[i];
+/* A range [begin, end) of indices, e.g. of the groups of a
+ * hash table. */
+struct IndexRange {
+    uint32_t begin;
+    uint32_t end;
+};
+
+/* Splits [0, amount) into ranges of grain indices. Only the
+ * last range can be shorter. */
+inline std::vector<IndexRange> split_range(uint32_t amount,
+                                           uint32_t grain) {
+    if (grain == 0) {
+        grain = 1;
     }
+    std::vector<IndexRange> ranges;
+    for (uint32_t begin = 0; begin < amount;) {
+        uint32_t end = amount - begin > grain
+                           ? begin + grain
+                           : amount;
+        ranges.push_back({begin, end});
+        begin = end;
+    }
+    return ranges;
+}
 
-    std::vector<T> tmp_data(
-        std::make_move_iterator(data),
-        std::make_move_iterator(data + length));
-    std::vector<uint32_t> tmp_keys(keys, keys + length);
-
-    for (uint32_t i = 0; i < length; i++) {
-        uint32_t bucket = (tmp_keys[i] >> shift) & mask;
-        uint32_t new_index = offsets[bucket];
-        data[new_index] = std::move(tmp_data[i]);
-        keys[new_index] = tmp_keys[i];
-        offsets[bucket]++;
+/* Calls fn(begin, end) for ranges of grain indices in
+ * [0, amount). The threads take the next range when they are
+ * done with one, so that ranges that take longer do not leave
+ * the other threads waiting. */
+template <typename Fn>
+void parallel_for_grains(uint32_t amount, uint32_t grain,
+                         uint32_t thread_amount, const Fn &fn) {
+    std::vector<IndexRange> ranges = split_range(amount, grain);
+    if (thread_amount > ranges.size()) {
+        thread_amount = ranges.size();
     }
-}
\ No newline at end of file
+    std::atomic<uint32_t> next_range{0};
+    parallel_for_ranges(
+        thread_amount, thread_amount,
+        [&](uint32_t /*begin*/, uint32_t /*end*/) {
+            while (true) {
+                uint32_t index = next_range.fetch_add(
+                    1, std::memory_order_relaxed);
+                if (index >= ranges.size()) {
+                    break;
+                }
+                fn(ranges[index].begin, ranges[index].end);
+            }
+        });
+}